@@ -0,0 +1,27 @@
+/*!
+ * @file
+ * @brief Helpers shared by the benchmark programs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include "Benchmark.h"
+#include "uassert.h"
+
+void __uassert_func(const char *fileName, int lineNumber, bool condition, const char *conditionString)
+{
+   if(!condition)
+   {
+      fprintf(stderr, "%s:%d: assertion failed: %s\n", fileName, lineNumber, conditionString);
+      abort();
+   }
+}
+
+double Benchmark_NowInNanoseconds(void)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
@@ -0,0 +1,15 @@
+/*!
+ * @file
+ * @brief Helpers shared by the benchmark programs.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/*!
+ * Read a monotonic clock.
+ * @return The current time in nanoseconds.
+ */
+double Benchmark_NowInNanoseconds(void);
+
+#endif
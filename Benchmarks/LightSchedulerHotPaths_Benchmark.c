@@ -0,0 +1,216 @@
+/*!
+ * @file
+ * @brief Measures the hot paths of LightScheduler across table sizes from 10 to 1M schedules, and
+ * prints one CSV row per path and size so that results can be compared between releases.
+ *
+ * Columns: benchmark, schedules, operations, ns_per_operation
+ *
+ * - add: LightScheduler_AddScheduleAt into a table filling up to the size.
+ * - remove: LightScheduler_RemoveScheduleByHandle until the table is empty.
+ * - run_none_due: LightScheduler_Run on ticks with nothing due.
+ * - run_one_due: LightScheduler_Run on ticks with one schedule due.
+ * - run_all_due: LightScheduler_Run on ticks with every schedule due.
+ * - churn: per schedule, removing the oldest schedules by handle and adding as many new ones with
+ *   LightScheduler_AddSchedules, in batches of up to CHURN_BATCH, with the table kept full.
+ */
+
+#include <stdio.h>
+#include "Benchmark.h"
+#include "LightScheduler.h"
+
+#define MAX_BENCHMARK_SCHEDULES (1000000UL)
+#define OPERATIONS_PER_SAMPLE (1000000UL)
+#define ALL_DUE_WRITES_PER_SAMPLE (10000000UL)
+#define CHURN_BATCH (64UL)
+
+typedef struct
+{
+   I_TimeSource_t interface;
+   TimeSourceWideTickCount_t ticks;
+} BenchmarkTimeSource_t;
+
+typedef struct
+{
+   I_DigitalOutputGroup_t interface;
+   unsigned long writes;
+} BenchmarkOutputGroup_t;
+
+static LightScheduler_t scheduler;
+static uint64_t storage[LIGHTSCHEDULER_STORAGE_WORDS(MAX_BENCHMARK_SCHEDULES)];
+static ScheduleHandle_t handles[MAX_BENCHMARK_SCHEDULES];
+static BenchmarkTimeSource_t timeSource;
+static BenchmarkOutputGroup_t outputGroup;
+
+static TimeSourceTickCount_t GetTicks(I_TimeSource_t *instance)
+{
+   return (TimeSourceTickCount_t)((BenchmarkTimeSource_t *)instance)->ticks;
+}
+
+static TimeSourceWideTickCount_t GetWideTicks(I_TimeSource_t *instance)
+{
+   return ((BenchmarkTimeSource_t *)instance)->ticks;
+}
+
+static const I_TimeSource_Api_t timeSourceApi =
+   { GetTicks, GetWideTicks };
+
+static void Write(I_DigitalOutputGroup_t *instance, const DigitalOutputChannel_t channel, const bool state)
+{
+   (void)channel;
+   (void)state;
+   ((BenchmarkOutputGroup_t *)instance)->writes++;
+}
+
+static const I_DigitalOutputGroup_Api_t outputGroupApi =
+   { Write, NULL };
+
+static void Report(const char *benchmark, unsigned long numSchedules, unsigned long operations, double ns)
+{
+   printf("%s,%lu,%lu,%.2f\n", benchmark, numSchedules, operations, ns / (double)operations);
+}
+
+static void Reset(unsigned long numSchedules)
+{
+   timeSource.ticks = 0;
+   outputGroup.writes = 0;
+   LightScheduler_InitWithStorage(&scheduler, &outputGroup.interface, &timeSource.interface, storage, (ScheduleIndex_t)numSchedules);
+}
+
+static void FillWithOneShots(unsigned long numSchedules, TimeSourceWideTickCount_t start)
+{
+   unsigned long i;
+
+   for(i = 0; i < numSchedules; i++)
+   {
+      handles[i] = LightScheduler_AddScheduleAt(&scheduler, (DigitalOutputChannel_t)i, (i & 1) != 0, start + 1 + i);
+   }
+}
+
+/*!
+ * Fills and empties the table until OPERATIONS_PER_SAMPLE adds and removes have been timed.
+ */
+static void MeasureAddAndRemove(unsigned long numSchedules)
+{
+   unsigned long operations = 0;
+   double addNs = 0;
+   double removeNs = 0;
+   double start;
+   unsigned long i;
+
+   while(operations < OPERATIONS_PER_SAMPLE)
+   {
+      Reset(numSchedules);
+
+      start = Benchmark_NowInNanoseconds();
+      FillWithOneShots(numSchedules, 0);
+      addNs += Benchmark_NowInNanoseconds() - start;
+
+      start = Benchmark_NowInNanoseconds();
+      for(i = 0; i < numSchedules; i++)
+      {
+         LightScheduler_RemoveScheduleByHandle(&scheduler, handles[i]);
+      }
+      removeNs += Benchmark_NowInNanoseconds() - start;
+
+      operations += numSchedules;
+   }
+
+   Report("add", numSchedules, operations, addNs);
+   Report("remove", numSchedules, operations, removeNs);
+}
+
+static double TimeRuns(unsigned long runs)
+{
+   double start = Benchmark_NowInNanoseconds();
+   unsigned long i;
+
+   for(i = 0; i < runs; i++)
+   {
+      timeSource.ticks++;
+      LightScheduler_Run(&scheduler);
+   }
+   return Benchmark_NowInNanoseconds() - start;
+}
+
+static void MeasureRuns(unsigned long numSchedules)
+{
+   unsigned long allDueRuns = (ALL_DUE_WRITES_PER_SAMPLE / numSchedules) > 0 ? (ALL_DUE_WRITES_PER_SAMPLE / numSchedules) : 1;
+   unsigned long i;
+
+   Reset(numSchedules);
+   FillWithOneShots(numSchedules, OPERATIONS_PER_SAMPLE);
+   Report("run_none_due", numSchedules, OPERATIONS_PER_SAMPLE, TimeRuns(OPERATIONS_PER_SAMPLE));
+
+   Reset(numSchedules);
+   for(i = 0; i < numSchedules; i++)
+   {
+      LightScheduler_AddRecurringSchedule(&scheduler, (DigitalOutputChannel_t)i, (i & 1) != 0, 1 + i, numSchedules);
+   }
+   Report("run_one_due", numSchedules, OPERATIONS_PER_SAMPLE, TimeRuns(OPERATIONS_PER_SAMPLE));
+
+   Reset(numSchedules);
+   for(i = 0; i < numSchedules; i++)
+   {
+      LightScheduler_AddRecurringSchedule(&scheduler, (DigitalOutputChannel_t)i, (i & 1) != 0, 1, 1);
+   }
+   Report("run_all_due", numSchedules, allDueRuns, TimeRuns(allDueRuns));
+}
+
+/*!
+ * Keeps the table full while replacing its oldest schedules in batches.  handles is used as a ring
+ * ordered from oldest to newest.
+ */
+static void MeasureChurn(unsigned long numSchedules)
+{
+   LightScheduleEntry_t entries[CHURN_BATCH];
+   ScheduleHandle_t added[CHURN_BATCH];
+   unsigned long batch = (numSchedules < CHURN_BATCH) ? numSchedules : CHURN_BATCH;
+   TimeSourceWideTickCount_t nextTime = numSchedules + 1;
+   unsigned long oldest = 0;
+   unsigned long operations = 0;
+   double start;
+   unsigned long i;
+
+   Reset(numSchedules);
+   FillWithOneShots(numSchedules, 0);
+
+   start = Benchmark_NowInNanoseconds();
+   while(operations < OPERATIONS_PER_SAMPLE)
+   {
+      for(i = 0; i < batch; i++)
+      {
+         LightScheduler_RemoveScheduleByHandle(&scheduler, handles[(oldest + i) % numSchedules]);
+         entries[i].time = nextTime++;
+         entries[i].lightId = (DigitalOutputChannel_t)i;
+         entries[i].lightState = (i & 1) != 0;
+      }
+
+      LightScheduler_AddSchedules(&scheduler, entries, (uint32_t)batch, added);
+      for(i = 0; i < batch; i++)
+      {
+         handles[(oldest + i) % numSchedules] = added[i];
+      }
+
+      oldest = (oldest + batch) % numSchedules;
+      operations += batch;
+   }
+   Report("churn", numSchedules, operations, Benchmark_NowInNanoseconds() - start);
+}
+
+int main(void)
+{
+   unsigned long numSchedules;
+
+   timeSource.interface.api = &timeSourceApi;
+   outputGroup.interface.api = &outputGroupApi;
+
+   printf("benchmark,schedules,operations,ns_per_operation\n");
+   for(numSchedules = 10; numSchedules <= MAX_BENCHMARK_SCHEDULES; numSchedules *= 10)
+   {
+      MeasureAddAndRemove(numSchedules);
+      MeasureRuns(numSchedules);
+      MeasureChurn(numSchedules);
+   }
+
+   return 0;
+}
@@ -0,0 +1,113 @@
+/*!
+ * @file
+ * @brief Simulates a year of schedules with LightSchedulerSimulator and reports the events simulated per
+ * second of real time and the digest of the final channel states.
+ *
+ * Usage: LightSchedulerSimulation_Benchmark [snapshot [ticks]]
+ *
+ * Without arguments, a year of daily and weekly schedules for SYNTHETIC_CHANNELS channels is simulated
+ * at one tick per second.  With a snapshot saved by LightSchedulerSnapshotFile_Save (from a build with
+ * the same LIGHTSCHEDULER_STORE and LIGHTSCHEDULER_WHEEL_SLOTS), its schedules are simulated for ticks
+ * ticks, a year by default, past its last processed tick.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "Benchmark.h"
+#include "LightSchedulerSimulator.h"
+#include "LightSchedulerSnapshotFile.h"
+
+#define TICKS_PER_SECOND (1UL)
+#define YEAR_TICKS (LIGHTSCHEDULER_DAILY_PERIOD(TICKS_PER_SECOND) * 365)
+#define NUM_CHANNELS (65536UL)
+#define SYNTHETIC_CHANNELS (4096UL)
+#define SYNTHETIC_SCHEDULES ((2 * SYNTHETIC_CHANNELS) + (SYNTHETIC_CHANNELS / 8))
+
+static LightSchedulerSimulator_t simulator;
+static LightScheduler_t scheduler;
+static uint32_t states[LIGHTSCHEDULER_SIMULATOR_STATE_WORDS(NUM_CHANNELS)];
+static uint64_t storage[LIGHTSCHEDULER_STORAGE_WORDS(SYNTHETIC_SCHEDULES)];
+
+/*!
+ * Every channel turns on once a day, at a time spread over the day, and off eight hours later.  One
+ * channel in eight also turns on once a week.
+ */
+static void AddSyntheticSchedules(void)
+{
+   TimeSourceWideTickCount_t day = LIGHTSCHEDULER_DAILY_PERIOD(TICKS_PER_SECOND);
+   TimeSourceWideTickCount_t week = LIGHTSCHEDULER_WEEKLY_PERIOD(TICKS_PER_SECOND);
+   unsigned long i;
+
+   LightScheduler_InitWithStorage(
+      &scheduler,
+      LightSchedulerSimulator_GetLights(&simulator),
+      LightSchedulerSimulator_GetTimeSource(&simulator),
+      storage,
+      SYNTHETIC_SCHEDULES);
+
+   for(i = 0; i < SYNTHETIC_CHANNELS; i++)
+   {
+      TimeSourceWideTickCount_t on = (i * 7919) % day;
+
+      LightScheduler_AddRecurringSchedule(&scheduler, (DigitalOutputChannel_t)i, true, on, day);
+      LightScheduler_AddRecurringSchedule(&scheduler, (DigitalOutputChannel_t)i, false, on + ((8 * day) / 24), day);
+      if((i % 8) == 0)
+      {
+         LightScheduler_AddRecurringSchedule(&scheduler, (DigitalOutputChannel_t)i, true, (i * 104729) % week, week);
+      }
+   }
+}
+
+int main(int argc, char *argv[])
+{
+   LightSchedulerSnapshotFile_t file;
+   TimeSourceWideTickCount_t ticks = YEAR_TICKS;
+   TimeSourceWideTickCount_t start = 0;
+   uint64_t runs;
+   double began;
+   double seconds;
+
+   LightSchedulerSimulator_Init(&simulator, states, NUM_CHANNELS);
+   file.image = NULL;
+
+   if(argc > 1)
+   {
+      if(!LightSchedulerSnapshotFile_Load(
+            &file,
+            &scheduler,
+            LightSchedulerSimulator_GetLights(&simulator),
+            LightSchedulerSimulator_GetTimeSource(&simulator),
+            argv[1]))
+      {
+         fprintf(stderr, "%s is not a snapshot this build can run\n", argv[1]);
+         return 1;
+      }
+      if(argc > 2)
+      {
+         ticks = strtoull(argv[2], NULL, 0);
+      }
+      start = scheduler.lastTick;
+   }
+   else
+   {
+      AddSyntheticSchedules();
+   }
+
+   printf("simulating %lu schedules for %llu ticks\n", (unsigned long)scheduler.numSchedules, (unsigned long long)ticks);
+   began = Benchmark_NowInNanoseconds();
+   runs = LightSchedulerSimulator_RunUntil(&simulator, &scheduler, start + ticks);
+   seconds = (Benchmark_NowInNanoseconds() - began) / 1e9;
+
+   printf("%llu events, %llu runs in %.3f s: %.0f events/s\n",
+      (unsigned long long)LightSchedulerSimulator_GetEventCount(&simulator),
+      (unsigned long long)runs,
+      seconds,
+      (double)LightSchedulerSimulator_GetEventCount(&simulator) / seconds);
+   printf("channel state digest %016llx\n", (unsigned long long)LightSchedulerSimulator_GetDigest(&simulator));
+
+   if(file.image != NULL)
+   {
+      LightSchedulerSnapshotFile_Close(&file);
+   }
+   return 0;
+}
@@ -0,0 +1,146 @@
+/*!
+ * @file
+ * @brief Measures the cost of LightScheduler_Run as the number of schedules grows.
+ */
+
+#include <stdio.h>
+#include "Benchmark.h"
+#include "LightScheduler.h"
+
+#define RUNS_PER_SAMPLE (1000000UL)
+#define MAX_BENCHMARK_SCHEDULES (100000UL)
+
+typedef struct
+{
+   I_TimeSource_t interface;
+   TimeSourceWideTickCount_t ticks;
+} BenchmarkTimeSource_t;
+
+typedef struct
+{
+   I_DigitalOutputGroup_t interface;
+   unsigned long writes;
+} BenchmarkOutputGroup_t;
+
+static LightScheduler_t scheduler;
+static uint64_t storage[LIGHTSCHEDULER_STORAGE_WORDS(MAX_BENCHMARK_SCHEDULES)];
+static LightScheduleEntry_t entries[MAX_BENCHMARK_SCHEDULES];
+
+static TimeSourceTickCount_t GetTicks(I_TimeSource_t *instance)
+{
+   return (TimeSourceTickCount_t)((BenchmarkTimeSource_t *)instance)->ticks;
+}
+
+static TimeSourceWideTickCount_t GetWideTicks(I_TimeSource_t *instance)
+{
+   return ((BenchmarkTimeSource_t *)instance)->ticks;
+}
+
+static const I_TimeSource_Api_t timeSourceApi =
+   { GetTicks, GetWideTicks };
+
+static void Write(I_DigitalOutputGroup_t *instance, const DigitalOutputChannel_t channel, const bool state)
+{
+   (void)channel;
+   (void)state;
+   ((BenchmarkOutputGroup_t *)instance)->writes++;
+}
+
+static const I_DigitalOutputGroup_Api_t outputGroupApi =
+   { Write, NULL };
+
+static void AddSchedulesAfter(unsigned long numSchedules, TimeSourceWideTickCount_t start)
+{
+   unsigned long i;
+
+   for(i = 0; i < numSchedules; i++)
+   {
+      LightScheduler_AddScheduleAt(&scheduler, (DigitalOutputChannel_t)i, (i & 1) != 0, start + 1 + i);
+   }
+}
+
+/*!
+ * Times loading numSchedules schedules with one bulk add.
+ */
+static double MeasureBulkLoad(unsigned long numSchedules, BenchmarkTimeSource_t *timeSource, BenchmarkOutputGroup_t *outputGroup)
+{
+   unsigned long i;
+   double start;
+
+   for(i = 0; i < numSchedules; i++)
+   {
+      entries[i].time = RUNS_PER_SAMPLE + 1 + i;
+      entries[i].lightId = (DigitalOutputChannel_t)i;
+      entries[i].lightState = (i & 1) != 0;
+   }
+
+   LightScheduler_InitWithStorage(&scheduler, &outputGroup->interface, &timeSource->interface, storage, MAX_BENCHMARK_SCHEDULES);
+   start = Benchmark_NowInNanoseconds();
+   LightScheduler_AddSchedules(&scheduler, entries, numSchedules, NULL);
+   return (Benchmark_NowInNanoseconds() - start) / (double)numSchedules;
+}
+
+/*!
+ * Times idle runs with numSchedules pending beyond the idle ticks, then times runs over ticks that
+ * each have one schedule due.
+ */
+static void Measure(unsigned long numSchedules, BenchmarkTimeSource_t *timeSource, BenchmarkOutputGroup_t *outputGroup)
+{
+   unsigned long i;
+   double start;
+   double idleNs;
+   double busyNs = 0;
+   double loadNs = MeasureBulkLoad(numSchedules, timeSource, outputGroup);
+
+   LightScheduler_InitWithStorage(&scheduler, &outputGroup->interface, &timeSource->interface, storage, MAX_BENCHMARK_SCHEDULES);
+   timeSource->ticks = 0;
+   AddSchedulesAfter(numSchedules, RUNS_PER_SAMPLE);
+
+   start = Benchmark_NowInNanoseconds();
+   for(i = 0; i < RUNS_PER_SAMPLE; i++)
+   {
+      timeSource->ticks++;
+      LightScheduler_Run(&scheduler);
+   }
+   idleNs = (Benchmark_NowInNanoseconds() - start) / RUNS_PER_SAMPLE;
+
+   outputGroup->writes = 0;
+   while(outputGroup->writes < RUNS_PER_SAMPLE)
+   {
+      if(scheduler.numSchedules == 0)
+      {
+         AddSchedulesAfter(numSchedules, timeSource->ticks);
+      }
+
+      start = Benchmark_NowInNanoseconds();
+      for(i = 0; i < numSchedules; i++)
+      {
+         timeSource->ticks++;
+         LightScheduler_Run(&scheduler);
+      }
+      busyNs += Benchmark_NowInNanoseconds() - start;
+   }
+   busyNs /= (double)outputGroup->writes;
+
+   printf("%10lu %14.1f %14.1f %14.1f\n", numSchedules, idleNs, busyNs, loadNs);
+}
+
+int main(void)
+{
+   static const unsigned long sizes[] = { 10, 100, 1000, 10000, 100000 };
+   BenchmarkTimeSource_t timeSource;
+   BenchmarkOutputGroup_t outputGroup;
+   unsigned int i;
+
+   timeSource.interface.api = &timeSourceApi;
+   outputGroup.interface.api = &outputGroupApi;
+
+   printf("wheel slots: %lu\n", (unsigned long)LIGHTSCHEDULER_WHEEL_SLOTS);
+   printf("%10s %14s %14s %14s\n", "schedules", "idle ns/run", "ns/due write", "ns/bulk add");
+   for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+   {
+      Measure(sizes[i], &timeSource, &outputGroup);
+   }
+
+   return 0;
+}
@@ -0,0 +1,175 @@
+/*!
+ * @file
+ * @brief Compares a linear search for due schedules over the scheduler's structure-of-arrays table
+ * with the same search over an array of structures laid out like the old Schedule_t.
+ */
+
+#include <stdio.h>
+#include "Benchmark.h"
+#include "LightScheduler.h"
+
+#define PASSES_PER_SAMPLE (200UL)
+#define MAX_BENCHMARK_SCHEDULES (100000UL)
+#define TIME_SPREAD (1000UL)
+
+typedef struct
+{
+   TimeSourceWideTickCount_t time;
+   TimeSourceWideTickCount_t period;
+   DigitalOutputChannel_t lightId;
+   bool lightState;
+   bool active;
+   uint32_t generation;
+   ScheduleIndex_t next;
+   ScheduleIndex_t prev;
+} ArrayOfStructuresSchedule_t;
+
+typedef char CapacityMustBeWholeWords[((MAX_BENCHMARK_SCHEDULES % 32) == 0) ? 1 : -1];
+
+static LightScheduler_t scheduler;
+static uint64_t storage[LIGHTSCHEDULER_STORAGE_WORDS(MAX_BENCHMARK_SCHEDULES)];
+static ArrayOfStructuresSchedule_t arrayOfStructures[MAX_BENCHMARK_SCHEDULES];
+
+static TimeSourceTickCount_t GetTicks(I_TimeSource_t *instance)
+{
+   (void)instance;
+   return 0;
+}
+
+static const I_TimeSource_Api_t timeSourceApi =
+   { GetTicks, NULL };
+
+static void Write(I_DigitalOutputGroup_t *instance, const DigitalOutputChannel_t channel, const bool state)
+{
+   (void)instance;
+   (void)channel;
+   (void)state;
+}
+
+static const I_DigitalOutputGroup_Api_t outputGroupApi =
+   { Write, NULL };
+
+static unsigned long CountDueInArrayOfStructures(unsigned long numSchedules, TimeSourceWideTickCount_t now)
+{
+   unsigned long due = 0;
+   unsigned long i;
+
+   for(i = 0; i < numSchedules; i++)
+   {
+      if(arrayOfStructures[i].active && (arrayOfStructures[i].time == now))
+      {
+         due++;
+      }
+   }
+   return due;
+}
+
+/*!
+ * Compares 32 times at once into a mask, then keeps only the active schedules.  The comparisons only
+ * read the packed time array, so the inner loop can be vectorized.  The last word is masked down to the
+ * schedules being searched; the storage holds whole words, so reading past them stays in bounds.
+ */
+static unsigned long CountDueInTable(const ScheduleTable_t *table, unsigned long numSchedules, TimeSourceWideTickCount_t now)
+{
+   unsigned long due = 0;
+   unsigned long word;
+
+   for(word = 0; word < ((numSchedules + 31) / 32); word++)
+   {
+      const TimeSourceWideTickCount_t *time = &table->time[word * 32];
+      unsigned long remaining = numSchedules - (word * 32);
+      uint32_t matches = 0;
+      unsigned int bit;
+
+      for(bit = 0; bit < 32; bit++)
+      {
+         matches |= (uint32_t)(time[bit] == now) << bit;
+      }
+
+      if(remaining < 32)
+      {
+         matches &= (1UL << remaining) - 1;
+      }
+
+      matches &= table->active[word];
+      while(matches != 0)
+      {
+         matches &= matches - 1;
+         due++;
+      }
+   }
+   return due;
+}
+
+static void Fill(unsigned long numSchedules)
+{
+   unsigned long i;
+
+   for(i = 0; i < numSchedules; i++)
+   {
+      TimeSourceWideTickCount_t time = ((i * 7919UL) % TIME_SPREAD) + 1;
+
+      LightScheduler_AddScheduleAt(&scheduler, (DigitalOutputChannel_t)i, (i & 1) != 0, time);
+      arrayOfStructures[i].time = time;
+      arrayOfStructures[i].period = 0;
+      arrayOfStructures[i].lightId = (DigitalOutputChannel_t)i;
+      arrayOfStructures[i].lightState = (i & 1) != 0;
+      arrayOfStructures[i].active = true;
+      arrayOfStructures[i].generation = 0;
+      arrayOfStructures[i].next = SCHEDULE_INDEX_NONE;
+      arrayOfStructures[i].prev = SCHEDULE_INDEX_NONE;
+   }
+}
+
+static void Measure(unsigned long numSchedules, I_DigitalOutputGroup_t *outputGroup, I_TimeSource_t *timeSource)
+{
+   unsigned long pass;
+   unsigned long aosDue = 0;
+   unsigned long soaDue = 0;
+   double start;
+   double aosNs;
+   double soaNs;
+
+   LightScheduler_InitWithStorage(&scheduler, outputGroup, timeSource, storage, MAX_BENCHMARK_SCHEDULES);
+   Fill(numSchedules);
+
+   start = Benchmark_NowInNanoseconds();
+   for(pass = 0; pass < PASSES_PER_SAMPLE; pass++)
+   {
+      aosDue += CountDueInArrayOfStructures(numSchedules, (pass % TIME_SPREAD) + 1);
+   }
+   aosNs = (Benchmark_NowInNanoseconds() - start) / (PASSES_PER_SAMPLE * numSchedules);
+
+   start = Benchmark_NowInNanoseconds();
+   for(pass = 0; pass < PASSES_PER_SAMPLE; pass++)
+   {
+      soaDue += CountDueInTable(&scheduler.schedules, numSchedules, (pass % TIME_SPREAD) + 1);
+   }
+   soaNs = (Benchmark_NowInNanoseconds() - start) / (PASSES_PER_SAMPLE * numSchedules);
+
+   if(aosDue != soaDue)
+   {
+      printf("mismatch: %lu due in array of structures, %lu in table\n", aosDue, soaDue);
+   }
+   printf("%10lu %16.3f %16.3f\n", numSchedules, aosNs, soaNs);
+}
+
+int main(void)
+{
+   static const unsigned long sizes[] = { 1000, 4000, 16000, 64000, 100000 };
+   I_TimeSource_t timeSource;
+   I_DigitalOutputGroup_t outputGroup;
+   unsigned int i;
+
+   timeSource.api = &timeSourceApi;
+   outputGroup.api = &outputGroupApi;
+
+   printf("linear search for due schedules, ns per schedule\n");
+   printf("%10s %16s %16s\n", "schedules", "array of structs", "struct of arrays");
+   for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+   {
+      Measure(sizes[i], &outputGroup, &timeSource);
+   }
+
+   return 0;
+}
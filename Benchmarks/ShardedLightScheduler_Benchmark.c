@@ -0,0 +1,107 @@
+/*!
+ * @file
+ * @brief Measures how the throughput of ShardedLightScheduler_Run scales with the number of shards.
+ */
+
+#include <stdio.h>
+#include "Benchmark.h"
+#include "ShardedLightScheduler.h"
+
+#define NUM_CHANNELS (65536UL)
+#define PERIOD (16UL)
+#define TICKS_PER_SAMPLE (2000UL)
+#define MAX_SHARDS (8UL)
+
+typedef struct
+{
+   I_TimeSource_t interface;
+   TimeSourceWideTickCount_t ticks;
+} BenchmarkTimeSource_t;
+
+static ShardedLightScheduler_t scheduler;
+static LightSchedulerShard_t shards[MAX_SHARDS];
+static uint64_t storage[LIGHTSCHEDULER_STORAGE_WORDS(NUM_CHANNELS)];
+
+static TimeSourceTickCount_t GetTicks(I_TimeSource_t *instance)
+{
+   return (TimeSourceTickCount_t)((BenchmarkTimeSource_t *)instance)->ticks;
+}
+
+static TimeSourceWideTickCount_t GetWideTicks(I_TimeSource_t *instance)
+{
+   return ((BenchmarkTimeSource_t *)instance)->ticks;
+}
+
+static const I_TimeSource_Api_t timeSourceApi =
+   { GetTicks, GetWideTicks };
+
+static void Write(I_DigitalOutputGroup_t *instance, const DigitalOutputChannel_t channel, const bool state)
+{
+   (void)instance;
+   (void)channel;
+   (void)state;
+}
+
+static const I_DigitalOutputGroup_Api_t outputGroupApi =
+   { Write, NULL };
+
+/*!
+ * Every channel has a recurring schedule, staggered so that NUM_CHANNELS / PERIOD schedules are due on
+ * every tick.
+ */
+static void Measure(uint32_t numShards, BenchmarkTimeSource_t *timeSource, I_DigitalOutputGroup_t *outputGroup)
+{
+   unsigned long i;
+   double start;
+   double ns;
+
+   timeSource->ticks = 0;
+   if(!ShardedLightScheduler_Init(
+         &scheduler,
+         outputGroup,
+         &timeSource->interface,
+         shards,
+         numShards,
+         storage,
+         (ScheduleIndex_t)(NUM_CHANNELS / numShards)))
+   {
+      printf("%10lu could not start worker threads\n", (unsigned long)numShards);
+      return;
+   }
+
+   for(i = 0; i < NUM_CHANNELS; i++)
+   {
+      ShardedLightScheduler_AddRecurringSchedule(&scheduler, (DigitalOutputChannel_t)i, (i & 1) != 0, 1 + (i % PERIOD), PERIOD);
+   }
+
+   start = Benchmark_NowInNanoseconds();
+   for(i = 0; i < TICKS_PER_SAMPLE; i++)
+   {
+      timeSource->ticks++;
+      ShardedLightScheduler_Run(&scheduler);
+   }
+   ns = Benchmark_NowInNanoseconds() - start;
+
+   ShardedLightScheduler_Destroy(&scheduler);
+
+   printf("%10lu %14.1f %14.2f\n", (unsigned long)numShards, ns / TICKS_PER_SAMPLE / 1000.0, ns / (TICKS_PER_SAMPLE * (NUM_CHANNELS / PERIOD)));
+}
+
+int main(void)
+{
+   BenchmarkTimeSource_t timeSource;
+   I_DigitalOutputGroup_t outputGroup;
+   uint32_t numShards;
+
+   timeSource.interface.api = &timeSourceApi;
+   outputGroup.api = &outputGroupApi;
+
+   printf("%lu channels, %lu due per tick\n", NUM_CHANNELS, NUM_CHANNELS / PERIOD);
+   printf("%10s %14s %14s\n", "shards", "us/tick", "ns/due write");
+   for(numShards = 1; numShards <= MAX_SHARDS; numShards *= 2)
+   {
+      Measure(numShards, &timeSource, &outputGroup);
+   }
+
+   return 0;
+}
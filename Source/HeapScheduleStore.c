@@ -0,0 +1,237 @@
+/*!
+ * @file
+ * @brief Binary heap schedule store implementation.
+ */
+
+#include "HeapScheduleStore.h"
+#include "uassert.h"
+
+static const I_ScheduleStore_Api_t api =
+   {
+      HeapScheduleStore_Clear,
+      HeapScheduleStore_Insert,
+      HeapScheduleStore_Remove,
+      HeapScheduleStore_DueAt,
+      HeapScheduleStore_NextDueTime,
+      HeapScheduleStore_Find,
+      HeapScheduleStore_GetStateWord,
+      HeapScheduleStore_SetStateWord,
+      HeapScheduleStore_IsValid
+   };
+
+/*!
+ * True if schedule a comes due before schedule b.  Sequence numbers are compared as a signed
+ * difference so that they can roll over.
+ */
+static bool Before(HeapScheduleStore_t *instance, ScheduleIndex_t a, ScheduleIndex_t b)
+{
+   const TimeSourceWideTickCount_t *times = instance->schedules->time;
+
+   if(times[a] != times[b])
+   {
+      return times[a] < times[b];
+   }
+   return (int32_t)(instance->sequence[a] - instance->sequence[b]) < 0;
+}
+
+static void Place(HeapScheduleStore_t *instance, ScheduleIndex_t position, ScheduleIndex_t index)
+{
+   instance->heap[position] = index;
+   instance->position[index] = position;
+}
+
+static void SiftUp(HeapScheduleStore_t *instance, ScheduleIndex_t position, ScheduleIndex_t index)
+{
+   while(position > 0)
+   {
+      ScheduleIndex_t parent = (position - 1) / 2;
+
+      if(!Before(instance, index, instance->heap[parent]))
+      {
+         break;
+      }
+      Place(instance, position, instance->heap[parent]);
+      position = parent;
+   }
+   Place(instance, position, index);
+}
+
+static void SiftDown(HeapScheduleStore_t *instance, ScheduleIndex_t position, ScheduleIndex_t index)
+{
+   for(;;)
+   {
+      ScheduleIndex_t child = (2 * position) + 1;
+
+      if(child >= instance->count)
+      {
+         break;
+      }
+      if(((child + 1) < instance->count) && Before(instance, instance->heap[child + 1], instance->heap[child]))
+      {
+         child++;
+      }
+      if(!Before(instance, instance->heap[child], index))
+      {
+         break;
+      }
+      Place(instance, position, instance->heap[child]);
+      position = child;
+   }
+   Place(instance, position, index);
+}
+
+void HeapScheduleStore_Init(HeapScheduleStore_t *instance, const ScheduleTable_t *schedules, ScheduleIndex_t capacity)
+{
+   uassert(instance);
+   uassert(schedules);
+   instance->interface.api = &api;
+   instance->schedules = schedules;
+   instance->heap = schedules->store;
+   instance->position = schedules->store + capacity;
+   instance->sequence = schedules->store + (2 * (size_t)capacity);
+   HeapScheduleStore_Clear(&instance->interface);
+}
+
+void HeapScheduleStore_Clear(I_ScheduleStore_t *_instance)
+{
+   HeapScheduleStore_t *instance = (HeapScheduleStore_t *)_instance;
+   instance->count = 0;
+   instance->nextSequence = 0;
+}
+
+void HeapScheduleStore_Insert(I_ScheduleStore_t *_instance, ScheduleIndex_t index)
+{
+   HeapScheduleStore_t *instance = (HeapScheduleStore_t *)_instance;
+
+   instance->sequence[index] = instance->nextSequence;
+   instance->nextSequence++;
+   instance->count++;
+   SiftUp(instance, instance->count - 1, index);
+}
+
+/*!
+ * Fills the hole with the last schedule in the heap, which then moves up or down to its place.
+ */
+void HeapScheduleStore_Remove(I_ScheduleStore_t *_instance, ScheduleIndex_t index)
+{
+   HeapScheduleStore_t *instance = (HeapScheduleStore_t *)_instance;
+   ScheduleIndex_t position = instance->position[index];
+   ScheduleIndex_t last;
+
+   uassert((position < instance->count) && (instance->heap[position] == index));
+   instance->count--;
+   if(position == instance->count)
+   {
+      return;
+   }
+
+   last = instance->heap[instance->count];
+   if((position > 0) && Before(instance, last, instance->heap[(position - 1) / 2]))
+   {
+      SiftUp(instance, position, last);
+   }
+   else
+   {
+      SiftDown(instance, position, last);
+   }
+}
+
+ScheduleIndex_t HeapScheduleStore_DueAt(I_ScheduleStore_t *_instance, TimeSourceWideTickCount_t tick)
+{
+   HeapScheduleStore_t *instance = (HeapScheduleStore_t *)_instance;
+
+   if((instance->count == 0) || (instance->schedules->time[instance->heap[0]] != tick))
+   {
+      return SCHEDULE_INDEX_NONE;
+   }
+   return instance->heap[0];
+}
+
+bool HeapScheduleStore_NextDueTime(I_ScheduleStore_t *_instance, TimeSourceWideTickCount_t from, TimeSourceWideTickCount_t *tick)
+{
+   HeapScheduleStore_t *instance = (HeapScheduleStore_t *)_instance;
+   (void)from;
+
+   if(instance->count == 0)
+   {
+      return false;
+   }
+
+   *tick = instance->schedules->time[instance->heap[0]];
+   return true;
+}
+
+ScheduleIndex_t HeapScheduleStore_Find(
+   I_ScheduleStore_t *_instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time,
+   TimeSourceWideTickCount_t timeMask)
+{
+   HeapScheduleStore_t *instance = (HeapScheduleStore_t *)_instance;
+   ScheduleIndex_t found = SCHEDULE_INDEX_NONE;
+   ScheduleIndex_t position;
+
+   for(position = 0; position < instance->count; position++)
+   {
+      ScheduleIndex_t i = instance->heap[position];
+
+      if(ScheduleTable_Matches(instance->schedules, i, lightId, lightState, time, timeMask) &&
+         ((found == SCHEDULE_INDEX_NONE) || Before(instance, i, found)))
+      {
+         found = i;
+      }
+   }
+   return found;
+}
+
+uint32_t HeapScheduleStore_GetStateWord(I_ScheduleStore_t *_instance, uint32_t word)
+{
+   HeapScheduleStore_t *instance = (HeapScheduleStore_t *)_instance;
+   uassert(word < HEAPSCHEDULESTORE_STATE_WORDS);
+   return (word == 0) ? instance->count : instance->nextSequence;
+}
+
+void HeapScheduleStore_SetStateWord(I_ScheduleStore_t *_instance, uint32_t word, uint32_t value)
+{
+   HeapScheduleStore_t *instance = (HeapScheduleStore_t *)_instance;
+   uassert(word < HEAPSCHEDULESTORE_STATE_WORDS);
+   if(word == 0)
+   {
+      instance->count = value;
+   }
+   else
+   {
+      instance->nextSequence = value;
+   }
+}
+
+bool HeapScheduleStore_IsValid(I_ScheduleStore_t *_instance, ScheduleIndex_t capacity)
+{
+   HeapScheduleStore_t *instance = (HeapScheduleStore_t *)_instance;
+   ScheduleIndex_t position;
+
+   if(instance->count > capacity)
+   {
+      return false;
+   }
+
+   for(position = 0; position < instance->count; position++)
+   {
+      ScheduleIndex_t index = instance->heap[position];
+
+      if((index >= capacity) || (instance->position[index] != position))
+      {
+         return false;
+      }
+   }
+
+   for(position = 1; position < instance->count; position++)
+   {
+      if(Before(instance, instance->heap[position], instance->heap[(position - 1) / 2]))
+      {
+         return false;
+      }
+   }
+   return true;
+}
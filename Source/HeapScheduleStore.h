@@ -0,0 +1,59 @@
+/*!
+ * @file
+ * @brief Schedule store that keeps schedules in a binary min-heap ordered by due time, with ties broken
+ * by insertion order.  Getting the schedule due next takes constant time; inserting and removing take
+ * logarithmic time whatever order schedules are added in.
+ */
+
+#ifndef HEAPSCHEDULESTORE_H
+#define HEAPSCHEDULESTORE_H
+
+#include "I_ScheduleStore.h"
+
+/*!
+ * Number of columns of the schedule table used by the store: the heap, the position of each schedule
+ * in the heap and the sequence number each schedule was inserted with.
+ */
+#define HEAPSCHEDULESTORE_COLUMNS (3)
+
+/*!
+ * Number of words of fixed state: the size of the heap and the next sequence number.
+ */
+#define HEAPSCHEDULESTORE_STATE_WORDS (2)
+
+typedef struct
+{
+   I_ScheduleStore_t interface;
+   const ScheduleTable_t *schedules;
+   ScheduleIndex_t *heap;
+   ScheduleIndex_t *position;
+   uint32_t *sequence;
+   ScheduleIndex_t count;
+   uint32_t nextSequence;
+} HeapScheduleStore_t;
+
+/*!
+ * Initialize an empty heap store.
+ * @param instance The store.
+ * @param schedules The schedule table.  Its store column must hold HEAPSCHEDULESTORE_COLUMNS * capacity
+ *    indices.
+ * @param capacity Number of schedules in the table.
+ */
+void HeapScheduleStore_Init(HeapScheduleStore_t *instance, const ScheduleTable_t *schedules, ScheduleIndex_t capacity);
+
+void HeapScheduleStore_Clear(I_ScheduleStore_t *instance);
+void HeapScheduleStore_Insert(I_ScheduleStore_t *instance, ScheduleIndex_t index);
+void HeapScheduleStore_Remove(I_ScheduleStore_t *instance, ScheduleIndex_t index);
+ScheduleIndex_t HeapScheduleStore_DueAt(I_ScheduleStore_t *instance, TimeSourceWideTickCount_t tick);
+bool HeapScheduleStore_NextDueTime(I_ScheduleStore_t *instance, TimeSourceWideTickCount_t from, TimeSourceWideTickCount_t *tick);
+ScheduleIndex_t HeapScheduleStore_Find(
+   I_ScheduleStore_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time,
+   TimeSourceWideTickCount_t timeMask);
+uint32_t HeapScheduleStore_GetStateWord(I_ScheduleStore_t *instance, uint32_t word);
+void HeapScheduleStore_SetStateWord(I_ScheduleStore_t *instance, uint32_t word, uint32_t value);
+bool HeapScheduleStore_IsValid(I_ScheduleStore_t *instance, ScheduleIndex_t capacity);
+
+#endif
@@ -0,0 +1,44 @@
+/*!
+ * @file
+ * @brief Generic free-running cycle counter, such as a CPU cycle counter or a fast hardware timer.
+ */
+
+#ifndef I_CYCLECOUNTER_H
+#define I_CYCLECOUNTER_H
+
+#include <stdint.h>
+
+/*!
+ * Cycle count.  Wraps; differences between two counts are correct across one wrap.
+ */
+typedef uint32_t CycleCount_t;
+
+/*!
+ * Cycle counter object.
+ */
+typedef struct
+{
+   /*!
+    * Cycle counter API used to interact with the cycle counter object.
+    */
+   const struct I_CycleCounter_Api_t *api;
+} I_CycleCounter_t;
+
+/*!
+ * Interface for interacting with a cycle counter.  API should be accessed using wrapper calls below.
+ */
+typedef struct I_CycleCounter_Api_t
+{
+   /*!
+    * Get the current count from a cycle counter.
+    * @pre instance != NULL
+    * @param instance The cycle counter.
+    * @return The current cycle count.
+    */
+   CycleCount_t (*GetCycles)(I_CycleCounter_t *instance);
+} I_CycleCounter_Api_t;
+
+#define CycleCounter_GetCycles(instance) \
+   (instance)->api->GetCycles((instance))
+
+#endif
@@ -8,10 +8,20 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "uassert.h"
 
 typedef uint16_t DigitalOutputChannel_t;
 
+/*!
+ * A state to write to a digital output channel.
+ */
+typedef struct
+{
+   DigitalOutputChannel_t channel;
+   bool state;
+} DigitalOutputWrite_t;
+
 struct I_DigitalOutputGroup_Api_t;
 
 /*!
@@ -31,6 +41,12 @@ typedef struct
 typedef struct I_DigitalOutputGroup_Api_t
 {
    void (*Write)(I_DigitalOutputGroup_t *instance, const DigitalOutputChannel_t channel, const bool state);
+
+   /*!
+    * Write to several channels in one transaction, in order.  Optional, NULL if the group can only
+    * write one channel at a time.
+    */
+   void (*WriteMany)(I_DigitalOutputGroup_t *instance, const DigitalOutputWrite_t *writes, const uint16_t count);
 } I_DigitalOutputGroup_Api_t;
 
 /*!
@@ -43,4 +59,23 @@ typedef struct I_DigitalOutputGroup_Api_t
 #define DigitalOutputGroup_Write(instance, channel, state) \
    (instance)->api->Write((instance), (channel), (state))
 
+/*!
+ * Check whether a digital output group can write several channels in one transaction.
+ * @pre instance != NULL
+ * @param instance The digital output group.
+ */
+#define DigitalOutputGroup_HasWriteMany(instance) \
+   ((instance)->api->WriteMany != NULL)
+
+/*!
+ * Write to several digital output channels in one transaction, in order.
+ * @pre instance != NULL
+ * @pre DigitalOutputGroup_HasWriteMany(instance)
+ * @param instance The digital output group.
+ * @param writes The channels and the states to write to them.
+ * @param count The number of writes.
+ */
+#define DigitalOutputGroup_WriteMany(instance, writes, count) \
+   (instance)->api->WriteMany((instance), (writes), (count))
+
 #endif
@@ -0,0 +1,192 @@
+/*!
+ * @file
+ * @brief Generic schedule store, which orders the schedules of a light scheduler by due time.  The
+ * schedules themselves live in a schedule table owned by the scheduler; a store only keeps track of the
+ * indices of the schedules inserted into it, in its own columns of the table and in its fixed state.
+ */
+
+#ifndef I_SCHEDULESTORE_H
+#define I_SCHEDULESTORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "I_TimeSource.h"
+#include "I_DigitalOutputGroup.h"
+
+/*!
+ * Index of a schedule in the scheduler's storage.
+ */
+typedef uint32_t ScheduleIndex_t;
+
+/*!
+ * Marks the end of a list of schedules, or that there is no such schedule.
+ */
+#define SCHEDULE_INDEX_NONE ((ScheduleIndex_t)UINT32_MAX)
+
+/*!
+ * Number of words in a bitset with one bit per schedule.
+ */
+#define LIGHTSCHEDULER_SCHEDULE_BITSET_WORDS(capacity) (((capacity) + 31) / 32)
+
+/*!
+ * Schedules stored as parallel arrays rather than an array of structures, so a pass over one field
+ * (such as the due times) only touches that field's cache lines.  The active and light state flags are
+ * bitsets with one bit per schedule.  Schedules stay in their slot for as long as they are active, so
+ * that handles and links stay valid.  live is a permutation of the slots: its first numSchedules
+ * entries are the active schedules and the rest are free, and livePosition is the position of a slot
+ * in live.  store holds the columns of the schedule store.
+ */
+typedef struct
+{
+   TimeSourceWideTickCount_t *time;
+   TimeSourceWideTickCount_t *period;
+   uint32_t *active;
+   uint32_t *lightState;
+   uint32_t *generation;
+   ScheduleIndex_t *live;
+   ScheduleIndex_t *livePosition;
+   ScheduleIndex_t *store;
+   DigitalOutputChannel_t *lightId;
+} ScheduleTable_t;
+
+/*!
+ * True if a schedule writes lightState to lightId, at a time whose bits in timeMask are time.
+ */
+#define ScheduleTable_Matches(table, index, id, state, when, timeMask) \
+   (((table)->lightId[(index)] == (id)) && \
+      ((((table)->lightState[(index) / 32] & (1UL << ((index) % 32))) != 0) == (state)) && \
+      (((table)->time[(index)] & (timeMask)) == (when)))
+
+/*!
+ * Schedule store object.
+ */
+typedef struct
+{
+   /*!
+    * Schedule store API used to interact with the schedule store object.
+    */
+   const struct I_ScheduleStore_Api_t *api;
+} I_ScheduleStore_t;
+
+/*!
+ * Interface for ordering schedules by due time.  API should be accessed using wrapper calls below.
+ * Schedules due at the same tick come due in the order they were inserted.
+ */
+typedef struct I_ScheduleStore_Api_t
+{
+   /*!
+    * Remove every schedule from a store.
+    * @pre instance != NULL
+    * @param instance The schedule store.
+    */
+   void (*Clear)(I_ScheduleStore_t *instance);
+
+   /*!
+    * Insert a schedule at its due time.
+    * @pre instance != NULL
+    * @param instance The schedule store.
+    * @param index The schedule.  Its time must be set and it must not already be in the store.
+    */
+   void (*Insert)(I_ScheduleStore_t *instance, ScheduleIndex_t index);
+
+   /*!
+    * Remove a schedule, without changing its due time.
+    * @pre instance != NULL
+    * @param instance The schedule store.
+    * @param index The schedule.  Must be in the store.
+    */
+   void (*Remove)(I_ScheduleStore_t *instance, ScheduleIndex_t index);
+
+   /*!
+    * Get the schedule that comes due first at a tick.
+    * @pre instance != NULL
+    * @param instance The schedule store.
+    * @param tick The tick.  No schedule in the store may be due before it.
+    * @return The schedule, or SCHEDULE_INDEX_NONE if none is due at tick.
+    */
+   ScheduleIndex_t (*DueAt)(I_ScheduleStore_t *instance, TimeSourceWideTickCount_t tick);
+
+   /*!
+    * Find the earliest due time.
+    * @pre instance != NULL
+    * @param instance The schedule store.
+    * @param from No schedule in the store may be due before this tick.
+    * @param tick Set to the earliest due time, if the store is not empty.
+    * @return True if the store is not empty.
+    */
+   bool (*NextDueTime)(I_ScheduleStore_t *instance, TimeSourceWideTickCount_t from, TimeSourceWideTickCount_t *tick);
+
+   /*!
+    * Find a schedule by what it does, see ScheduleTable_Matches.  If several match, finds the one due
+    * first, and of those due at the same time the one inserted first.
+    * @pre instance != NULL
+    * @param instance The schedule store.
+    * @param lightId The light ID of the schedule.
+    * @param lightState The state the schedule writes.
+    * @param time The due time of the schedule, masked with timeMask.
+    * @param timeMask The bits of the due time to compare.  Either UINT64_MAX or UINT16_MAX.
+    * @return The schedule, or SCHEDULE_INDEX_NONE if there is none.
+    */
+   ScheduleIndex_t (*Find)(
+      I_ScheduleStore_t *instance,
+      DigitalOutputChannel_t lightId,
+      bool lightState,
+      TimeSourceWideTickCount_t time,
+      TimeSourceWideTickCount_t timeMask);
+
+   /*!
+    * Get a word of the fixed state of a store, that is kept outside of the schedule table, for saving.
+    * @pre instance != NULL
+    * @param instance The schedule store.
+    * @param word The word, less than the number of state words of the store.
+    * @return The value of the word.
+    */
+   uint32_t (*GetStateWord)(I_ScheduleStore_t *instance, uint32_t word);
+
+   /*!
+    * Set a word of the fixed state of a store, to restore a saved state along with its table columns.
+    * @pre instance != NULL
+    * @param instance The schedule store.
+    * @param word The word, less than the number of state words of the store.
+    * @param value The saved value of the word.
+    */
+   void (*SetStateWord)(I_ScheduleStore_t *instance, uint32_t word, uint32_t value);
+
+   /*!
+    * Check a restored state, so that a corrupted one is rejected instead of indexing out of the table.
+    * @pre instance != NULL
+    * @param instance The schedule store.
+    * @param capacity Number of schedules in the table.
+    * @return True if every schedule the store refers to, and every link between them, is in the table.
+    */
+   bool (*IsValid)(I_ScheduleStore_t *instance, ScheduleIndex_t capacity);
+} I_ScheduleStore_Api_t;
+
+#define ScheduleStore_Clear(instance) \
+   (instance)->api->Clear((instance))
+
+#define ScheduleStore_Insert(instance, index) \
+   (instance)->api->Insert((instance), (index))
+
+#define ScheduleStore_Remove(instance, index) \
+   (instance)->api->Remove((instance), (index))
+
+#define ScheduleStore_DueAt(instance, tick) \
+   (instance)->api->DueAt((instance), (tick))
+
+#define ScheduleStore_NextDueTime(instance, from, tick) \
+   (instance)->api->NextDueTime((instance), (from), (tick))
+
+#define ScheduleStore_Find(instance, lightId, lightState, time, timeMask) \
+   (instance)->api->Find((instance), (lightId), (lightState), (time), (timeMask))
+
+#define ScheduleStore_GetStateWord(instance, word) \
+   (instance)->api->GetStateWord((instance), (word))
+
+#define ScheduleStore_SetStateWord(instance, word, value) \
+   (instance)->api->SetStateWord((instance), (word), (value))
+
+#define ScheduleStore_IsValid(instance, capacity) \
+   (instance)->api->IsValid((instance), (capacity))
+
+#endif
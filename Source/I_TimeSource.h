@@ -7,12 +7,18 @@
 #define I_TIMESOURCE_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 /*!
  * Tick count.
  */
 typedef uint16_t TimeSourceTickCount_t;
 
+/*!
+ * Wide tick count.  Wide enough that it never wraps in practice.
+ */
+typedef uint64_t TimeSourceWideTickCount_t;
+
 /*!
  * Time source object.
  */
@@ -36,9 +42,43 @@ typedef struct I_TimeSource_Api_t
     * @return The current tick count.
     */
    TimeSourceTickCount_t (*GetTicks)(I_TimeSource_t *instance);
+
+   /*!
+    * Get the current wide tick count from a time source.  Optional, NULL if the time source only
+    * provides a wrapping tick count.
+    * @pre instance != NULL
+    * @param instance The time source.
+    * @return The current wide tick count.  The low bits must match GetTicks.
+    */
+   TimeSourceWideTickCount_t (*GetWideTicks)(I_TimeSource_t *instance);
 } I_TimeSource_Api_t;
 
 #define TimeSource_GetTicks(instance) \
    (instance)->api->GetTicks((instance))
 
+#define TimeSource_HasWideTicks(instance) \
+   ((instance)->api->GetWideTicks != NULL)
+
+#define TimeSource_GetWideTicks(instance) \
+   (instance)->api->GetWideTicks((instance))
+
+/*!
+ * Number of ticks from then to now, correct across one rollover of the tick count.
+ */
+#define TimeSource_TicksSince(now, then) \
+   ((TimeSourceTickCount_t)((TimeSourceTickCount_t)(now) - (TimeSourceTickCount_t)(then)))
+
+/*!
+ * True if tick count a is after b, assuming they are less than half the tick range apart.
+ */
+#define TimeSource_IsAfter(a, b) \
+   ((TimeSource_TicksSince((a), (b)) != 0) && (TimeSource_TicksSince((a), (b)) < (UINT16_MAX / 2 + 1)))
+
+/*!
+ * Extends a tick count read after wideTicks into a wide tick count.  Correct as long as ticks is
+ * read less than one rollover after wideTicks.
+ */
+#define TimeSource_ExtendTicks(wideTicks, ticks) \
+   ((TimeSourceWideTickCount_t)(wideTicks) + TimeSource_TicksSince((ticks), (wideTicks)))
+
 #endif
@@ -6,60 +6,1263 @@
 #include "LightScheduler.h"
 #include "uassert.h"
 
+typedef char WriteBatchMustFitInCount[((LIGHTSCHEDULER_WRITE_BATCH_SIZE > 0) && (LIGHTSCHEDULER_WRITE_BATCH_SIZE <= UINT16_MAX)) ? 1 : -1];
+
+#if LIGHTSCHEDULER_STATS
+#define COUNT(instance, counter, amount) ((instance)->stats.counter += (amount))
+#else
+#define COUNT(instance, counter, amount)
+#endif
+
+static ScheduleIndex_t BitsetWords(ScheduleIndex_t count)
+{
+   return LIGHTSCHEDULER_SCHEDULE_BITSET_WORDS(count);
+}
+
+static bool BitIsSet(const uint32_t *bits, ScheduleIndex_t index)
+{
+   return (bits[index / 32] & (1UL << (index % 32))) != 0;
+}
+
+static void SetBit(uint32_t *bits, ScheduleIndex_t index)
+{
+   bits[index / 32] |= (1UL << (index % 32));
+}
+
+static void ClearBit(uint32_t *bits, ScheduleIndex_t index)
+{
+   bits[index / 32] &= ~(1UL << (index % 32));
+}
+
+static void WriteBit(uint32_t *bits, ScheduleIndex_t index, bool value)
+{
+   if(value)
+   {
+      SetBit(bits, index);
+   }
+   else
+   {
+      ClearBit(bits, index);
+   }
+}
+
+static TimeSourceWideTickCount_t CurrentTime(LightScheduler_t *instance)
+{
+   if(TimeSource_HasWideTicks(instance->timeSource))
+   {
+      return TimeSource_GetWideTicks(instance->timeSource);
+   }
+   return TimeSource_ExtendTicks(instance->lastTick, TimeSource_GetTicks(instance->timeSource));
+}
+
+/*!
+ * Earliest tick that a newly added schedule can be due at.
+ */
+static TimeSourceWideTickCount_t FirstUnprocessedTick(LightScheduler_t *instance)
+{
+   return instance->hasRun ? (instance->lastTick + 1) : 0;
+}
+
+/*!
+ * First occurrence of a recurring schedule that has not been processed yet.
+ */
+static TimeSourceWideTickCount_t FirstUnprocessedOccurrence(
+   LightScheduler_t *instance,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period)
+{
+   TimeSourceWideTickCount_t first = FirstUnprocessedTick(instance);
+
+   if(start >= first)
+   {
+      return start;
+   }
+   return start + (period * (((first - start) + period - 1) / period));
+}
+
+static bool LightIsIndexed(LightScheduler_t *instance, DigitalOutputChannel_t lightId)
+{
+   return (instance->lightHead != NULL) && (lightId < instance->lightChannels);
+}
+
+static void LinkIntoLightIndex(LightScheduler_t *instance, ScheduleIndex_t index)
+{
+   DigitalOutputChannel_t lightId = instance->schedules.lightId[index];
+   ScheduleIndex_t next;
+
+   if(!LightIsIndexed(instance, lightId))
+   {
+      return;
+   }
+
+   next = instance->lightHead[lightId];
+   instance->lightPrev[index] = SCHEDULE_INDEX_NONE;
+   instance->lightNext[index] = next;
+   if(next != SCHEDULE_INDEX_NONE)
+   {
+      instance->lightPrev[next] = index;
+   }
+   instance->lightHead[lightId] = index;
+}
+
+static void UnlinkFromLightIndex(LightScheduler_t *instance, ScheduleIndex_t index)
+{
+   DigitalOutputChannel_t lightId = instance->schedules.lightId[index];
+   ScheduleIndex_t prev;
+   ScheduleIndex_t next;
+
+   if(!LightIsIndexed(instance, lightId))
+   {
+      return;
+   }
+
+   prev = instance->lightPrev[index];
+   next = instance->lightNext[index];
+   if(prev == SCHEDULE_INDEX_NONE)
+   {
+      instance->lightHead[lightId] = next;
+   }
+   else
+   {
+      instance->lightNext[prev] = next;
+   }
+
+   if(next != SCHEDULE_INDEX_NONE)
+   {
+      instance->lightPrev[next] = prev;
+   }
+}
+
+/*!
+ * Links every active schedule into the list for its light.
+ */
+static void RebuildLightIndex(LightScheduler_t *instance)
+{
+   ScheduleIndex_t i;
+
+   if(instance->lightHead == NULL)
+   {
+      return;
+   }
+
+   for(i = 0; i < instance->lightChannels; i++)
+   {
+      instance->lightHead[i] = SCHEDULE_INDEX_NONE;
+   }
+
+   for(i = instance->numSchedules; i > 0; i--)
+   {
+      LinkIntoLightIndex(instance, instance->schedules.live[i - 1]);
+   }
+}
+
+/*!
+ * Returns whichever of two schedules is due first.  earliest may be SCHEDULE_INDEX_NONE.
+ */
+static ScheduleIndex_t EarlierSchedule(LightScheduler_t *instance, ScheduleIndex_t earliest, ScheduleIndex_t candidate)
+{
+   if((earliest == SCHEDULE_INDEX_NONE) || (instance->schedules.time[candidate] < instance->schedules.time[earliest]))
+   {
+      return candidate;
+   }
+   return earliest;
+}
+
+static void Place(ScheduleTable_t *schedules, ScheduleIndex_t position, ScheduleIndex_t index)
+{
+   schedules->live[position] = index;
+   schedules->livePosition[index] = position;
+}
+
+/*!
+ * Swaps a schedule with the last active one, so that its slot becomes the first free slot and is the
+ * next one to be reused.
+ */
+static void RemoveFromLiveSet(LightScheduler_t *instance, ScheduleIndex_t index)
+{
+   ScheduleTable_t *schedules = &instance->schedules;
+   ScheduleIndex_t last = schedules->live[instance->numSchedules - 1];
+
+   Place(schedules, schedules->livePosition[index], last);
+   Place(schedules, instance->numSchedules - 1, index);
+   instance->numSchedules--;
+}
+
+static void ReleaseSchedule(LightScheduler_t *instance, ScheduleIndex_t index)
+{
+   UnlinkFromLightIndex(instance, index);
+   RemoveFromLiveSet(instance, index);
+   ClearBit(instance->schedules.active, index);
+   instance->schedules.generation[index]++;
+}
+
+/*!
+ * Finds the earliest due time.  Every stored schedule must be due at or after from.
+ */
+static void UpdateNextDue(LightScheduler_t *instance, TimeSourceWideTickCount_t from)
+{
+   instance->hasNextDue = LightSchedulerStore_NextDueTime(&instance->store.interface, from, &instance->nextDue);
+}
+
+/*!
+ * The next due time is the earliest of the stored schedules, so when the schedule due then goes the
+ * search for the new one can start from its time rather than from the first unprocessed tick.
+ */
+static void RetireSchedule(LightScheduler_t *instance, ScheduleIndex_t index)
+{
+   TimeSourceWideTickCount_t time = instance->schedules.time[index];
+
+   LightSchedulerStore_Remove(&instance->store.interface, index);
+   ReleaseSchedule(instance, index);
+   COUNT(instance, removes, 1);
+
+   if(time == instance->nextDue)
+   {
+      UpdateNextDue(instance, time);
+   }
+}
+
+static ScheduleHandle_t AddSchedule(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time,
+   TimeSourceWideTickCount_t period)
+{
+   ScheduleHandle_t handle;
+   ScheduleIndex_t i;
+
+   handle.index = SCHEDULE_INDEX_NONE;
+   handle.generation = 0;
+   if(instance->numSchedules == instance->capacity)
+   {
+      COUNT(instance, rejectedAdds, 1);
+      return handle;
+   }
+
+   i = instance->schedules.live[instance->numSchedules];
+   instance->numSchedules++;
+   instance->schedules.lightId[i] = lightId;
+   WriteBit(instance->schedules.lightState, i, lightState);
+   instance->schedules.time[i] = time;
+   instance->schedules.period[i] = period;
+   SetBit(instance->schedules.active, i);
+   LightSchedulerStore_Insert(&instance->store.interface, i);
+   LinkIntoLightIndex(instance, i);
+   COUNT(instance, adds, 1);
+
+   if(!instance->hasNextDue || (time < instance->nextDue))
+   {
+      instance->nextDue = time;
+      instance->hasNextDue = true;
+   }
+
+   handle.index = i;
+   handle.generation = instance->schedules.generation[i];
+   return handle;
+}
+
+/*!
+ * Moves the table cursor to the first entry due at or after from.
+ */
+static void SeekTable(LightScheduler_t *instance, TimeSourceWideTickCount_t from)
+{
+   const LightScheduleTable_t *table = instance->table;
+   TimeSourceWideTickCount_t offset = from;
+   uint32_t low = 0;
+   uint32_t high = table->count;
+
+   instance->tableBase = 0;
+   if(table->period > 0)
+   {
+      offset = from % table->period;
+      instance->tableBase = from - offset;
+   }
+
+   while(low < high)
+   {
+      uint32_t middle = low + ((high - low) / 2);
+
+      if(table->entries[middle].time < offset)
+      {
+         low = middle + 1;
+      }
+      else
+      {
+         high = middle;
+      }
+   }
+
+   instance->tableCursor = low;
+   if((low == table->count) && (table->period > 0))
+   {
+      instance->tableBase += table->period;
+      instance->tableCursor = 0;
+   }
+}
+
+static bool TableDueTick(LightScheduler_t *instance, TimeSourceWideTickCount_t *tick)
+{
+   if((instance->table == NULL) || (instance->tableCursor == instance->table->count))
+   {
+      return false;
+   }
+
+   *tick = instance->tableBase + instance->table->entries[instance->tableCursor].time;
+   return true;
+}
+
+/*!
+ * Earliest tick with a table entry or a schedule due.
+ */
+static bool DueTick(LightScheduler_t *instance, TimeSourceWideTickCount_t *tick)
+{
+   TimeSourceWideTickCount_t tableTick;
+
+   if(!TableDueTick(instance, &tableTick))
+   {
+      *tick = instance->nextDue;
+      return instance->hasNextDue;
+   }
+
+   *tick = (instance->hasNextDue && (instance->nextDue < tableTick)) ? instance->nextDue : tableTick;
+   return true;
+}
+
+static void FlushWrites(LightScheduler_t *instance)
+{
+   if(instance->numPendingWrites > 0)
+   {
+      DigitalOutputGroup_WriteMany(instance->lights, instance->pendingWrites, instance->numPendingWrites);
+      instance->numPendingWrites = 0;
+   }
+}
+
+/*!
+ * Records the state written to a channel.  Returns false if the channel is known to already be in that
+ * state.  The first half of the shadow says which channels are known, the second half holds their
+ * states.
+ */
+static bool UpdateShadow(LightScheduler_t *instance, DigitalOutputChannel_t channel, bool state)
+{
+   uint32_t word = channel / 32;
+   uint32_t bit = 1UL << (channel % 32);
+   uint32_t *known;
+   uint32_t *states;
+
+   if((instance->shadow == NULL) || (channel >= instance->shadowChannels))
+   {
+      return true;
+   }
+
+   known = &instance->shadow[word];
+   states = &instance->shadow[(LIGHTSCHEDULER_SHADOW_WORDS(instance->shadowChannels) / 2) + word];
+
+   if((*known & bit) && (((*states & bit) != 0) == state))
+   {
+      instance->elidedWrites++;
+      return false;
+   }
+
+   *known |= bit;
+   if(state)
+   {
+      *states |= bit;
+   }
+   else
+   {
+      *states &= ~bit;
+   }
+   return true;
+}
+
+static void Write(LightScheduler_t *instance, DigitalOutputChannel_t channel, bool state)
+{
+   if(!UpdateShadow(instance, channel, state))
+   {
+      return;
+   }
+   COUNT(instance, writes, 1);
+
+   if(!DigitalOutputGroup_HasWriteMany(instance->lights))
+   {
+      DigitalOutputGroup_Write(instance->lights, channel, state);
+      return;
+   }
+
+   if(instance->numPendingWrites == LIGHTSCHEDULER_WRITE_BATCH_SIZE)
+   {
+      FlushWrites(instance);
+   }
+   instance->pendingWrites[instance->numPendingWrites].channel = channel;
+   instance->pendingWrites[instance->numPendingWrites].state = state;
+   instance->numPendingWrites++;
+}
+
+/*!
+ * Runs the schedules due at tick, in the order the store has them.  Repeating schedules are moved to
+ * their next occurrence, to the next period when catching up and past now otherwise.  Returns false if
+ * the budget ran out first.
+ */
+static bool RunTick(LightScheduler_t *instance, TimeSourceWideTickCount_t tick, TimeSourceWideTickCount_t now, bool catchingUp, uint32_t *budget)
+{
+   ScheduleTable_t *schedules = &instance->schedules;
+   ScheduleIndex_t i;
+
+   while((i = LightSchedulerStore_DueAt(&instance->store.interface, tick)) != SCHEDULE_INDEX_NONE)
+   {
+      TimeSourceWideTickCount_t period = schedules->period[i];
+
+      if(*budget == 0)
+      {
+         return false;
+      }
+      (*budget)--;
+
+      LightSchedulerStore_Remove(&instance->store.interface, i);
+      COUNT(instance, schedulesEvaluated, 1);
+
+      if(catchingUp || (tick == now))
+      {
+         Write(instance, schedules->lightId[i], BitIsSet(schedules->lightState, i));
+      }
+
+      if(period == 0)
+      {
+         ReleaseSchedule(instance, i);
+      }
+      else
+      {
+         if(catchingUp)
+         {
+            schedules->time[i] += period;
+         }
+         else
+         {
+            schedules->time[i] += period * (((now - schedules->time[i]) / period) + 1);
+         }
+         LightSchedulerStore_Insert(&instance->store.interface, i);
+      }
+   }
+   return true;
+}
+
+/*!
+ * Writes the table entries due at tick, which start at the cursor.  Returns false if the budget ran out
+ * first.
+ */
+static bool RunTableTick(LightScheduler_t *instance, TimeSourceWideTickCount_t tick, TimeSourceWideTickCount_t now, bool catchingUp, uint32_t *budget)
+{
+   const LightScheduleTable_t *table = instance->table;
+   TimeSourceWideTickCount_t entryTick;
+
+   while(TableDueTick(instance, &entryTick) && (entryTick == tick))
+   {
+      const LightScheduleEntry_t *entry = &table->entries[instance->tableCursor];
+
+      if(*budget == 0)
+      {
+         return false;
+      }
+      (*budget)--;
+
+      COUNT(instance, schedulesEvaluated, 1);
+      if(catchingUp || (tick == now))
+      {
+         Write(instance, entry->lightId, entry->lightState);
+      }
+
+      instance->tableCursor++;
+      if((instance->tableCursor == table->count) && (table->period > 0))
+      {
+         instance->tableBase += table->period;
+         instance->tableCursor = 0;
+      }
+   }
+   return true;
+}
+
+static bool RemoveSchedule(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time,
+   TimeSourceWideTickCount_t timeMask)
+{
+   ScheduleIndex_t i = LightSchedulerStore_Find(&instance->store.interface, lightId, lightState, time, timeMask);
+
+   if(i == SCHEDULE_INDEX_NONE)
+   {
+      return false;
+   }
+
+   RetireSchedule(instance, i);
+   return true;
+}
+
+static bool RemoveRecurringSchedule(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period)
+{
+   ScheduleTable_t *schedules = &instance->schedules;
+   ScheduleIndex_t position;
+
+   for(position = 0; position < instance->numSchedules; position++)
+   {
+      ScheduleIndex_t i = schedules->live[position];
+
+      if((schedules->period[i] == period) && (schedules->lightId[i] == lightId) && (BitIsSet(schedules->lightState, i) == lightState) &&
+         (schedules->time[i] >= start) && (((schedules->time[i] - start) % period) == 0))
+      {
+         RetireSchedule(instance, i);
+         return true;
+      }
+   }
+   return false;
+}
+
+/*!
+ * Copies a command into the queue.  Only the producer writes commandHead.  It reads commandTail with
+ * acquire ordering so that the consumer is done with a slot before it is reused, and publishes the
+ * command with release ordering so that the consumer sees all of its fields.
+ */
+static bool QueueCommand(LightScheduler_t *instance, const LightSchedulerCommand_t *command)
+{
+   uint32_t head = instance->commandHead;
+   uint32_t tail = __atomic_load_n(&instance->commandTail, __ATOMIC_ACQUIRE);
+
+   if((head - tail) > instance->commandMask)
+   {
+      return false;
+   }
+
+   instance->commands[head & instance->commandMask] = *command;
+   __atomic_store_n(&instance->commandHead, head + 1, __ATOMIC_RELEASE);
+   return true;
+}
+
+static void RunCommand(LightScheduler_t *instance, const LightSchedulerCommand_t *command)
+{
+   TimeSourceWideTickCount_t first = FirstUnprocessedTick(instance);
+
+   switch(command->type)
+   {
+      case LightSchedulerCommand_AddScheduleAt:
+         AddSchedule(instance, command->lightId, command->lightState, (command->time < first) ? first : command->time, 0);
+         break;
+
+      case LightSchedulerCommand_AddRecurringSchedule:
+         AddSchedule(
+            instance,
+            command->lightId,
+            command->lightState,
+            FirstUnprocessedOccurrence(instance, command->time, command->period),
+            command->period);
+         break;
+
+      case LightSchedulerCommand_RemoveScheduleAt:
+         RemoveSchedule(instance, command->lightId, command->lightState, command->time, UINT64_MAX);
+         break;
+
+      case LightSchedulerCommand_RemoveRecurringSchedule:
+         RemoveRecurringSchedule(instance, command->lightId, command->lightState, command->time, command->period);
+         break;
+
+      case LightSchedulerCommand_RemoveScheduleByHandle:
+         LightScheduler_RemoveScheduleByHandle(instance, command->handle);
+         break;
+
+      default:
+         uassert(false);
+         break;
+   }
+}
+
+/*!
+ * Runs every command published so far.  Only the consumer writes commandTail, and it reads commandHead
+ * with acquire ordering so that the fields of published commands are visible.
+ */
+static void DrainCommands(LightScheduler_t *instance)
+{
+   uint32_t head;
+   uint32_t tail = instance->commandTail;
+
+   if(instance->commands == NULL)
+   {
+      return;
+   }
+
+   head = __atomic_load_n(&instance->commandHead, __ATOMIC_ACQUIRE);
+   while(tail != head)
+   {
+      RunCommand(instance, &instance->commands[tail & instance->commandMask]);
+      tail++;
+      __atomic_store_n(&instance->commandTail, tail, __ATOMIC_RELEASE);
+   }
+}
+
 void LightScheduler_Init(LightScheduler_t *instance, I_DigitalOutputGroup_t *lights, I_TimeSource_t *timeSource)
 {
+   uassert(instance);
+   LightScheduler_InitWithStorage(instance, lights, timeSource, instance->defaultStorage, MAX_SCHEDULES);
+}
+
+void LightScheduler_InitAroundStorage(
+   LightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   uint64_t *storage,
+   ScheduleIndex_t capacity)
+{
+   ScheduleTable_t *schedules = &instance->schedules;
+
    uassert(instance);
    uassert(lights);
    uassert(timeSource);
+   uassert(storage);
+   uassert(capacity > 0);
+   uassert(capacity < SCHEDULE_INDEX_NONE);
    instance->timeSource = timeSource;
    instance->lights = lights;
+   instance->capacity = capacity;
+   instance->numSchedules = 0;
+   instance->lastTick = 0;
+   instance->hasRun = false;
+   instance->hasNextDue = false;
+   instance->catchUp = false;
+   instance->runPending = false;
+   instance->numPendingWrites = 0;
+   instance->shadow = NULL;
+   instance->shadowChannels = 0;
+   instance->elidedWrites = 0;
+   instance->lightHead = NULL;
+   instance->lightChannels = 0;
+   instance->commands = NULL;
+   instance->table = NULL;
+#if LIGHTSCHEDULER_STATS
+   instance->cycleCounter = NULL;
+   LightScheduler_ResetStats(instance);
+#endif
+
+   schedules->time = storage;
+   schedules->period = schedules->time + capacity;
+   schedules->active = (uint32_t *)(schedules->period + capacity);
+   schedules->lightState = schedules->active + BitsetWords(capacity);
+   schedules->generation = schedules->lightState + BitsetWords(capacity);
+   schedules->live = schedules->generation + capacity;
+   schedules->livePosition = schedules->live + capacity;
+   schedules->store = schedules->livePosition + capacity;
+   schedules->lightId = (DigitalOutputChannel_t *)(schedules->store + (LIGHTSCHEDULER_STORE_COLUMNS * (size_t)capacity));
+
+   LightSchedulerStore_Init(&instance->store, schedules, capacity);
+}
+
+void LightScheduler_InitWithStorage(
+   LightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   uint64_t *storage,
+   ScheduleIndex_t capacity)
+{
+   ScheduleTable_t *schedules = &instance->schedules;
+   ScheduleIndex_t i;
+
+   LightScheduler_InitAroundStorage(instance, lights, timeSource, storage, capacity);
+
+   for(i = 0; i < BitsetWords(capacity); i++)
+   {
+      schedules->active[i] = 0;
+   }
+
+   for(i = 0; i < capacity; i++)
+   {
+      schedules->generation[i] = 0;
+      Place(schedules, i, i);
+   }
 }
 
-void LightScheduler_AddSchedule(LightScheduler_t *instance, uint8_t lightId, bool lightState, TimeSourceTickCount_t time)
+void LightScheduler_RebuildIndex(LightScheduler_t *instance)
 {
+   ScheduleTable_t *schedules;
+   TimeSourceWideTickCount_t first;
+   ScheduleIndex_t firstFree;
+   ScheduleIndex_t i;
+
    uassert(instance);
-   uint8_t sizeSchedules = sizeof(instance->schedules) / sizeof(instance->schedules[0]);
-   uint8_t i;
-   for(i = 0; i < sizeSchedules; i++)
+   schedules = &instance->schedules;
+   first = FirstUnprocessedTick(instance);
+   LightSchedulerStore_Clear(&instance->store.interface);
+   instance->numSchedules = 0;
+   firstFree = instance->capacity;
+
+   for(i = instance->capacity; i > 0; i--)
    {
-      if(instance->schedules[i].active == false)
+      ScheduleIndex_t index = i - 1;
+
+      if(!BitIsSet(schedules->active, index))
+      {
+         firstFree--;
+         Place(schedules, firstFree, index);
+      }
+      else
       {
-         instance->schedules[i].lightId = lightId;
-         instance->schedules[i].lightState = lightState;
-         instance->schedules[i].time = time;
-         instance->schedules[i].active = true;
+         if(schedules->period[index] == 0)
+         {
+            schedules->time[index] = (schedules->time[index] < first) ? first : schedules->time[index];
+         }
+         else
+         {
+            schedules->time[index] = FirstUnprocessedOccurrence(instance, schedules->time[index], schedules->period[index]);
+         }
+         LightSchedulerStore_Insert(&instance->store.interface, index);
+         Place(schedules, instance->numSchedules, index);
          instance->numSchedules++;
-         return;
       }
    }
+
+   RebuildLightIndex(instance);
+   UpdateNextDue(instance, first);
 }
 
-void LightScheduler_Run(LightScheduler_t *instance)
+ScheduleHandle_t LightScheduler_AddSchedule(LightScheduler_t *instance, uint8_t lightId, bool lightState, TimeSourceTickCount_t time)
+{
+   uassert(instance);
+
+   if(!instance->hasRun)
+   {
+      return AddSchedule(instance, lightId, lightState, time, LIGHTSCHEDULER_PERIOD_TICK_COUNT_BEFORE_FIRST_RUN);
+   }
+   return AddSchedule(instance, lightId, lightState, TimeSource_ExtendTicks(instance->lastTick + 1, time), 0);
+}
+
+ScheduleHandle_t LightScheduler_AddScheduleAt(LightScheduler_t *instance, DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time)
+{
+   uassert(instance);
+   TimeSourceWideTickCount_t first = FirstUnprocessedTick(instance);
+   return AddSchedule(instance, lightId, lightState, (time < first) ? first : time, 0);
+}
+
+ScheduleHandle_t LightScheduler_AddRecurringSchedule(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period)
+{
+   uassert(instance);
+   uassert(period > 0);
+   uassert(period < UINT64_MAX);
+   return AddSchedule(instance, lightId, lightState, FirstUnprocessedOccurrence(instance, start, period), period);
+}
+
+bool LightScheduler_AddSchedules(LightScheduler_t *instance, const LightScheduleEntry_t *entries, uint32_t count, ScheduleHandle_t *handles)
 {
+   TimeSourceWideTickCount_t first;
+   uint32_t i;
+
    uassert(instance);
-   TimeSourceTickCount_t time = TimeSource_GetTicks(instance->timeSource);
-   uint8_t i;
+   uassert((entries != NULL) || (count == 0));
+   if(count > (instance->capacity - instance->numSchedules))
+   {
+      COUNT(instance, rejectedAdds, count);
+      return false;
+   }
+
+   first = FirstUnprocessedTick(instance);
+   for(i = 0; i < count; i++)
+   {
+      TimeSourceWideTickCount_t time = (entries[i].time < first) ? first : entries[i].time;
+      ScheduleHandle_t handle = AddSchedule(instance, entries[i].lightId, entries[i].lightState, time, 0);
+
+      if(handles != NULL)
+      {
+         handles[i] = handle;
+      }
+   }
+   return true;
+}
+
+#if LIGHTSCHEDULER_STATS
+static CycleCount_t StartMeasuring(LightScheduler_t *instance)
+{
+   return (instance->cycleCounter != NULL) ? CycleCounter_GetCycles(instance->cycleCounter) : 0;
+}
+
+/*!
+ * Counts a run and its latency in the histogram bucket for the position of its highest set bit.
+ */
+static void RecordRun(LightScheduler_t *instance, CycleCount_t start)
+{
+   instance->stats.runs++;
+   if(instance->cycleCounter != NULL)
+   {
+      CycleCount_t elapsed = CycleCounter_GetCycles(instance->cycleCounter) - start;
+      uint32_t bucket = 0;
+
+      while(((elapsed >>= 1) != 0) && (bucket < (LIGHTSCHEDULER_LATENCY_BUCKETS - 1)))
+      {
+         bucket++;
+      }
+      instance->stats.runLatency[bucket]++;
+   }
+}
+#endif
+
+/*!
+ * Moves the schedules added by tick count before the first run to the first time at or after now that
+ * the tick count reaches their time, and makes them one-shots.
+ */
+static void ExtendTickCountSchedules(LightScheduler_t *instance, TimeSourceWideTickCount_t now)
+{
+   ScheduleTable_t *schedules = &instance->schedules;
+   ScheduleIndex_t position;
+   bool extended = false;
+
+   for(position = 0; position < instance->numSchedules; position++)
+   {
+      ScheduleIndex_t i = schedules->live[position];
+
+      if(schedules->period[i] == LIGHTSCHEDULER_PERIOD_TICK_COUNT_BEFORE_FIRST_RUN)
+      {
+         LightSchedulerStore_Remove(&instance->store.interface, i);
+         schedules->time[i] = TimeSource_ExtendTicks(now, schedules->time[i]);
+         schedules->period[i] = 0;
+         LightSchedulerStore_Insert(&instance->store.interface, i);
+         extended = true;
+      }
+   }
+
+   if(extended)
+   {
+      UpdateNextDue(instance, 0);
+   }
+}
+
+/*!
+ * Starts a run up to the current time, which LightScheduler_Run and LightScheduler_RunWithBudget
+ * continue until every schedule due by then has been processed.
+ */
+static void StartRun(LightScheduler_t *instance)
+{
+   TimeSourceWideTickCount_t now = CurrentTime(instance);
+   TimeSourceWideTickCount_t tick;
+
+   if(!instance->hasRun)
+   {
+      ExtendTickCountSchedules(instance, now);
+   }
+
+#if LIGHTSCHEDULER_STATS
+   if(instance->hasRun && (now > (instance->lastTick + 1)))
+   {
+      instance->stats.missedTicks += now - instance->lastTick - 1;
+   }
+#endif
+
+   instance->runNow = now;
+   instance->runCatchingUp = instance->catchUp && instance->hasRun;
+   instance->runPending = true;
+
+   if(!instance->runCatchingUp && TableDueTick(instance, &tick) && (tick < now))
+   {
+      SeekTable(instance, now);
+   }
+}
+
+/*!
+ * Processes due ticks of the started run in order until it is complete or the budget runs out.  A run
+ * that stops part way through a tick leaves the rest of that tick's schedules due at it, so the ticks
+ * before it count as processed.
+ */
+static bool ContinueRun(LightScheduler_t *instance, uint32_t *budget)
+{
+   TimeSourceWideTickCount_t now = instance->runNow;
+   bool catchingUp = instance->runCatchingUp;
+   TimeSourceWideTickCount_t tick;
 
-   for(i = 0; i < instance->numSchedules; i++)
+   while(DueTick(instance, &tick) && (tick <= now))
    {
-      if((time == instance->schedules[i].time) && (instance->schedules[i].active))
+      bool finished = RunTableTick(instance, tick, now, catchingUp, budget);
+
+      if(finished && instance->hasNextDue && (instance->nextDue == tick))
+      {
+         finished = RunTick(instance, tick, now, catchingUp, budget);
+         if(finished)
+         {
+            UpdateNextDue(instance, tick + 1);
+         }
+      }
+
+      if(!finished)
       {
-         DigitalOutputGroup_Write(instance->lights, instance->schedules[i].lightId, instance->schedules[i].lightState);
+         if(tick > 0)
+         {
+            instance->lastTick = tick - 1;
+            instance->hasRun = true;
+         }
+         return false;
       }
    }
+
+   instance->lastTick = now;
+   instance->hasRun = true;
+   instance->runPending = false;
+   return true;
+}
+
+/*!
+ * Finishes an unfinished run first, then starts a new one if there is budget left.
+ */
+static bool Run(LightScheduler_t *instance, uint32_t budget)
+{
+#if LIGHTSCHEDULER_STATS
+   CycleCount_t start = StartMeasuring(instance);
+#endif
+   bool resuming = instance->runPending;
+   bool complete;
+
+   DrainCommands(instance);
+   if(!resuming)
+   {
+      StartRun(instance);
+   }
+
+   complete = ContinueRun(instance, &budget);
+   if(complete && resuming && (budget > 0))
+   {
+      StartRun(instance);
+      complete = ContinueRun(instance, &budget);
+   }
+   FlushWrites(instance);
+
+#if LIGHTSCHEDULER_STATS
+   RecordRun(instance, start);
+#endif
+   return complete;
+}
+
+void LightScheduler_Run(LightScheduler_t *instance)
+{
+   uassert(instance);
+   Run(instance, UINT32_MAX);
+}
+
+bool LightScheduler_RunWithBudget(LightScheduler_t *instance, uint32_t budget)
+{
+   uassert(instance);
+   uassert(budget > 0);
+   return Run(instance, budget);
+}
+
+bool LightScheduler_GetNextDueTime(LightScheduler_t *instance, TimeSourceWideTickCount_t *nextDueTime)
+{
+   uassert(instance);
+   uassert(nextDueTime);
+
+   return DueTick(instance, nextDueTime);
+}
+
+void LightScheduler_SetCatchUp(LightScheduler_t *instance, bool enabled)
+{
+   uassert(instance);
+   instance->catchUp = enabled;
+}
+
+void LightScheduler_EnableWriteSuppression(LightScheduler_t *instance, uint32_t *shadow, uint32_t channelCount)
+{
+   uassert(instance);
+   uassert(shadow);
+   instance->shadow = shadow;
+   instance->shadowChannels = channelCount;
+   LightScheduler_ResetWriteSuppression(instance);
+}
+
+void LightScheduler_ResetWriteSuppression(LightScheduler_t *instance)
+{
+   uint32_t i;
+
+   uassert(instance);
+   for(i = 0; i < LIGHTSCHEDULER_SHADOW_WORDS(instance->shadowChannels) / 2; i++)
+   {
+      instance->shadow[i] = 0;
+   }
+}
+
+uint32_t LightScheduler_GetElidedWriteCount(LightScheduler_t *instance)
+{
+   uassert(instance);
+   return instance->elidedWrites;
+}
+
+void LightScheduler_EnableLightIndex(LightScheduler_t *instance, ScheduleIndex_t *index, uint32_t channelCount)
+{
+   uassert(instance);
+   uassert(index);
+   instance->lightHead = index;
+   instance->lightNext = index + channelCount;
+   instance->lightPrev = instance->lightNext + instance->capacity;
+   instance->lightChannels = channelCount;
+   RebuildLightIndex(instance);
+}
+
+#if LIGHTSCHEDULER_STATS
+void LightScheduler_SetCycleCounter(LightScheduler_t *instance, I_CycleCounter_t *cycleCounter)
+{
+   uassert(instance);
+   instance->cycleCounter = cycleCounter;
+}
+
+const LightSchedulerStats_t *LightScheduler_GetStats(LightScheduler_t *instance)
+{
+   uassert(instance);
+   return &instance->stats;
+}
+
+void LightScheduler_ResetStats(LightScheduler_t *instance)
+{
+   uint32_t i;
+
+   uassert(instance);
+   instance->stats.runs = 0;
+   instance->stats.schedulesEvaluated = 0;
+   instance->stats.writes = 0;
+   instance->stats.adds = 0;
+   instance->stats.removes = 0;
+   instance->stats.rejectedAdds = 0;
+   instance->stats.missedTicks = 0;
+   for(i = 0; i < LIGHTSCHEDULER_LATENCY_BUCKETS; i++)
+   {
+      instance->stats.runLatency[i] = 0;
+   }
+}
+#endif
+
+bool LightScheduler_RemoveScheduleByHandle(LightScheduler_t *instance, ScheduleHandle_t handle)
+{
+   uassert(instance);
+
+   if((handle.index >= instance->capacity) || !BitIsSet(instance->schedules.active, handle.index) ||
+      (instance->schedules.generation[handle.index] != handle.generation))
+   {
+      return false;
+   }
+
+   RetireSchedule(instance, handle.index);
+   return true;
 }
 
 void LightScheduler_RemoveSchedule(LightScheduler_t *instance, uint8_t lightId, bool lightState, TimeSourceTickCount_t time)
 {
-   uint8_t i;
+   bool removed;
+
+   uassert(instance);
+   removed = RemoveSchedule(instance, lightId, lightState, time, UINT16_MAX);
+   uassert(removed);
+}
+
+void LightScheduler_RemoveScheduleAt(LightScheduler_t *instance, DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time)
+{
+   bool removed;
+
+   uassert(instance);
+   removed = RemoveSchedule(instance, lightId, lightState, time, UINT64_MAX);
+   uassert(removed);
+}
+
+void LightScheduler_RemoveRecurringSchedule(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period)
+{
+   bool removed;
+
+   uassert(instance);
+   uassert(period > 0);
+   uassert(period < UINT64_MAX);
+   removed = RemoveRecurringSchedule(instance, lightId, lightState, start, period);
+   uassert(removed);
+}
+
+void LightScheduler_SetConstantTable(LightScheduler_t *instance, const LightScheduleTable_t *table)
+{
+   uassert(instance);
+   instance->table = table;
+   if(table != NULL)
+   {
+      uassert((table->entries != NULL) || (table->count == 0));
+      uassert((table->period == 0) || (table->count == 0) || (table->entries[table->count - 1].time < table->period));
+      SeekTable(instance, FirstUnprocessedTick(instance));
+   }
+}
+
+void LightScheduler_EnableCommandQueue(LightScheduler_t *instance, LightSchedulerCommand_t *commands, uint32_t size)
+{
+   uassert(instance);
+   uassert(commands);
+   uassert((size > 0) && ((size & (size - 1)) == 0));
+   instance->commands = commands;
+   instance->commandMask = size - 1;
+   instance->commandHead = 0;
+   instance->commandTail = 0;
+}
+
+bool LightScheduler_QueueScheduleAt(LightScheduler_t *instance, DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time)
+{
+   LightSchedulerCommand_t command;
+
+   uassert(instance);
+   uassert(instance->commands);
+   command.type = LightSchedulerCommand_AddScheduleAt;
+   command.lightId = lightId;
+   command.lightState = lightState;
+   command.time = time;
+   return QueueCommand(instance, &command);
+}
+
+bool LightScheduler_QueueRecurringSchedule(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period)
+{
+   LightSchedulerCommand_t command;
+
+   uassert(instance);
+   uassert(instance->commands);
+   uassert(period > 0);
+   uassert(period < UINT64_MAX);
+   command.type = LightSchedulerCommand_AddRecurringSchedule;
+   command.lightId = lightId;
+   command.lightState = lightState;
+   command.time = start;
+   command.period = period;
+   return QueueCommand(instance, &command);
+}
+
+bool LightScheduler_QueueRemoveScheduleAt(LightScheduler_t *instance, DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time)
+{
+   LightSchedulerCommand_t command;
+
+   uassert(instance);
+   uassert(instance->commands);
+   command.type = LightSchedulerCommand_RemoveScheduleAt;
+   command.lightId = lightId;
+   command.lightState = lightState;
+   command.time = time;
+   return QueueCommand(instance, &command);
+}
+
+bool LightScheduler_QueueRemoveRecurringSchedule(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period)
+{
+   LightSchedulerCommand_t command;
+
+   uassert(instance);
+   uassert(instance->commands);
+   uassert(period > 0);
+   uassert(period < UINT64_MAX);
+   command.type = LightSchedulerCommand_RemoveRecurringSchedule;
+   command.lightId = lightId;
+   command.lightState = lightState;
+   command.time = start;
+   command.period = period;
+   return QueueCommand(instance, &command);
+}
+
+bool LightScheduler_QueueRemoveScheduleByHandle(LightScheduler_t *instance, ScheduleHandle_t handle)
+{
+   LightSchedulerCommand_t command;
+
+   uassert(instance);
+   uassert(instance->commands);
+   command.type = LightSchedulerCommand_RemoveScheduleByHandle;
+   command.handle = handle;
+   return QueueCommand(instance, &command);
+}
+
+uint32_t LightScheduler_RemoveAllForLight(LightScheduler_t *instance, DigitalOutputChannel_t lightId)
+{
+   ScheduleTable_t *schedules;
+   uint32_t removed = 0;
+   ScheduleIndex_t position = 0;
+
+   uassert(instance);
+   schedules = &instance->schedules;
+
+   if(LightIsIndexed(instance, lightId))
+   {
+      while(instance->lightHead[lightId] != SCHEDULE_INDEX_NONE)
+      {
+         RetireSchedule(instance, instance->lightHead[lightId]);
+         removed++;
+      }
+      return removed;
+   }
+
+   while(position < instance->numSchedules)
+   {
+      if(schedules->lightId[schedules->live[position]] == lightId)
+      {
+         RetireSchedule(instance, schedules->live[position]);
+         removed++;
+      }
+      else
+      {
+         position++;
+      }
+   }
+   return removed;
+}
+
+bool LightScheduler_GetNextForLight(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   TimeSourceWideTickCount_t *time,
+   bool *lightState)
+{
+   ScheduleTable_t *schedules;
+   ScheduleIndex_t earliest = SCHEDULE_INDEX_NONE;
+   ScheduleIndex_t i;
+
    uassert(instance);
-   for(i = 0; i < instance->numSchedules; i++)
+   uassert(time);
+   uassert(lightState);
+   schedules = &instance->schedules;
+
+   if(LightIsIndexed(instance, lightId))
+   {
+      for(i = instance->lightHead[lightId]; i != SCHEDULE_INDEX_NONE; i = instance->lightNext[i])
+      {
+         earliest = EarlierSchedule(instance, earliest, i);
+      }
+   }
+   else
    {
-      if((instance->schedules[i].lightId == lightId) && (instance->schedules[i].lightState == lightState) && (instance->schedules[i].time == time))
+      for(i = 0; i < instance->numSchedules; i++)
       {
-         instance->schedules[i].active = false;
-         return;
+         if(schedules->lightId[schedules->live[i]] == lightId)
+         {
+            earliest = EarlierSchedule(instance, earliest, schedules->live[i]);
+         }
       }
    }
-   uassert(false);
-}
\ No newline at end of file
+
+   if(earliest == SCHEDULE_INDEX_NONE)
+   {
+      return false;
+   }
+
+   *time = schedules->time[earliest];
+   *lightState = BitIsSet(schedules->lightState, earliest);
+   return true;
+}
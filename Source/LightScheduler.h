@@ -12,23 +12,203 @@
 
 #include "I_TimeSource.h"
 #include "I_DigitalOutputGroup.h"
+#include "I_CycleCounter.h"
+#include "LightSchedulerStore.h"
 
+/*!
+ * Capacity of the storage embedded in the scheduler, used by LightScheduler_Init.  Use
+ * LightScheduler_InitWithStorage for larger tables.
+ */
+#ifndef MAX_SCHEDULES
 #define MAX_SCHEDULES (10)
+#endif
+
+/*!
+ * Number of writes collected by a run before they are submitted to a digital output group that
+ * supports writing several channels at once.
+ */
+#ifndef LIGHTSCHEDULER_WRITE_BATCH_SIZE
+#define LIGHTSCHEDULER_WRITE_BATCH_SIZE (16)
+#endif
+
+/*!
+ * Set to 1 to keep the counters and Run latency histogram read with LightScheduler_GetStats.  When 0, the
+ * stats, their storage and their functions are compiled out.
+ */
+#ifndef LIGHTSCHEDULER_STATS
+#define LIGHTSCHEDULER_STATS (0)
+#endif
+
+/*!
+ * Number of words of shadow storage needed to suppress redundant writes to channelCount channels.
+ */
+#define LIGHTSCHEDULER_SHADOW_WORDS(channelCount) (2 * (((channelCount) + 31) / 32))
+
+/*!
+ * Number of schedule indices of storage needed to index the schedules of channelCount channels in a
+ * scheduler with room for capacity schedules.
+ */
+#define LIGHTSCHEDULER_LIGHT_INDEX_SIZE(channelCount, capacity) ((channelCount) + (2 * (capacity)))
+
+/*!
+ * Number of words of storage needed for capacity schedules.
+ */
+#define LIGHTSCHEDULER_STORAGE_WORDS(capacity) \
+   ((2 * (capacity)) + \
+      (((((2 * LIGHTSCHEDULER_SCHEDULE_BITSET_WORDS(capacity)) + ((3 + LIGHTSCHEDULER_STORE_COLUMNS) * (capacity))) * sizeof(uint32_t)) + \
+          ((capacity) * sizeof(DigitalOutputChannel_t)) + 7) / 8))
+
+/*!
+ * Identifies a schedule for removal.  The generation is bumped every time a storage slot is freed, so a
+ * handle to a schedule that has already run or been removed does not match the slot's next occupant.
+ */
+typedef struct
+{
+   ScheduleIndex_t index;
+   uint32_t generation;
+} ScheduleHandle_t;
 
+/*!
+ * True if a handle was returned for a schedule that was added, false if the scheduler was full.
+ */
+#define ScheduleHandle_IsValid(handle) ((handle).index != SCHEDULE_INDEX_NONE)
+
+/*!
+ * One entry of a constant schedule table.
+ */
 typedef struct
 {
-   TimeSourceTickCount_t time;
+   TimeSourceWideTickCount_t time;
    DigitalOutputChannel_t lightId;
    bool lightState;
-   bool active;
-} Schedule_t;
+} LightScheduleEntry_t;
 
+/*!
+ * A schedule table that is never changed and can live in ROM.  Entries must be sorted by time; entries
+ * with the same time are written in table order.  With a period, the entry times are offsets into each
+ * period and must be less than the period.
+ */
 typedef struct
 {
-   Schedule_t schedules[MAX_SCHEDULES];
-   uint8_t numSchedules;
+   const LightScheduleEntry_t *entries;
+   uint32_t count;
+   TimeSourceWideTickCount_t period;
+} LightScheduleTable_t;
+
+/*!
+ * Initializers for constant schedule tables, for example:
+ *
+ *    static const LightScheduleEntry_t factoryEntries[] = {
+ *       LIGHTSCHEDULER_ENTRY(100, 1, true),
+ *       LIGHTSCHEDULER_ENTRY(500, 1, false)
+ *    };
+ *    static const LightScheduleTable_t factoryTable = LIGHTSCHEDULER_TABLE(factoryEntries, 1000);
+ */
+#define LIGHTSCHEDULER_ENTRY(time, lightId, lightState) { (time), (lightId), (lightState) }
+#define LIGHTSCHEDULER_TABLE(entries, period) { (entries), sizeof(entries) / sizeof((entries)[0]), (period) }
+
+enum
+{
+   LightSchedulerCommand_AddScheduleAt,
+   LightSchedulerCommand_AddRecurringSchedule,
+   LightSchedulerCommand_RemoveScheduleAt,
+   LightSchedulerCommand_RemoveRecurringSchedule,
+   LightSchedulerCommand_RemoveScheduleByHandle
+};
+typedef uint8_t LightSchedulerCommandType_t;
+
+/*!
+ * A change to the schedules queued by LightScheduler_Queue* and applied by the next run.
+ */
+typedef struct
+{
+   TimeSourceWideTickCount_t time;
+   TimeSourceWideTickCount_t period;
+   ScheduleHandle_t handle;
+   DigitalOutputChannel_t lightId;
+   bool lightState;
+   LightSchedulerCommandType_t type;
+} LightSchedulerCommand_t;
+
+/*!
+ * Number of ticks after which the tick count rolls over.
+ */
+#define LIGHTSCHEDULER_TICK_ROLLOVER_PERIOD ((TimeSourceWideTickCount_t)UINT16_MAX + 1)
+
+/*!
+ * Period that marks a schedule added by tick count before the first run.  Until a run has read the time
+ * there is no wide time to extend the tick count against, so the schedule is kept at its tick count and
+ * extended by the first run.
+ */
+#define LIGHTSCHEDULER_PERIOD_TICK_COUNT_BEFORE_FIRST_RUN ((TimeSourceWideTickCount_t)UINT64_MAX)
+
+/*!
+ * Periods for recurring schedules that repeat daily or weekly, for a time source ticking at
+ * ticksPerSecond.
+ */
+#define LIGHTSCHEDULER_DAILY_PERIOD(ticksPerSecond) ((TimeSourceWideTickCount_t)(ticksPerSecond) * 60 * 60 * 24)
+#define LIGHTSCHEDULER_WEEKLY_PERIOD(ticksPerSecond) (LIGHTSCHEDULER_DAILY_PERIOD(ticksPerSecond) * 7)
+
+#if LIGHTSCHEDULER_STATS
+/*!
+ * Number of buckets in the Run latency histogram.  Bucket n counts runs that took from 2^n up to
+ * 2^(n + 1) - 1 cycles; bucket 0 also counts runs that took 0 cycles.
+ */
+#define LIGHTSCHEDULER_LATENCY_BUCKETS (32)
+
+/*!
+ * What a light scheduler has done since it was initialized or its stats were reset.
+ */
+typedef struct
+{
+   uint32_t runs;
+   uint32_t schedulesEvaluated;
+   uint32_t writes;
+   uint32_t adds;
+   uint32_t removes;
+   uint32_t rejectedAdds;
+   TimeSourceWideTickCount_t missedTicks;
+   uint32_t runLatency[LIGHTSCHEDULER_LATENCY_BUCKETS];
+} LightSchedulerStats_t;
+#endif
+
+typedef struct
+{
+   ScheduleTable_t schedules;
+   ScheduleIndex_t capacity;
+   ScheduleIndex_t numSchedules;
+   LightSchedulerStore_t store;
+   TimeSourceWideTickCount_t lastTick;
+   TimeSourceWideTickCount_t nextDue;
+   TimeSourceWideTickCount_t runNow;
+   bool hasNextDue;
+   bool hasRun;
+   bool catchUp;
+   bool runPending;
+   bool runCatchingUp;
+   uint16_t numPendingWrites;
+   DigitalOutputWrite_t pendingWrites[LIGHTSCHEDULER_WRITE_BATCH_SIZE];
+   uint32_t *shadow;
+   uint32_t shadowChannels;
+   uint32_t elidedWrites;
+   ScheduleIndex_t *lightHead;
+   ScheduleIndex_t *lightNext;
+   ScheduleIndex_t *lightPrev;
+   uint32_t lightChannels;
+   LightSchedulerCommand_t *commands;
+   uint32_t commandMask;
+   uint32_t commandHead;
+   uint32_t commandTail;
+   const LightScheduleTable_t *table;
+   uint32_t tableCursor;
+   TimeSourceWideTickCount_t tableBase;
    I_TimeSource_t *timeSource;
    I_DigitalOutputGroup_t *lights;
+#if LIGHTSCHEDULER_STATS
+   LightSchedulerStats_t stats;
+   I_CycleCounter_t *cycleCounter;
+#endif
+   uint64_t defaultStorage[LIGHTSCHEDULER_STORAGE_WORDS(MAX_SCHEDULES)];
 } LightScheduler_t;
 
 /*!
@@ -41,23 +221,325 @@ typedef struct
 void LightScheduler_Init(LightScheduler_t *instance, I_DigitalOutputGroup_t *lights, I_TimeSource_t *timeSource);
 
 /*!
- * Schedule a light to be turned on/off.
+ * Initialize a light scheduler that keeps its schedules in caller-provided storage instead of the
+ * MAX_SCHEDULES entries embedded in the scheduler.
+ * @param instance The light scheduler.
+ * @param lights A digital output group that can be used to control the lights.
+ * @param timeSource This is how the light scheduler will get the current time.
+ * @param storage Storage for the schedules.  Must hold LIGHTSCHEDULER_STORAGE_WORDS(capacity) words and
+ *    stay valid for as long as the scheduler is used.
+ * @param capacity Number of schedules that fit in storage.
+ */
+void LightScheduler_InitWithStorage(
+   LightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   uint64_t *storage,
+   ScheduleIndex_t capacity);
+
+/*!
+ * Initialize a light scheduler around storage that already holds schedules laid out by a scheduler
+ * with the same capacity and schedule store, such as a snapshot restored in place.  The storage is not
+ * changed.  The fixed state of the schedule store, the number of schedules and the times are left empty
+ * and must be restored by the caller from the same source as the storage.
+ * @param instance The light scheduler.
+ * @param lights A digital output group that can be used to control the lights.
+ * @param timeSource This is how the light scheduler will get the current time.
+ * @param storage Storage holding the schedules.  Must hold LIGHTSCHEDULER_STORAGE_WORDS(capacity) words
+ *    and stay valid for as long as the scheduler is used.
+ * @param capacity Number of schedules that fit in storage.
+ */
+void LightScheduler_InitAroundStorage(
+   LightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   uint64_t *storage,
+   ScheduleIndex_t capacity);
+
+/*!
+ * Rebuild the free slots and schedule store from the active flags and fields of every schedule in
+ * storage, for callers that change storage directly, such as a journal replay.  Generations are kept.
+ * Schedules due before the first unprocessed tick are moved to it, or to their first unprocessed
+ * occurrence if they recur.  Takes one pass over the storage.
+ * @param instance The light scheduler.
+ */
+void LightScheduler_RebuildIndex(LightScheduler_t *instance);
+
+/*!
+ * Schedule a light to be turned on/off once, the next time the tick count reaches time.  Takes a free
+ * slot in constant time, which is freed again once the schedule has run, or has been skipped by a run
+ * without catch-up.  The schedule is dropped if the scheduler is full.  Before the first run the time
+ * has not been read, so until then the schedule is reported at its tick count; the first run moves it
+ * to the first time at or after the time that run reads at which the tick count reaches time.
  * @param instance The light scheduler.
  * @param lightId The light ID that will be controlled by the scheduler.
  * @param lightState The state that will be written for the light (on/off).
  * @param time The light will be controlled when the time from the TimeSource reaches this value.
  *    The lightState should be written to the light with lightId at this time.
+ * @return A handle for removing the schedule, which is not valid if the schedule was dropped.
+ */
+ScheduleHandle_t LightScheduler_AddSchedule(LightScheduler_t *instance, uint8_t lightId, bool lightState, TimeSourceTickCount_t time);
+
+/*!
+ * Schedule a light to be turned on/off once at a wide tick count.  A time that has already been
+ * processed by a run is treated as due on the next tick.  The schedule is dropped if the scheduler
+ * is full.
+ * @param instance The light scheduler.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param time The wide tick count at which lightState will be written to the light.
+ * @return A handle for removing the schedule, which is not valid if the schedule was dropped.
+ */
+ScheduleHandle_t LightScheduler_AddScheduleAt(LightScheduler_t *instance, DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time);
+
+/*!
+ * Schedule a light to be turned on/off every period ticks, starting at a wide tick count.  After it
+ * runs, the schedule is moved to its next occurrence in place.  Occurrences that have already been
+ * processed by a run are skipped.  The schedule is dropped if the scheduler is full.
+ * @param instance The light scheduler.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param start The wide tick count of the first occurrence.
+ * @param period The number of ticks between occurrences.  Must not be 0 or UINT64_MAX.
+ * @return A handle for removing the schedule, which is not valid if the schedule was dropped.
+ */
+ScheduleHandle_t LightScheduler_AddRecurringSchedule(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period);
+
+/*!
+ * Run a constant schedule table in addition to the schedules that are added.  The table is read in
+ * place, so it costs no RAM per entry and nothing to set up.  A cursor tracks the next entry that is
+ * due; after a gap between runs without catch-up it is moved past the missed entries with a binary
+ * search.  On a tick that has both, the table's entries are written before the added schedules.
+ * @param instance The light scheduler.
+ * @param table The table, or NULL to stop running a table.  Must stay valid for as long as the
+ *    scheduler is used.  Entries for ticks that have already been processed by a run are skipped.
  */
-void LightScheduler_AddSchedule(LightScheduler_t *instance, uint8_t lightId, bool lightState, TimeSourceTickCount_t time);
+void LightScheduler_SetConstantTable(LightScheduler_t *instance, const LightScheduleTable_t *table);
 
 /*!
- * Run a light scheduler.  The light scheduler will run all schedules that are due.
+ * Enable a queue of schedule changes that can be submitted while the scheduler is running, for example
+ * from an interrupt, using the LightScheduler_Queue* functions.  The queue is lock-free with a single
+ * producer and a single consumer: only one context may submit changes, and the scheduler applies them
+ * in submission order at the start of each run.  All other functions must only be called from the
+ * context that runs the scheduler.
+ * @param instance The light scheduler.
+ * @param commands Storage for the queued changes.  Must stay valid for as long as the scheduler is used.
+ * @param size Number of changes that fit in commands.  Must be a power of two.
+ */
+void LightScheduler_EnableCommandQueue(LightScheduler_t *instance, LightSchedulerCommand_t *commands, uint32_t size);
+
+/*!
+ * Queue a schedule to turn a light on/off once at a wide tick count, as LightScheduler_AddScheduleAt
+ * does when the queue is drained.  Never blocks.
+ * @param instance The light scheduler.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param time The wide tick count at which lightState will be written to the light.
+ * @return False if the queue is full.
+ */
+bool LightScheduler_QueueScheduleAt(LightScheduler_t *instance, DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time);
+
+/*!
+ * Queue a recurring schedule, as LightScheduler_AddRecurringSchedule does when the queue is drained.
+ * Never blocks.
+ * @param instance The light scheduler.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param start The wide tick count of the first occurrence.
+ * @param period The number of ticks between occurrences.  Must not be 0 or UINT64_MAX.
+ * @return False if the queue is full.
+ */
+bool LightScheduler_QueueRecurringSchedule(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period);
+
+/*!
+ * Queue the removal of a schedule added at a wide tick count.  Never blocks.  Unlike
+ * LightScheduler_RemoveScheduleAt, the removal is ignored if there is no such schedule by the time the
+ * queue is drained.
+ * @param instance The light scheduler.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param time The wide tick count at which the schedule is due.
+ * @return False if the queue is full.
+ */
+bool LightScheduler_QueueRemoveScheduleAt(LightScheduler_t *instance, DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time);
+
+/*!
+ * Queue the removal of a recurring schedule.  Never blocks.  The removal is ignored if there is no
+ * such schedule by the time the queue is drained.
+ * @param instance The light scheduler.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param start The wide tick count of the first occurrence, as given when it was added.
+ * @param period The number of ticks between occurrences, as given when it was added.
+ * @return False if the queue is full.
+ */
+bool LightScheduler_QueueRemoveRecurringSchedule(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period);
+
+/*!
+ * Queue the removal of a schedule by handle.  Never blocks.  A stale handle is ignored.
+ * @param instance The light scheduler.
+ * @param handle The handle of the schedule.
+ * @return False if the queue is full.
+ */
+bool LightScheduler_QueueRemoveScheduleByHandle(LightScheduler_t *instance, ScheduleHandle_t handle);
+
+/*!
+ * Schedule a batch of lights to be turned on/off once, as LightScheduler_AddScheduleAt does for each
+ * entry.  The batch is checked against the free capacity first, so either every entry is added or none
+ * is.  Entries sorted by time are the cheapest to insert into the schedule store.
+ * @param instance The light scheduler.
+ * @param entries The schedules to add.
+ * @param count The number of entries.
+ * @param handles Set to the handles of the added schedules, in entry order, if not NULL.  Must hold
+ *    count handles.
+ * @return False if there was not enough room for the whole batch.
+ */
+bool LightScheduler_AddSchedules(LightScheduler_t *instance, const LightScheduleEntry_t *entries, uint32_t count, ScheduleHandle_t *handles);
+
+/*!
+ * Run a light scheduler.  Queued schedule changes are applied first.  The light scheduler will then
+ * run all schedules that are due.  The schedule store is only asked for the schedules due at the ticks
+ * being processed, so with any store but the linear one the cost of getting each due schedule does not
+ * grow with the total number of schedules.  If the digital output group can write several channels at
+ * once, the writes for a run are submitted together in batches of up to LIGHTSCHEDULER_WRITE_BATCH_SIZE,
+ * in the order the schedules came due.  The time source's wide tick count is used if it has one.
+ * Otherwise the tick count is extended by the scheduler, which requires runs to be less than 65536
+ * ticks apart.
  * @param instance The light scheduler.
  */
 void LightScheduler_Run(LightScheduler_t *instance);
 
 /*!
- * Remove a light schedule.
+ * Run a light scheduler as LightScheduler_Run does, but stop once budget due schedules and constant
+ * table entries have been processed, so that the time a run takes is bounded by the budget rather than by
+ * how many schedules come due together.  Each processed schedule writes to at most one light.  The next
+ * call resumes the unfinished run from the schedule it stopped at, against the time the run started at,
+ * so that none of its writes are dropped as missed; if the unfinished run completes with budget left
+ * over, a new run up to the current time follows.  Schedules added while a run is unfinished are due no
+ * earlier than the tick it stopped at.
+ * @param instance The light scheduler.
+ * @param budget The most due schedules to process.  Must be greater than 0.
+ * @return True if the run is complete, false if due schedules are left for the next call.
+ */
+bool LightScheduler_RunWithBudget(LightScheduler_t *instance, uint32_t budget);
+
+/*!
+ * Get the wide tick count at which the next schedule is due, so that the caller can sleep until then
+ * instead of running the scheduler every tick.  Answered in constant time; the earliest due time is
+ * kept up to date as schedules are added, run and removed.  If the time source has no wide tick count,
+ * runs must still be less than 65536 ticks apart.  Without catch-up, the scheduler must be run at
+ * exactly this tick for the schedule to run.
+ * @param instance The light scheduler.
+ * @param nextDueTime Set to the tick at which the next schedule is due, if there is one.  A time that is
+ *    not after the last run means a schedule is due on the next run.
+ * @return True if a schedule is pending.
+ */
+bool LightScheduler_GetNextDueTime(LightScheduler_t *instance, TimeSourceWideTickCount_t *nextDueTime);
+
+/*!
+ * Enable or disable catch-up.  Catch-up is disabled by default, and a run only processes the current
+ * tick, so schedules for ticks between two runs are skipped.  With catch-up enabled, a run processes
+ * every tick after the one processed by the previous run, up to and including the current tick, and
+ * runs the schedules for those ticks in chronological order.  The first run only processes the
+ * current tick.
+ * @param instance The light scheduler.
+ * @param enabled True to run schedules for ticks missed between runs.
+ */
+void LightScheduler_SetCatchUp(LightScheduler_t *instance, bool enabled);
+
+/*!
+ * Skip writes of the state a channel was last written to by the scheduler.  Suppression is disabled by
+ * default.  Channels at or above channelCount are always written.  Each channel is written the first
+ * time it comes due after suppression is enabled or reset.
+ * @param instance The light scheduler.
+ * @param shadow Storage for the last written states.  Must hold
+ *    LIGHTSCHEDULER_SHADOW_WORDS(channelCount) words and stay valid for as long as the scheduler is
+ *    used.
+ * @param channelCount The number of channels to track.
+ */
+void LightScheduler_EnableWriteSuppression(LightScheduler_t *instance, uint32_t *shadow, uint32_t channelCount);
+
+/*!
+ * Forget the last written states, for example after the outputs were written by someone else.  The
+ * next write to each channel will not be skipped.
+ * @param instance The light scheduler.
+ */
+void LightScheduler_ResetWriteSuppression(LightScheduler_t *instance);
+
+/*!
+ * Get the number of writes skipped because the channel was already in the scheduled state.
+ * @param instance The light scheduler.
+ * @return The number of skipped writes.
+ */
+uint32_t LightScheduler_GetElidedWriteCount(LightScheduler_t *instance);
+
+/*!
+ * Keep a list of the schedules of each channel, so that LightScheduler_RemoveAllForLight and
+ * LightScheduler_GetNextForLight only visit the schedules of that channel.  The lists are linked through
+ * the schedule indices, and are built from the schedules already added in one pass over them.
+ * Channels at or above channelCount are not indexed and their queries search every active schedule.
+ * The index is disabled by default, and must be enabled again after the scheduler is initialized, for
+ * example from a snapshot.
+ * @param instance The light scheduler.
+ * @param index Storage for the lists.  Must hold LIGHTSCHEDULER_LIGHT_INDEX_SIZE(channelCount, capacity)
+ *    indices, for the capacity the scheduler was initialized with, and stay valid for as long as the
+ *    scheduler is used.
+ * @param channelCount The number of channels to index.
+ */
+void LightScheduler_EnableLightIndex(LightScheduler_t *instance, ScheduleIndex_t *index, uint32_t channelCount);
+
+#if LIGHTSCHEDULER_STATS
+/*!
+ * Measure the latency of each run with a cycle counter.  Latency is not measured by default.
+ * @param instance The light scheduler.
+ * @param cycleCounter The cycle counter, or NULL to stop measuring.
+ */
+void LightScheduler_SetCycleCounter(LightScheduler_t *instance, I_CycleCounter_t *cycleCounter);
+
+/*!
+ * Get the stats of a light scheduler.  Runs count the schedules and table entries that came due, the
+ * writes submitted to the lights after suppression, and the ticks that passed between runs without a
+ * run of their own.  Adds and removes count schedules added and removed in every way, including through
+ * the command queue.  Adds rejected because the scheduler was full are counted separately.
+ * @param instance The light scheduler.
+ * @return The stats, which are updated as the scheduler is used.
+ */
+const LightSchedulerStats_t *LightScheduler_GetStats(LightScheduler_t *instance);
+
+/*!
+ * Set every counter and histogram bucket back to 0.
+ * @param instance The light scheduler.
+ */
+void LightScheduler_ResetStats(LightScheduler_t *instance);
+#endif
+
+/*!
+ * Remove a light schedule using the handle returned when it was added.  Takes constant time.  Handles
+ * to schedules that have already been removed, or that have run and were not recurring, are ignored.
+ * @param instance The light scheduler.
+ * @param handle The handle of the schedule.
+ * @return True if the schedule was removed, false if the handle was stale or not valid.
+ */
+bool LightScheduler_RemoveScheduleByHandle(LightScheduler_t *instance, ScheduleHandle_t handle);
+
+/*!
+ * Remove a light schedule.  Only the schedules in the bucket for time are searched, but duplicate
+ * schedules cannot be told apart; prefer LightScheduler_RemoveScheduleByHandle.
  * @param instance The light scheduler.
  * @param lightId The light ID that will be controlled by the scheduler.
  * @param lightState The state that will be written for the light (on/off).
@@ -66,4 +548,54 @@ void LightScheduler_Run(LightScheduler_t *instance);
  */
 void LightScheduler_RemoveSchedule(LightScheduler_t *instance, uint8_t lightId, bool lightState, TimeSourceTickCount_t time);
 
+/*!
+ * Remove a light schedule added at a wide tick count.
+ * @param instance The light scheduler.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param time The wide tick count at which the schedule is due.
+ */
+void LightScheduler_RemoveScheduleAt(LightScheduler_t *instance, DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time);
+
+/*!
+ * Remove a recurring light schedule.  Its next occurrence is not known up front, so every active
+ * schedule is searched; free slots are not visited.
+ * @param instance The light scheduler.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param start The wide tick count of the first occurrence, as given when it was added.
+ * @param period The number of ticks between occurrences, as given when it was added.
+ */
+void LightScheduler_RemoveRecurringSchedule(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period);
+
+/*!
+ * Remove every schedule of a light.  Takes time proportional to the light's own schedules if the light
+ * is indexed, see LightScheduler_EnableLightIndex.  Constant tables are not affected.
+ * @param instance The light scheduler.
+ * @param lightId The light ID.
+ * @return The number of schedules removed.
+ */
+uint32_t LightScheduler_RemoveAllForLight(LightScheduler_t *instance, DigitalOutputChannel_t lightId);
+
+/*!
+ * Get the next transition scheduled for a light: the earliest due time of its schedules and the state
+ * that will be written then.  Takes time proportional to the light's own schedules if the light is
+ * indexed, see LightScheduler_EnableLightIndex.  Constant tables are not searched.
+ * @param instance The light scheduler.
+ * @param lightId The light ID.
+ * @param time Set to the wide tick count of the next transition, if there is one.
+ * @param lightState Set to the state written at the next transition, if there is one.
+ * @return True if the light has a schedule.
+ */
+bool LightScheduler_GetNextForLight(
+   LightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   TimeSourceWideTickCount_t *time,
+   bool *lightState);
+
 #endif
@@ -0,0 +1,424 @@
+/*!
+ * @file
+ * @brief Light scheduler journal implementation.
+ */
+
+#include <string.h>
+#include "LightSchedulerJournal.h"
+#include "LightSchedulerSnapshot.h"
+#include "uassert.h"
+
+#define JOURNAL_MAGIC (0x4E4A534CUL)
+#define FLAG_HAS_RUN (1U << 0)
+
+enum
+{
+   RecordType_Add = 1,
+   RecordType_Remove = 2,
+   RecordType_Run = 3
+};
+
+typedef char ChannelsMustBeSixteenBits[(sizeof(DigitalOutputChannel_t) == 2) ? 1 : -1];
+
+typedef struct
+{
+   TimeSourceWideTickCount_t time;
+   TimeSourceWideTickCount_t period;
+   ScheduleHandle_t handle;
+   DigitalOutputChannel_t lightId;
+   bool lightState;
+   uint8_t type;
+} Record_t;
+
+static void PutU16(uint8_t *destination, uint16_t value)
+{
+   destination[0] = (uint8_t)value;
+   destination[1] = (uint8_t)(value >> 8);
+}
+
+static void PutU32(uint8_t *destination, uint32_t value)
+{
+   PutU16(destination, (uint16_t)value);
+   PutU16(destination + 2, (uint16_t)(value >> 16));
+}
+
+static void PutU64(uint8_t *destination, uint64_t value)
+{
+   PutU32(destination, (uint32_t)value);
+   PutU32(destination + 4, (uint32_t)(value >> 32));
+}
+
+static uint16_t GetU16(const uint8_t *source)
+{
+   return (uint16_t)(source[0] | (source[1] << 8));
+}
+
+static uint32_t GetU32(const uint8_t *source)
+{
+   return GetU16(source) | ((uint32_t)GetU16(source + 2) << 16);
+}
+
+static uint64_t GetU64(const uint8_t *source)
+{
+   return GetU32(source) | ((uint64_t)GetU32(source + 4) << 32);
+}
+
+/*!
+ * FNV-1a over a record, skipping the check field at offset 12.  Catches a record that was only partly
+ * written, including one left in erased flash.
+ */
+static uint32_t RecordCheck(const uint8_t *record)
+{
+   uint32_t hash = 2166136261UL;
+   uint32_t i;
+
+   for(i = 0; i < LightSchedulerJournal_RecordSize; i++)
+   {
+      if((i < 12) || (i >= 16))
+      {
+         hash = (hash ^ record[i]) * 16777619UL;
+      }
+   }
+   return hash;
+}
+
+/*!
+ * Starts the journal over.  The rest of the log is cleared so that records left from before cannot be
+ * mistaken for new ones.
+ */
+static void WriteHeader(LightSchedulerJournal_t *instance)
+{
+   uint8_t *header = instance->log;
+
+   memset(instance->log, 0, instance->size);
+   PutU32(header, JOURNAL_MAGIC);
+   PutU16(header + 4, LightSchedulerJournal_Version);
+   PutU16(header + 6, instance->scheduler->hasRun ? FLAG_HAS_RUN : 0);
+   PutU64(header + 8, instance->scheduler->lastTick);
+   instance->used = LightSchedulerJournal_HeaderSize;
+}
+
+static bool HeaderMatches(const uint8_t *log, size_t size, LightScheduler_t *scheduler)
+{
+   return (size >= LightSchedulerJournal_HeaderSize) && (GetU32(log) == JOURNAL_MAGIC) &&
+      (GetU16(log + 4) == LightSchedulerJournal_Version) && (GetU16(log + 6) == (scheduler->hasRun ? FLAG_HAS_RUN : 0)) &&
+      (GetU64(log + 8) == scheduler->lastTick);
+}
+
+static bool HasRoom(LightSchedulerJournal_t *instance)
+{
+   return (instance->size - instance->used) >= LightSchedulerJournal_RecordSize;
+}
+
+static void Append(LightSchedulerJournal_t *instance, const Record_t *record)
+{
+   uint8_t *destination = instance->log + instance->used;
+
+   destination[0] = record->type;
+   destination[1] = record->lightState ? 1 : 0;
+   PutU16(destination + 2, record->lightId);
+   PutU32(destination + 4, record->handle.index);
+   PutU32(destination + 8, record->handle.generation);
+   PutU64(destination + 16, record->time);
+   PutU64(destination + 24, record->period);
+   PutU32(destination + 12, RecordCheck(destination));
+   instance->used += LightSchedulerJournal_RecordSize;
+}
+
+/*!
+ * Decodes the record at source.  Returns false if it is not a complete record for a slot of the
+ * scheduler.
+ */
+static bool Decode(LightScheduler_t *scheduler, const uint8_t *source, Record_t *record)
+{
+   record->type = source[0];
+   record->lightState = source[1] != 0;
+   record->lightId = GetU16(source + 2);
+   record->handle.index = GetU32(source + 4);
+   record->handle.generation = GetU32(source + 8);
+   record->time = GetU64(source + 16);
+   record->period = GetU64(source + 24);
+
+   return (GetU32(source + 12) == RecordCheck(source)) && (record->handle.index < scheduler->capacity) &&
+      ((record->type == RecordType_Add) || (record->type == RecordType_Remove) || (record->type == RecordType_Run));
+}
+
+static bool BitIsSet(const uint32_t *bits, ScheduleIndex_t index)
+{
+   return (bits[index / 32] & (1UL << (index % 32))) != 0;
+}
+
+static void SetScheduleBit(uint32_t *bits, ScheduleIndex_t index, bool value)
+{
+   if(value)
+   {
+      bits[index / 32] |= (1UL << (index % 32));
+   }
+   else
+   {
+      bits[index / 32] &= ~(1UL << (index % 32));
+   }
+}
+
+/*!
+ * Extends the schedules added by tick count before the first run against the time of the first run, as
+ * that run did.
+ */
+static void ExtendTickCountSchedules(LightScheduler_t *scheduler, TimeSourceWideTickCount_t firstRun)
+{
+   ScheduleTable_t *schedules = &scheduler->schedules;
+   ScheduleIndex_t i;
+
+   for(i = 0; i < scheduler->capacity; i++)
+   {
+      if(BitIsSet(schedules->active, i) && (schedules->period[i] == LIGHTSCHEDULER_PERIOD_TICK_COUNT_BEFORE_FIRST_RUN))
+      {
+         schedules->time[i] = TimeSource_ExtendTicks(firstRun, schedules->time[i]);
+         schedules->period[i] = 0;
+      }
+   }
+}
+
+/*!
+ * Retires the one-shot schedules that the runs up to lastTick have run, as those runs did.  Recurring
+ * schedules are moved past lastTick when the index is rebuilt.
+ */
+static void RetireRunSchedules(LightScheduler_t *scheduler, TimeSourceWideTickCount_t lastTick)
+{
+   ScheduleTable_t *schedules = &scheduler->schedules;
+   ScheduleIndex_t i;
+
+   for(i = 0; i < scheduler->capacity; i++)
+   {
+      if(BitIsSet(schedules->active, i) && (schedules->period[i] == 0) && (schedules->time[i] <= lastTick))
+      {
+         SetScheduleBit(schedules->active, i, false);
+         schedules->generation[i]++;
+      }
+   }
+   scheduler->lastTick = lastTick;
+   scheduler->hasRun = true;
+}
+
+/*!
+ * Writes a record's effect straight into the scheduler's storage.  The timing wheel and free list are
+ * rebuilt once all records have been applied, and the schedules run by the last run recorded are
+ * retired just before.
+ */
+static void Apply(LightScheduler_t *scheduler, const Record_t *record, bool *ran, TimeSourceWideTickCount_t *lastTick)
+{
+   ScheduleTable_t *schedules = &scheduler->schedules;
+   ScheduleIndex_t i = record->handle.index;
+
+   if(record->type == RecordType_Run)
+   {
+      if(!scheduler->hasRun && !*ran)
+      {
+         ExtendTickCountSchedules(scheduler, record->time);
+      }
+      *ran = true;
+      *lastTick = record->time;
+   }
+   else if(record->type == RecordType_Add)
+   {
+      schedules->time[i] = record->time;
+      schedules->period[i] = record->period;
+      schedules->lightId[i] = record->lightId;
+      schedules->generation[i] = record->handle.generation;
+      SetScheduleBit(schedules->lightState, i, record->lightState);
+      SetScheduleBit(schedules->active, i, true);
+   }
+   else
+   {
+      schedules->generation[i] = record->handle.generation + 1;
+      SetScheduleBit(schedules->active, i, false);
+   }
+}
+
+static ScheduleHandle_t RecordAdd(
+   LightSchedulerJournal_t *instance,
+   ScheduleHandle_t handle,
+   DigitalOutputChannel_t lightId,
+   bool lightState)
+{
+   Record_t record;
+
+   if(ScheduleHandle_IsValid(handle))
+   {
+      record.type = RecordType_Add;
+      record.handle = handle;
+      record.lightId = lightId;
+      record.lightState = lightState;
+      record.time = instance->scheduler->schedules.time[handle.index];
+      record.period = instance->scheduler->schedules.period[handle.index];
+      Append(instance, &record);
+   }
+   return handle;
+}
+
+static ScheduleHandle_t InvalidHandle(void)
+{
+   ScheduleHandle_t handle;
+
+   handle.index = SCHEDULE_INDEX_NONE;
+   handle.generation = 0;
+   return handle;
+}
+
+void LightSchedulerJournal_Init(LightSchedulerJournal_t *instance, LightScheduler_t *scheduler, uint8_t *log, size_t size)
+{
+   uassert(instance);
+   uassert(scheduler);
+   uassert(log);
+   uassert(size >= LightSchedulerJournal_HeaderSize);
+   instance->scheduler = scheduler;
+   instance->log = log;
+   instance->size = size;
+   WriteHeader(instance);
+}
+
+bool LightSchedulerJournal_Replay(LightSchedulerJournal_t *instance, LightScheduler_t *scheduler, uint8_t *log, size_t size)
+{
+   size_t offset = LightSchedulerJournal_HeaderSize;
+   Record_t record;
+   bool ran = false;
+   TimeSourceWideTickCount_t lastTick = 0;
+
+   uassert(instance);
+   uassert(scheduler);
+   uassert(log);
+
+   if(!HeaderMatches(log, size, scheduler))
+   {
+      return false;
+   }
+
+   while(((size - offset) >= LightSchedulerJournal_RecordSize) && Decode(scheduler, log + offset, &record))
+   {
+      Apply(scheduler, &record, &ran, &lastTick);
+      offset += LightSchedulerJournal_RecordSize;
+   }
+
+   if(ran)
+   {
+      RetireRunSchedules(scheduler, lastTick);
+   }
+   LightScheduler_RebuildIndex(scheduler);
+
+   instance->scheduler = scheduler;
+   instance->log = log;
+   instance->size = size;
+   instance->used = offset;
+   return true;
+}
+
+ScheduleHandle_t LightSchedulerJournal_AddScheduleAt(
+   LightSchedulerJournal_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time)
+{
+   uassert(instance);
+
+   if(!HasRoom(instance))
+   {
+      return InvalidHandle();
+   }
+   return RecordAdd(instance, LightScheduler_AddScheduleAt(instance->scheduler, lightId, lightState, time), lightId, lightState);
+}
+
+ScheduleHandle_t LightSchedulerJournal_AddRecurringSchedule(
+   LightSchedulerJournal_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period)
+{
+   uassert(instance);
+
+   if(!HasRoom(instance))
+   {
+      return InvalidHandle();
+   }
+   return RecordAdd(
+      instance,
+      LightScheduler_AddRecurringSchedule(instance->scheduler, lightId, lightState, start, period),
+      lightId,
+      lightState);
+}
+
+bool LightSchedulerJournal_RemoveScheduleByHandle(LightSchedulerJournal_t *instance, ScheduleHandle_t handle)
+{
+   Record_t record;
+
+   uassert(instance);
+
+   if(!HasRoom(instance) || !LightScheduler_RemoveScheduleByHandle(instance->scheduler, handle))
+   {
+      return false;
+   }
+
+   record.type = RecordType_Remove;
+   record.handle = handle;
+   record.lightId = 0;
+   record.lightState = false;
+   record.time = 0;
+   record.period = 0;
+   Append(instance, &record);
+   return true;
+}
+
+bool LightSchedulerJournal_Run(LightSchedulerJournal_t *instance)
+{
+   LightScheduler_t *scheduler;
+   TimeSourceWideTickCount_t nextDue;
+   bool hadRun;
+   bool hadDue;
+   Record_t record;
+
+   uassert(instance);
+   scheduler = instance->scheduler;
+   hadRun = scheduler->hasRun;
+   hadDue = LightScheduler_GetNextDueTime(scheduler, &nextDue);
+
+   LightScheduler_Run(scheduler);
+
+   if(hadRun && (!hadDue || (nextDue > scheduler->lastTick)))
+   {
+      return true;
+   }
+
+   if(!HasRoom(instance))
+   {
+      return false;
+   }
+
+   record.type = RecordType_Run;
+   record.handle.index = 0;
+   record.handle.generation = 0;
+   record.lightId = 0;
+   record.lightState = false;
+   record.time = scheduler->lastTick;
+   record.period = 0;
+   Append(instance, &record);
+   return true;
+}
+
+size_t LightSchedulerJournal_Compact(LightSchedulerJournal_t *instance, uint8_t *snapshot, size_t size)
+{
+   size_t saved;
+
+   uassert(instance);
+   saved = LightSchedulerSnapshot_Save(instance->scheduler, snapshot, size);
+   if(saved > 0)
+   {
+      WriteHeader(instance);
+   }
+   return saved;
+}
+
+size_t LightSchedulerJournal_GetSize(LightSchedulerJournal_t *instance)
+{
+   uassert(instance);
+   return instance->used;
+}
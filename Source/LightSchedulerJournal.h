@@ -0,0 +1,138 @@
+/*!
+ * @file
+ * @brief Keeps an append-only journal of the schedules added to and removed from a light scheduler, so
+ * that a change costs one small record instead of a new snapshot.
+ *
+ * A journal is a 16-byte header followed by 32-byte records, all as fixed-width little-endian fields.
+ * The header holds the last processed tick of the scheduler when the journal was started, which ties
+ * the journal to the snapshot saved at that point.  Each record holds the schedule's slot and
+ * generation, so a replay writes every record straight into the scheduler's storage and rebuilds the
+ * timing wheel once at the end.  Records that are not complete, such as one that was being written at
+ * power loss, end the journal.
+ *
+ * Runs made through the journal record the last processed tick when a schedule came due, and on the
+ * first run.  A replay retires the one-shot schedules due by the last recorded tick and moves recurring
+ * schedules to their first occurrence after it, so schedules that already ran are not run again.  Runs
+ * in which nothing came due are not recorded, so a replay processes their ticks again, but nothing was
+ * due in them.
+ *
+ * Compaction saves a snapshot and starts the journal over.
+ */
+
+#ifndef LIGHTSCHEDULERJOURNAL_H
+#define LIGHTSCHEDULERJOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LightScheduler.h"
+
+enum
+{
+   LightSchedulerJournal_Version = 2,
+   LightSchedulerJournal_HeaderSize = 16,
+   LightSchedulerJournal_RecordSize = 32
+};
+
+typedef struct
+{
+   LightScheduler_t *scheduler;
+   uint8_t *log;
+   size_t size;
+   size_t used;
+} LightSchedulerJournal_t;
+
+/*!
+ * Start a new journal for the current schedules of a light scheduler, such as right after they have been
+ * saved to a snapshot.
+ * @param instance The journal.
+ * @param scheduler The light scheduler.  Changes made to it other than through the journal are not
+ *    recorded.
+ * @param log Where to write the journal.  It is cleared.  Must stay valid for as long as the journal is
+ *    used.
+ * @param size The size of log.  Must hold at least the header.
+ */
+void LightSchedulerJournal_Init(LightSchedulerJournal_t *instance, LightScheduler_t *scheduler, uint8_t *log, size_t size);
+
+/*!
+ * Apply the records of a journal to a light scheduler in a single pass, rebuild its timing wheel, and
+ * keep journaling after the last complete record.  The scheduler must hold the schedules the journal was
+ * started from, such as a snapshot restored with LightSchedulerSnapshot_Restore or an empty scheduler.
+ * @param instance The journal.
+ * @param scheduler The light scheduler.
+ * @param log The journal.  Must stay valid for as long as the journal is used.
+ * @param size The size of log, including the space after the last record that new records are
+ *    appended to.
+ * @return False, without changing the scheduler, if log is not a journal started from the scheduler's
+ *    current schedules.
+ */
+bool LightSchedulerJournal_Replay(LightSchedulerJournal_t *instance, LightScheduler_t *scheduler, uint8_t *log, size_t size);
+
+/*!
+ * Add a schedule to the scheduler, as LightScheduler_AddScheduleAt does, and record it.
+ * @param instance The journal.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param time The wide tick count at which lightState will be written to the light.
+ * @return A handle for removing the schedule, which is not valid if the scheduler or the journal is full.
+ */
+ScheduleHandle_t LightSchedulerJournal_AddScheduleAt(
+   LightSchedulerJournal_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time);
+
+/*!
+ * Add a recurring schedule to the scheduler, as LightScheduler_AddRecurringSchedule does, and record it.
+ * @param instance The journal.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param start The wide tick count of the first occurrence.
+ * @param period The number of ticks between occurrences.  Must not be 0 or UINT64_MAX.
+ * @return A handle for removing the schedule, which is not valid if the scheduler or the journal is full.
+ */
+ScheduleHandle_t LightSchedulerJournal_AddRecurringSchedule(
+   LightSchedulerJournal_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period);
+
+/*!
+ * Remove a schedule from the scheduler by handle, as LightScheduler_RemoveScheduleByHandle does, and
+ * record it.
+ * @param instance The journal.
+ * @param handle The handle of the schedule.
+ * @return False if the handle is stale or the journal is full, in which case nothing is removed.
+ */
+bool LightSchedulerJournal_RemoveScheduleByHandle(LightSchedulerJournal_t *instance, ScheduleHandle_t handle);
+
+/*!
+ * Run the scheduler, as LightScheduler_Run does, and record the last processed tick if a schedule came
+ * due or this is the first run.
+ * @param instance The journal.
+ * @return False if the run had to be recorded but the journal is full.  The run still happens, but a
+ *    replay would run its schedules again, so the journal should be compacted.
+ */
+bool LightSchedulerJournal_Run(LightSchedulerJournal_t *instance);
+
+/*!
+ * Save a snapshot of the scheduler and start the journal over from it, clearing the log.  The snapshot
+ * must be stored before the journal's new header, so that a journal is never replayed onto a snapshot it
+ * was not started from.
+ * @param instance The journal.
+ * @param snapshot Where to write the snapshot.
+ * @param size The size of snapshot.
+ * @return The size of the snapshot, or 0 if snapshot is too small, in which case the journal is kept.
+ */
+size_t LightSchedulerJournal_Compact(LightSchedulerJournal_t *instance, uint8_t *snapshot, size_t size);
+
+/*!
+ * Get the number of bytes of the log in use.  Only these bytes need to be stored.
+ * @param instance The journal.
+ * @return The size of the header and the records written so far.
+ */
+size_t LightSchedulerJournal_GetSize(LightSchedulerJournal_t *instance);
+
+#endif
@@ -0,0 +1,153 @@
+/*!
+ * @file
+ * @brief Light scheduler simulator implementation.
+ */
+
+#include <stddef.h>
+#include "LightSchedulerSimulator.h"
+#include "uassert.h"
+
+static TimeSourceTickCount_t GetTicks(I_TimeSource_t *timeSource)
+{
+   return (TimeSourceTickCount_t)((LightSchedulerSimulator_t *)timeSource)->now;
+}
+
+static TimeSourceWideTickCount_t GetWideTicks(I_TimeSource_t *timeSource)
+{
+   return ((LightSchedulerSimulator_t *)timeSource)->now;
+}
+
+static const I_TimeSource_Api_t timeSourceApi =
+   { GetTicks, GetWideTicks };
+
+/*!
+ * The lights are the second member, so step back to the start of the simulator.
+ */
+static LightSchedulerSimulator_t *SimulatorFor(I_DigitalOutputGroup_t *lights)
+{
+   return (LightSchedulerSimulator_t *)(void *)((char *)lights - offsetof(LightSchedulerSimulator_t, lights));
+}
+
+static void Record(LightSchedulerSimulator_t *instance, DigitalOutputChannel_t channel, bool state)
+{
+   uassert(channel < instance->channelCount);
+   if(state)
+   {
+      instance->states[channel / 32] |= (1UL << (channel % 32));
+   }
+   else
+   {
+      instance->states[channel / 32] &= ~(1UL << (channel % 32));
+   }
+   instance->events++;
+}
+
+static void Write(I_DigitalOutputGroup_t *lights, const DigitalOutputChannel_t channel, const bool state)
+{
+   Record(SimulatorFor(lights), channel, state);
+}
+
+static void WriteMany(I_DigitalOutputGroup_t *lights, const DigitalOutputWrite_t *writes, const uint16_t count)
+{
+   LightSchedulerSimulator_t *instance = SimulatorFor(lights);
+   uint16_t i;
+
+   for(i = 0; i < count; i++)
+   {
+      Record(instance, writes[i].channel, writes[i].state);
+   }
+}
+
+static const I_DigitalOutputGroup_Api_t lightsApi =
+   { Write, WriteMany };
+
+void LightSchedulerSimulator_Init(LightSchedulerSimulator_t *instance, uint32_t *states, uint32_t channelCount)
+{
+   uint32_t i;
+
+   uassert(instance);
+   uassert(states);
+   instance->timeSource.api = &timeSourceApi;
+   instance->lights.api = &lightsApi;
+   instance->now = 0;
+   instance->events = 0;
+   instance->states = states;
+   instance->channelCount = channelCount;
+
+   for(i = 0; i < LIGHTSCHEDULER_SIMULATOR_STATE_WORDS(channelCount); i++)
+   {
+      states[i] = 0;
+   }
+}
+
+I_TimeSource_t *LightSchedulerSimulator_GetTimeSource(LightSchedulerSimulator_t *instance)
+{
+   uassert(instance);
+   return &instance->timeSource;
+}
+
+I_DigitalOutputGroup_t *LightSchedulerSimulator_GetLights(LightSchedulerSimulator_t *instance)
+{
+   uassert(instance);
+   return &instance->lights;
+}
+
+uint64_t LightSchedulerSimulator_RunUntil(LightSchedulerSimulator_t *instance, LightScheduler_t *scheduler, TimeSourceWideTickCount_t end)
+{
+   TimeSourceWideTickCount_t next;
+   uint64_t runs = 0;
+
+   uassert(instance);
+   uassert(scheduler);
+   uassert(end >= instance->now);
+
+   while(LightScheduler_GetNextDueTime(scheduler, &next) && (next < end))
+   {
+      if(next > instance->now)
+      {
+         instance->now = next;
+      }
+      LightScheduler_Run(scheduler);
+      runs++;
+   }
+
+   instance->now = end;
+   LightScheduler_Run(scheduler);
+   return runs + 1;
+}
+
+TimeSourceWideTickCount_t LightSchedulerSimulator_GetTicks(LightSchedulerSimulator_t *instance)
+{
+   uassert(instance);
+   return instance->now;
+}
+
+uint64_t LightSchedulerSimulator_GetEventCount(LightSchedulerSimulator_t *instance)
+{
+   uassert(instance);
+   return instance->events;
+}
+
+bool LightSchedulerSimulator_GetState(LightSchedulerSimulator_t *instance, DigitalOutputChannel_t channel)
+{
+   uassert(instance);
+   uassert(channel < instance->channelCount);
+   return (instance->states[channel / 32] & (1UL << (channel % 32))) != 0;
+}
+
+uint64_t LightSchedulerSimulator_GetDigest(LightSchedulerSimulator_t *instance)
+{
+   uint64_t hash = 14695981039346656037ULL;
+   uint32_t i;
+   uint32_t byte;
+
+   uassert(instance);
+   for(i = 0; i < LIGHTSCHEDULER_SIMULATOR_STATE_WORDS(instance->channelCount); i++)
+   {
+      for(byte = 0; byte < 4; byte++)
+      {
+         hash = (hash ^ ((instance->states[i] >> (8 * byte)) & 0xFF)) * 1099511628211ULL;
+      }
+   }
+   return hash;
+}
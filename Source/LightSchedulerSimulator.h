@@ -0,0 +1,96 @@
+/*!
+ * @file
+ * @brief Runs a light scheduler against a virtual clock that jumps straight from one due tick to the
+ * next, recording what is written to the lights, so that long stretches of schedules can be simulated in
+ * a fraction of the time they cover.  The simulation is deterministic: the same schedules always produce
+ * the same writes and the same digest.
+ */
+
+#ifndef LIGHTSCHEDULERSIMULATOR_H
+#define LIGHTSCHEDULERSIMULATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LightScheduler.h"
+
+/*!
+ * Number of words of storage needed to record the states of channelCount channels.
+ */
+#define LIGHTSCHEDULER_SIMULATOR_STATE_WORDS(channelCount) (((channelCount) + 31) / 32)
+
+typedef struct
+{
+   I_TimeSource_t timeSource;
+   I_DigitalOutputGroup_t lights;
+   TimeSourceWideTickCount_t now;
+   uint64_t events;
+   uint32_t *states;
+   uint32_t channelCount;
+} LightSchedulerSimulator_t;
+
+/*!
+ * Initialize a simulator.  The clock starts at tick 0 and every channel starts off.
+ * @param instance The simulator.
+ * @param states Storage for the channel states.  Must hold
+ *    LIGHTSCHEDULER_SIMULATOR_STATE_WORDS(channelCount) words and stay valid for as long as the
+ *    simulator is used.
+ * @param channelCount The number of channels.  Writes to other channels fail an assertion.
+ */
+void LightSchedulerSimulator_Init(LightSchedulerSimulator_t *instance, uint32_t *states, uint32_t channelCount);
+
+/*!
+ * Get the virtual clock, to be given to the simulated light scheduler.
+ * @param instance The simulator.
+ * @return The time source.  It provides wide ticks.
+ */
+I_TimeSource_t *LightSchedulerSimulator_GetTimeSource(LightSchedulerSimulator_t *instance);
+
+/*!
+ * Get the recording lights, to be given to the simulated light scheduler.
+ * @param instance The simulator.
+ * @return The digital output group.  It can write several channels at once.
+ */
+I_DigitalOutputGroup_t *LightSchedulerSimulator_GetLights(LightSchedulerSimulator_t *instance);
+
+/*!
+ * Run a light scheduler at every tick before end that has something due, then at end.  Ticks with
+ * nothing due are skipped, so the cost depends on the number of due ticks rather than on the time
+ * simulated.
+ * @param instance The simulator.
+ * @param scheduler The light scheduler, using the simulator's time source and lights.
+ * @param end The last tick to simulate.  Must not be before the current tick.
+ * @return The number of runs.
+ */
+uint64_t LightSchedulerSimulator_RunUntil(LightSchedulerSimulator_t *instance, LightScheduler_t *scheduler, TimeSourceWideTickCount_t end);
+
+/*!
+ * Get the current tick of the virtual clock.
+ * @param instance The simulator.
+ * @return The tick of the last run.
+ */
+TimeSourceWideTickCount_t LightSchedulerSimulator_GetTicks(LightSchedulerSimulator_t *instance);
+
+/*!
+ * Get the number of writes to the lights.
+ * @param instance The simulator.
+ * @return The number of channel writes, counting each channel of a multi-channel write.
+ */
+uint64_t LightSchedulerSimulator_GetEventCount(LightSchedulerSimulator_t *instance);
+
+/*!
+ * Get the state last written to a channel.
+ * @param instance The simulator.
+ * @param channel The channel.
+ * @return The state, false if the channel has not been written.
+ */
+bool LightSchedulerSimulator_GetState(LightSchedulerSimulator_t *instance, DigitalOutputChannel_t channel);
+
+/*!
+ * Get a 64-bit FNV-1a digest of the states of every channel, to compare the outcome of simulations.
+ * @param instance The simulator.
+ * @return The digest.
+ */
+uint64_t LightSchedulerSimulator_GetDigest(LightSchedulerSimulator_t *instance);
+
+#endif
@@ -0,0 +1,355 @@
+/*!
+ * @file
+ * @brief Light scheduler snapshot implementation.
+ */
+
+#include <string.h>
+#include "LightSchedulerSnapshot.h"
+#include "uassert.h"
+
+#define SNAPSHOT_MAGIC (0x4E53534CUL)
+#define HEADER_SIZE (64)
+#define STORE_OFFSET (HEADER_SIZE)
+#define STORE_SIZE (((LIGHTSCHEDULER_STORE_STATE_WORDS * 4) + 7) & ~7UL)
+#define STORAGE_OFFSET (STORE_OFFSET + STORE_SIZE)
+
+#define CHECK_OFFSET (44)
+
+#define FLAG_HAS_RUN (1UL << 0)
+#define FLAG_HAS_NEXT_DUE (1UL << 1)
+#define FLAG_CATCH_UP (1UL << 2)
+
+typedef char ChannelsMustBeSixteenBits[(sizeof(DigitalOutputChannel_t) == 2) ? 1 : -1];
+
+static void PutU16(uint8_t *destination, uint16_t value)
+{
+   destination[0] = (uint8_t)value;
+   destination[1] = (uint8_t)(value >> 8);
+}
+
+static void PutU32(uint8_t *destination, uint32_t value)
+{
+   PutU16(destination, (uint16_t)value);
+   PutU16(destination + 2, (uint16_t)(value >> 16));
+}
+
+static void PutU64(uint8_t *destination, uint64_t value)
+{
+   PutU32(destination, (uint32_t)value);
+   PutU32(destination + 4, (uint32_t)(value >> 32));
+}
+
+static uint16_t GetU16(const uint8_t *source)
+{
+   return (uint16_t)(source[0] | (source[1] << 8));
+}
+
+static uint32_t GetU32(const uint8_t *source)
+{
+   return GetU16(source) | ((uint32_t)GetU16(source + 2) << 16);
+}
+
+static uint64_t GetU64(const uint8_t *source)
+{
+   return GetU32(source) | ((uint64_t)GetU32(source + 4) << 32);
+}
+
+static bool HostIsLittleEndian(void)
+{
+   const uint16_t one = 1;
+   return *(const uint8_t *)&one == 1;
+}
+
+static size_t SnapshotSize(ScheduleIndex_t capacity)
+{
+   return STORAGE_OFFSET + (8 * (size_t)LIGHTSCHEDULER_STORAGE_WORDS(capacity));
+}
+
+static ScheduleIndex_t BitsetWords(ScheduleIndex_t capacity)
+{
+   return LIGHTSCHEDULER_SCHEDULE_BITSET_WORDS(capacity);
+}
+
+/*!
+ * FNV-1a over a snapshot, skipping the check field.  Catches a snapshot that was only partly written or
+ * was corrupted afterwards.
+ */
+static uint32_t SnapshotCheck(const uint8_t *image, size_t size)
+{
+   uint32_t hash = 2166136261UL;
+   size_t i;
+
+   for(i = 0; i < size; i++)
+   {
+      if((i < CHECK_OFFSET) || (i >= (CHECK_OFFSET + 4)))
+      {
+         hash = (hash ^ image[i]) * 16777619UL;
+      }
+   }
+   return hash;
+}
+
+/*!
+ * Returns the capacity of a snapshot that this build can restore, or 0.
+ */
+static ScheduleIndex_t ValidCapacity(const uint8_t *image, size_t size)
+{
+   ScheduleIndex_t capacity;
+
+   if((size < HEADER_SIZE) || (GetU32(image) != SNAPSHOT_MAGIC) || (GetU16(image + 4) != LightSchedulerSnapshot_Version) ||
+      (GetU16(image + 6) != HEADER_SIZE) || (GetU32(image + 8) != LIGHTSCHEDULER_STORE_STATE_WORDS) ||
+      (GetU32(image + 20) != LIGHTSCHEDULER_STORE))
+   {
+      return 0;
+   }
+
+   capacity = GetU32(image + 12);
+   if((capacity == 0) || (capacity == SCHEDULE_INDEX_NONE) || (GetU32(image + 16) > capacity) ||
+      (GetU64(image + 48) != LIGHTSCHEDULER_STORAGE_WORDS(capacity)) || (size < SnapshotSize(capacity)) ||
+      (GetU32(image + CHECK_OFFSET) != SnapshotCheck(image, SnapshotSize(capacity))))
+   {
+      return 0;
+   }
+   return capacity;
+}
+
+/*!
+ * The check only catches accidental damage, so the indices a scheduler follows are checked too before it
+ * uses them.  live must be a permutation of the slots whose first numSchedules entries are the active
+ * ones, and the store must only refer to slots in the table, in the order it keeps them in.
+ */
+static bool SchedulesAreValid(LightScheduler_t *instance)
+{
+   const ScheduleTable_t *schedules = &instance->schedules;
+   ScheduleIndex_t position;
+
+   for(position = 0; position < instance->capacity; position++)
+   {
+      ScheduleIndex_t index = schedules->live[position];
+
+      if((index >= instance->capacity) || (schedules->livePosition[index] != position) ||
+         (((schedules->active[index / 32] & (1UL << (index % 32))) != 0) != (position < instance->numSchedules)))
+      {
+         return false;
+      }
+   }
+   return LightSchedulerStore_IsValid(&instance->store.interface, instance->capacity);
+}
+
+static void SaveHeader(LightScheduler_t *instance, uint8_t *buffer)
+{
+   uint32_t flags = 0;
+
+   memset(buffer, 0, HEADER_SIZE);
+   flags |= instance->hasRun ? FLAG_HAS_RUN : 0;
+   flags |= instance->hasNextDue ? FLAG_HAS_NEXT_DUE : 0;
+   flags |= instance->catchUp ? FLAG_CATCH_UP : 0;
+
+   PutU32(buffer, SNAPSHOT_MAGIC);
+   PutU16(buffer + 4, LightSchedulerSnapshot_Version);
+   PutU16(buffer + 6, HEADER_SIZE);
+   PutU32(buffer + 8, LIGHTSCHEDULER_STORE_STATE_WORDS);
+   PutU32(buffer + 12, instance->capacity);
+   PutU32(buffer + 16, instance->numSchedules);
+   PutU32(buffer + 20, LIGHTSCHEDULER_STORE);
+   PutU64(buffer + 24, instance->lastTick);
+   PutU64(buffer + 32, instance->nextDue);
+   PutU32(buffer + 40, flags);
+   PutU64(buffer + 48, LIGHTSCHEDULER_STORAGE_WORDS(instance->capacity));
+}
+
+static void RestoreHeader(LightScheduler_t *instance, const uint8_t *image)
+{
+   uint32_t flags = GetU32(image + 40);
+
+   instance->numSchedules = GetU32(image + 16);
+   instance->lastTick = GetU64(image + 24);
+   instance->nextDue = GetU64(image + 32);
+   instance->hasRun = (flags & FLAG_HAS_RUN) != 0;
+   instance->hasNextDue = (flags & FLAG_HAS_NEXT_DUE) != 0;
+   instance->catchUp = (flags & FLAG_CATCH_UP) != 0;
+}
+
+static void SaveStore(LightScheduler_t *instance, uint8_t *buffer)
+{
+   uint8_t *state = buffer + STORE_OFFSET;
+   uint32_t i;
+
+   memset(state, 0, STORE_SIZE);
+   for(i = 0; i < LIGHTSCHEDULER_STORE_STATE_WORDS; i++)
+   {
+      PutU32(state + (4 * i), LightSchedulerStore_GetStateWord(&instance->store.interface, i));
+   }
+}
+
+static void RestoreStore(LightScheduler_t *instance, const uint8_t *image)
+{
+   const uint8_t *state = image + STORE_OFFSET;
+   uint32_t i;
+
+   for(i = 0; i < LIGHTSCHEDULER_STORE_STATE_WORDS; i++)
+   {
+      LightSchedulerStore_SetStateWord(&instance->store.interface, i, GetU32(state + (4 * i)));
+   }
+}
+
+/*!
+ * Writes the storage columns in the order and widths that LightScheduler lays them out in memory.
+ */
+static void SaveStorage(LightScheduler_t *instance, uint8_t *buffer)
+{
+   const ScheduleTable_t *schedules = &instance->schedules;
+   ScheduleIndex_t capacity = instance->capacity;
+   uint8_t *column = buffer + STORAGE_OFFSET;
+   ScheduleIndex_t i;
+
+   memset(column, 0, 8 * (size_t)LIGHTSCHEDULER_STORAGE_WORDS(capacity));
+   for(i = 0; i < capacity; i++)
+   {
+      PutU64(column + (8 * (size_t)i), schedules->time[i]);
+      PutU64(column + (8 * ((size_t)capacity + i)), schedules->period[i]);
+   }
+
+   column += 16 * (size_t)capacity;
+   for(i = 0; i < BitsetWords(capacity); i++)
+   {
+      PutU32(column + (4 * (size_t)i), schedules->active[i]);
+      PutU32(column + (4 * ((size_t)BitsetWords(capacity) + i)), schedules->lightState[i]);
+   }
+
+   column += 8 * (size_t)BitsetWords(capacity);
+   for(i = 0; i < capacity; i++)
+   {
+      PutU32(column + (4 * (size_t)i), schedules->generation[i]);
+      PutU32(column + (4 * ((size_t)capacity + i)), schedules->live[i]);
+      PutU32(column + (4 * ((2 * (size_t)capacity) + i)), schedules->livePosition[i]);
+   }
+
+   column += 12 * (size_t)capacity;
+   for(i = 0; i < (LIGHTSCHEDULER_STORE_COLUMNS * (size_t)capacity); i++)
+   {
+      PutU32(column + (4 * (size_t)i), schedules->store[i]);
+   }
+
+   column += 4 * LIGHTSCHEDULER_STORE_COLUMNS * (size_t)capacity;
+   for(i = 0; i < capacity; i++)
+   {
+      PutU16(column + (2 * (size_t)i), schedules->lightId[i]);
+   }
+}
+
+static void RestoreStorage(LightScheduler_t *instance, const uint8_t *image)
+{
+   ScheduleTable_t *schedules = &instance->schedules;
+   ScheduleIndex_t capacity = instance->capacity;
+   const uint8_t *column = image + STORAGE_OFFSET;
+   ScheduleIndex_t i;
+
+   for(i = 0; i < capacity; i++)
+   {
+      schedules->time[i] = GetU64(column + (8 * (size_t)i));
+      schedules->period[i] = GetU64(column + (8 * ((size_t)capacity + i)));
+   }
+
+   column += 16 * (size_t)capacity;
+   for(i = 0; i < BitsetWords(capacity); i++)
+   {
+      schedules->active[i] = GetU32(column + (4 * (size_t)i));
+      schedules->lightState[i] = GetU32(column + (4 * ((size_t)BitsetWords(capacity) + i)));
+   }
+
+   column += 8 * (size_t)BitsetWords(capacity);
+   for(i = 0; i < capacity; i++)
+   {
+      schedules->generation[i] = GetU32(column + (4 * (size_t)i));
+      schedules->live[i] = GetU32(column + (4 * ((size_t)capacity + i)));
+      schedules->livePosition[i] = GetU32(column + (4 * ((2 * (size_t)capacity) + i)));
+   }
+
+   column += 12 * (size_t)capacity;
+   for(i = 0; i < (LIGHTSCHEDULER_STORE_COLUMNS * (size_t)capacity); i++)
+   {
+      schedules->store[i] = GetU32(column + (4 * (size_t)i));
+   }
+
+   column += 4 * LIGHTSCHEDULER_STORE_COLUMNS * (size_t)capacity;
+   for(i = 0; i < capacity; i++)
+   {
+      schedules->lightId[i] = GetU16(column + (2 * (size_t)i));
+   }
+}
+
+size_t LightSchedulerSnapshot_Size(LightScheduler_t *instance)
+{
+   uassert(instance);
+   return SnapshotSize(instance->capacity);
+}
+
+size_t LightSchedulerSnapshot_Save(LightScheduler_t *instance, uint8_t *buffer, size_t size)
+{
+   uassert(instance);
+   uassert(buffer);
+
+   if(size < SnapshotSize(instance->capacity))
+   {
+      return 0;
+   }
+
+   SaveHeader(instance, buffer);
+   SaveStore(instance, buffer);
+   SaveStorage(instance, buffer);
+   PutU32(buffer + CHECK_OFFSET, SnapshotCheck(buffer, SnapshotSize(instance->capacity)));
+   return SnapshotSize(instance->capacity);
+}
+
+ScheduleIndex_t LightSchedulerSnapshot_Capacity(const uint8_t *image, size_t size)
+{
+   uassert(image);
+   return ValidCapacity(image, size);
+}
+
+bool LightSchedulerSnapshot_Restore(
+   LightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   const uint8_t *image,
+   size_t size,
+   uint64_t *storage,
+   ScheduleIndex_t capacity)
+{
+   uassert(image);
+
+   if((capacity == 0) || (ValidCapacity(image, size) != capacity))
+   {
+      return false;
+   }
+
+   LightScheduler_InitAroundStorage(instance, lights, timeSource, storage, capacity);
+   RestoreStorage(instance, image);
+   RestoreStore(instance, image);
+   RestoreHeader(instance, image);
+   return SchedulesAreValid(instance);
+}
+
+bool LightSchedulerSnapshot_Map(
+   LightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   uint8_t *image,
+   size_t size)
+{
+   ScheduleIndex_t capacity;
+
+   uassert(image);
+
+   capacity = ValidCapacity(image, size);
+   if((capacity == 0) || !HostIsLittleEndian() || (((uintptr_t)image % 8) != 0))
+   {
+      return false;
+   }
+
+   LightScheduler_InitAroundStorage(instance, lights, timeSource, (uint64_t *)(void *)(image + STORAGE_OFFSET), capacity);
+   RestoreStore(instance, image);
+   RestoreHeader(instance, image);
+   return SchedulesAreValid(instance);
+}
@@ -0,0 +1,99 @@
+/*!
+ * @file
+ * @brief Saves the schedules of a light scheduler to a versioned binary snapshot and restores them.
+ *
+ * A snapshot is a 64-byte header followed by the fixed state of the schedule store and the schedule
+ * storage, all as fixed-width little-endian fields.  The storage section has the same layout as the
+ * scheduler's own storage, so on a little-endian machine a snapshot can be run in place without decoding
+ * it.  A checksum in the header covers the whole snapshot, and the schedule indices and the order of
+ * the schedule store are checked on restore, so a snapshot that was torn or corrupted is rejected.  A
+ * snapshot can only be restored by a build with the same LIGHTSCHEDULER_STORE and, for the timing wheel,
+ * the same LIGHTSCHEDULER_WHEEL_SLOTS.
+ *
+ * The snapshot holds the schedules, the last processed tick and the catch-up setting.  Queued
+ * commands, constant tables and write suppression are not saved and must be set up again.  A run left
+ * unfinished by LightScheduler_RunWithBudget is saved up to the tick it stopped at, and the rest of it
+ * is treated as a new run after restoring.
+ */
+
+#ifndef LIGHTSCHEDULERSNAPSHOT_H
+#define LIGHTSCHEDULERSNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "LightScheduler.h"
+
+enum
+{
+   LightSchedulerSnapshot_Version = 4
+};
+
+/*!
+ * Get the size of the snapshot of a light scheduler.
+ * @param instance The light scheduler.
+ * @return The number of bytes LightSchedulerSnapshot_Save will write.
+ */
+size_t LightSchedulerSnapshot_Size(LightScheduler_t *instance);
+
+/*!
+ * Save the schedules of a light scheduler.
+ * @param instance The light scheduler.
+ * @param buffer Where to write the snapshot.
+ * @param size The size of buffer.
+ * @return The number of bytes written, or 0 if buffer is too small.
+ */
+size_t LightSchedulerSnapshot_Save(LightScheduler_t *instance, uint8_t *buffer, size_t size);
+
+/*!
+ * Get the schedule capacity of a snapshot, to size the storage passed to LightSchedulerSnapshot_Restore.
+ * @param image The snapshot.
+ * @param size The size of the snapshot.
+ * @return The capacity, or 0 if the snapshot is not valid for this build.
+ */
+ScheduleIndex_t LightSchedulerSnapshot_Capacity(const uint8_t *image, size_t size);
+
+/*!
+ * Initialize a light scheduler with the schedules decoded from a snapshot.
+ * @param instance The light scheduler.
+ * @param lights A digital output group that can be used to control the lights.
+ * @param timeSource This is how the light scheduler will get the current time.
+ * @param image The snapshot.
+ * @param size The size of the snapshot.
+ * @param storage Storage for the schedules.  Must hold LIGHTSCHEDULER_STORAGE_WORDS(capacity) words and
+ *    stay valid for as long as the scheduler is used.
+ * @param capacity Number of schedules that fit in storage.  Must be the capacity of the snapshot.
+ * @return False if the snapshot is not valid for this build, does not have this capacity or holds
+ *    schedules that are not consistent.  The light scheduler must then not be used.
+ */
+bool LightSchedulerSnapshot_Restore(
+   LightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   const uint8_t *image,
+   size_t size,
+   uint64_t *storage,
+   ScheduleIndex_t capacity);
+
+/*!
+ * Initialize a light scheduler that runs directly on the schedules in a snapshot, without copying them.
+ * Only the fixed state of the schedule store is copied out of the snapshot.  The whole snapshot is read
+ * once to check it.  Only possible on a little-endian machine.
+ * @param instance The light scheduler.
+ * @param lights A digital output group that can be used to control the lights.
+ * @param timeSource This is how the light scheduler will get the current time.
+ * @param image The snapshot.  Must be 8-byte aligned, writable, and stay valid for as long as the
+ *    scheduler is used.  The scheduler changes it as it runs.
+ * @param size The size of the snapshot.
+ * @return False if the snapshot is not valid for this build, holds schedules that are not consistent or
+ *    cannot be run in place.  The light scheduler must then not be used.
+ */
+bool LightSchedulerSnapshot_Map(
+   LightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   uint8_t *image,
+   size_t size);
+
+#endif
@@ -0,0 +1,162 @@
+/*!
+ * @file
+ * @brief Light scheduler snapshot file implementation.
+ */
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "LightSchedulerSnapshotFile.h"
+#include "uassert.h"
+
+/*!
+ * Writes a snapshot to a new file and flushes it to storage.
+ */
+static bool WriteFile(LightScheduler_t *instance, const char *path)
+{
+   size_t size = LightSchedulerSnapshot_Size(instance);
+   void *image;
+   int fd;
+   bool written;
+
+   fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if(fd < 0)
+   {
+      return false;
+   }
+
+   if(ftruncate(fd, (off_t)size) != 0)
+   {
+      close(fd);
+      return false;
+   }
+
+   image = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if(image == MAP_FAILED)
+   {
+      close(fd);
+      return false;
+   }
+
+   written = (LightSchedulerSnapshot_Save(instance, image, size) == size) && (msync(image, size, MS_SYNC) == 0);
+   munmap(image, size);
+   written = written && (fsync(fd) == 0);
+   return (close(fd) == 0) && written;
+}
+
+/*!
+ * Flushes the directory holding path, so that a file renamed into it stays renamed after a power loss.
+ * Best effort: the rename has already replaced the file, so there is nothing to undo if this fails.
+ */
+static void SyncDirectory(const char *path)
+{
+   char directory[PATH_MAX];
+   char *slash;
+   int fd;
+
+   strcpy(directory, path);
+   slash = strrchr(directory, '/');
+   if(slash == NULL)
+   {
+      strcpy(directory, ".");
+   }
+   else
+   {
+      slash[(slash == directory) ? 1 : 0] = '\0';
+   }
+
+   fd = open(directory, O_RDONLY);
+   if(fd >= 0)
+   {
+      fsync(fd);
+      close(fd);
+   }
+}
+
+/*!
+ * The snapshot is written to a temporary file next to the old one and renamed over it only once it is
+ * on storage, so that losing power part way through leaves either the old snapshot or the new one.  The
+ * save succeeds at the rename.
+ */
+bool LightSchedulerSnapshotFile_Save(LightScheduler_t *instance, const char *path)
+{
+   char temporaryPath[PATH_MAX];
+   int length;
+
+   uassert(instance);
+   uassert(path);
+
+   length = snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", path);
+   if((length < 0) || ((size_t)length >= sizeof(temporaryPath)))
+   {
+      return false;
+   }
+
+   if(!WriteFile(instance, temporaryPath) || (rename(temporaryPath, path) != 0))
+   {
+      unlink(temporaryPath);
+      return false;
+   }
+   SyncDirectory(path);
+   return true;
+}
+
+bool LightSchedulerSnapshotFile_Load(
+   LightSchedulerSnapshotFile_t *file,
+   LightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   const char *path)
+{
+   struct stat status;
+   int fd;
+
+   uassert(file);
+   uassert(path);
+   file->image = NULL;
+   file->size = 0;
+
+   fd = open(path, O_RDONLY);
+   if(fd < 0)
+   {
+      return false;
+   }
+
+   if((fstat(fd, &status) != 0) || (status.st_size <= 0))
+   {
+      close(fd);
+      return false;
+   }
+
+   file->size = (size_t)status.st_size;
+   file->image = mmap(NULL, file->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if(file->image == MAP_FAILED)
+   {
+      file->image = NULL;
+      return false;
+   }
+
+   if(!LightSchedulerSnapshot_Map(instance, lights, timeSource, file->image, file->size))
+   {
+      LightSchedulerSnapshotFile_Close(file);
+      return false;
+   }
+   return true;
+}
+
+void LightSchedulerSnapshotFile_Close(LightSchedulerSnapshotFile_t *file)
+{
+   uassert(file);
+
+   if(file->image != NULL)
+   {
+      munmap(file->image, file->size);
+      file->image = NULL;
+      file->size = 0;
+   }
+}
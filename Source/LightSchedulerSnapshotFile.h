@@ -0,0 +1,58 @@
+/*!
+ * @file
+ * @brief Saves light scheduler snapshots to files and runs them directly from a private memory mapping
+ * of the file, so that a restart does not have to read or decode the schedules.
+ *
+ * Requires POSIX mmap.
+ */
+
+#ifndef LIGHTSCHEDULERSNAPSHOTFILE_H
+#define LIGHTSCHEDULERSNAPSHOTFILE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "LightSchedulerSnapshot.h"
+
+typedef struct
+{
+   void *image;
+   size_t size;
+} LightSchedulerSnapshotFile_t;
+
+/*!
+ * Save a snapshot of a light scheduler to a file, replacing the file if it exists.  The snapshot is
+ * written and flushed to path with ".tmp" appended and then renamed to path, so the file is replaced all
+ * at once.  The directory is then flushed so that the rename survives a power loss, where the file
+ * system allows it; a power loss right after a save may otherwise still leave the previous snapshot.
+ * @param instance The light scheduler.
+ * @param path The path of the file.
+ * @return True once the file has been replaced.  False if the snapshot could not be written or renamed,
+ *    in which case an existing file is left as it was.
+ */
+bool LightSchedulerSnapshotFile_Save(LightScheduler_t *instance, const char *path);
+
+/*!
+ * Map a snapshot file and initialize a light scheduler that runs directly on it.  The mapping is
+ * private, so changes made by the scheduler as it runs are not written back to the file.
+ * @param file Keeps track of the mapping.
+ * @param instance The light scheduler.
+ * @param lights A digital output group that can be used to control the lights.
+ * @param timeSource This is how the light scheduler will get the current time.
+ * @param path The path of the file.
+ * @return False if the file could not be mapped or is not a snapshot that can be run in place.
+ */
+bool LightSchedulerSnapshotFile_Load(
+   LightSchedulerSnapshotFile_t *file,
+   LightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   const char *path);
+
+/*!
+ * Unmap a snapshot file.  The light scheduler loaded from it must not be used afterwards.
+ * @param file The mapping.
+ */
+void LightSchedulerSnapshotFile_Close(LightSchedulerSnapshotFile_t *file);
+
+#endif
@@ -0,0 +1,90 @@
+/*!
+ * @file
+ * @brief Selects the schedule store used by the light scheduler at compile time.  The scheduler calls
+ * the selected store's functions directly rather than through its I_ScheduleStore_t interface, so the
+ * choice costs no indirection.
+ */
+
+#ifndef LIGHTSCHEDULERSTORE_H
+#define LIGHTSCHEDULERSTORE_H
+
+#include "LinearScheduleStore.h"
+#include "SortedScheduleStore.h"
+#include "HeapScheduleStore.h"
+#include "WheelScheduleStore.h"
+
+#define LIGHTSCHEDULER_STORE_LINEAR (1)
+#define LIGHTSCHEDULER_STORE_SORTED (2)
+#define LIGHTSCHEDULER_STORE_HEAP (3)
+#define LIGHTSCHEDULER_STORE_WHEEL (4)
+
+/*!
+ * Schedule store used by the light scheduler, one of the LIGHTSCHEDULER_STORE_* values.  The linear
+ * store is the smallest, the sorted and heap stores suit tables of up to a few thousand schedules, and
+ * the timing wheel keeps adds, removes and runs constant time for large tables.
+ */
+#ifndef LIGHTSCHEDULER_STORE
+#define LIGHTSCHEDULER_STORE LIGHTSCHEDULER_STORE_WHEEL
+#endif
+
+#if LIGHTSCHEDULER_STORE == LIGHTSCHEDULER_STORE_LINEAR
+typedef LinearScheduleStore_t LightSchedulerStore_t;
+#define LIGHTSCHEDULER_STORE_COLUMNS LINEARSCHEDULESTORE_COLUMNS
+#define LIGHTSCHEDULER_STORE_STATE_WORDS LINEARSCHEDULESTORE_STATE_WORDS
+#define LightSchedulerStore_Init LinearScheduleStore_Init
+#define LightSchedulerStore_Clear LinearScheduleStore_Clear
+#define LightSchedulerStore_Insert LinearScheduleStore_Insert
+#define LightSchedulerStore_Remove LinearScheduleStore_Remove
+#define LightSchedulerStore_DueAt LinearScheduleStore_DueAt
+#define LightSchedulerStore_NextDueTime LinearScheduleStore_NextDueTime
+#define LightSchedulerStore_Find LinearScheduleStore_Find
+#define LightSchedulerStore_GetStateWord LinearScheduleStore_GetStateWord
+#define LightSchedulerStore_SetStateWord LinearScheduleStore_SetStateWord
+#define LightSchedulerStore_IsValid LinearScheduleStore_IsValid
+#elif LIGHTSCHEDULER_STORE == LIGHTSCHEDULER_STORE_SORTED
+typedef SortedScheduleStore_t LightSchedulerStore_t;
+#define LIGHTSCHEDULER_STORE_COLUMNS SORTEDSCHEDULESTORE_COLUMNS
+#define LIGHTSCHEDULER_STORE_STATE_WORDS SORTEDSCHEDULESTORE_STATE_WORDS
+#define LightSchedulerStore_Init SortedScheduleStore_Init
+#define LightSchedulerStore_Clear SortedScheduleStore_Clear
+#define LightSchedulerStore_Insert SortedScheduleStore_Insert
+#define LightSchedulerStore_Remove SortedScheduleStore_Remove
+#define LightSchedulerStore_DueAt SortedScheduleStore_DueAt
+#define LightSchedulerStore_NextDueTime SortedScheduleStore_NextDueTime
+#define LightSchedulerStore_Find SortedScheduleStore_Find
+#define LightSchedulerStore_GetStateWord SortedScheduleStore_GetStateWord
+#define LightSchedulerStore_SetStateWord SortedScheduleStore_SetStateWord
+#define LightSchedulerStore_IsValid SortedScheduleStore_IsValid
+#elif LIGHTSCHEDULER_STORE == LIGHTSCHEDULER_STORE_HEAP
+typedef HeapScheduleStore_t LightSchedulerStore_t;
+#define LIGHTSCHEDULER_STORE_COLUMNS HEAPSCHEDULESTORE_COLUMNS
+#define LIGHTSCHEDULER_STORE_STATE_WORDS HEAPSCHEDULESTORE_STATE_WORDS
+#define LightSchedulerStore_Init HeapScheduleStore_Init
+#define LightSchedulerStore_Clear HeapScheduleStore_Clear
+#define LightSchedulerStore_Insert HeapScheduleStore_Insert
+#define LightSchedulerStore_Remove HeapScheduleStore_Remove
+#define LightSchedulerStore_DueAt HeapScheduleStore_DueAt
+#define LightSchedulerStore_NextDueTime HeapScheduleStore_NextDueTime
+#define LightSchedulerStore_Find HeapScheduleStore_Find
+#define LightSchedulerStore_GetStateWord HeapScheduleStore_GetStateWord
+#define LightSchedulerStore_SetStateWord HeapScheduleStore_SetStateWord
+#define LightSchedulerStore_IsValid HeapScheduleStore_IsValid
+#elif LIGHTSCHEDULER_STORE == LIGHTSCHEDULER_STORE_WHEEL
+typedef WheelScheduleStore_t LightSchedulerStore_t;
+#define LIGHTSCHEDULER_STORE_COLUMNS WHEELSCHEDULESTORE_COLUMNS
+#define LIGHTSCHEDULER_STORE_STATE_WORDS WHEELSCHEDULESTORE_STATE_WORDS
+#define LightSchedulerStore_Init WheelScheduleStore_Init
+#define LightSchedulerStore_Clear WheelScheduleStore_Clear
+#define LightSchedulerStore_Insert WheelScheduleStore_Insert
+#define LightSchedulerStore_Remove WheelScheduleStore_Remove
+#define LightSchedulerStore_DueAt WheelScheduleStore_DueAt
+#define LightSchedulerStore_NextDueTime WheelScheduleStore_NextDueTime
+#define LightSchedulerStore_Find WheelScheduleStore_Find
+#define LightSchedulerStore_GetStateWord WheelScheduleStore_GetStateWord
+#define LightSchedulerStore_SetStateWord WheelScheduleStore_SetStateWord
+#define LightSchedulerStore_IsValid WheelScheduleStore_IsValid
+#else
+#error "LIGHTSCHEDULER_STORE must be one of the LIGHTSCHEDULER_STORE_* values"
+#endif
+
+#endif
@@ -0,0 +1,261 @@
+/*!
+ * @file
+ * @brief Linear schedule store implementation.
+ */
+
+#include "LinearScheduleStore.h"
+#include "uassert.h"
+
+static const I_ScheduleStore_Api_t api =
+   {
+      LinearScheduleStore_Clear,
+      LinearScheduleStore_Insert,
+      LinearScheduleStore_Remove,
+      LinearScheduleStore_DueAt,
+      LinearScheduleStore_NextDueTime,
+      LinearScheduleStore_Find,
+      LinearScheduleStore_GetStateWord,
+      LinearScheduleStore_SetStateWord,
+      LinearScheduleStore_IsValid
+   };
+
+/*!
+ * True if stored schedule a was inserted before stored schedule b.  Sequence numbers are compared as a
+ * signed difference so that they can roll over.
+ */
+static bool InsertedBefore(LinearScheduleStore_t *instance, ScheduleIndex_t a, ScheduleIndex_t b)
+{
+   return (int32_t)(instance->sequence[a] - instance->sequence[b]) < 0;
+}
+
+void LinearScheduleStore_Init(LinearScheduleStore_t *instance, const ScheduleTable_t *schedules, ScheduleIndex_t capacity)
+{
+   uassert(instance);
+   uassert(schedules);
+   (void)capacity;
+   instance->interface.api = &api;
+   instance->schedules = schedules;
+   instance->sequence = schedules->store;
+   LinearScheduleStore_Clear(&instance->interface);
+}
+
+/*!
+ * Leaves the sequence column alone: slots at or past the limit are marked as not stored when an insert
+ * raises the limit past them.
+ */
+void LinearScheduleStore_Clear(I_ScheduleStore_t *_instance)
+{
+   LinearScheduleStore_t *instance = (LinearScheduleStore_t *)_instance;
+   instance->count = 0;
+   instance->limit = 0;
+   instance->nextSequence = 0;
+}
+
+void LinearScheduleStore_Insert(I_ScheduleStore_t *_instance, ScheduleIndex_t index)
+{
+   LinearScheduleStore_t *instance = (LinearScheduleStore_t *)_instance;
+
+   for(; instance->limit <= index; instance->limit++)
+   {
+      instance->sequence[instance->limit] = LINEARSCHEDULESTORE_NOT_STORED;
+   }
+   uassert(instance->sequence[index] == LINEARSCHEDULESTORE_NOT_STORED);
+
+   instance->sequence[index] = instance->nextSequence;
+   instance->nextSequence++;
+   if(instance->nextSequence == LINEARSCHEDULESTORE_NOT_STORED)
+   {
+      instance->nextSequence = 0;
+   }
+   instance->count++;
+}
+
+/*!
+ * Lowers the limit past the slots at the top that are no longer stored, so that the scans only cover
+ * up to the highest schedule still stored.  Each slot is passed over at most once per insert that
+ * raised the limit past it.
+ */
+void LinearScheduleStore_Remove(I_ScheduleStore_t *_instance, ScheduleIndex_t index)
+{
+   LinearScheduleStore_t *instance = (LinearScheduleStore_t *)_instance;
+   uassert(index < instance->limit);
+   uassert(instance->sequence[index] != LINEARSCHEDULESTORE_NOT_STORED);
+
+   instance->sequence[index] = LINEARSCHEDULESTORE_NOT_STORED;
+   instance->count--;
+
+   while((instance->limit > 0) && (instance->sequence[instance->limit - 1] == LINEARSCHEDULESTORE_NOT_STORED))
+   {
+      instance->limit--;
+   }
+}
+
+/*!
+ * Bitmask of the schedules from base due at tick, whether they are stored or not.  Whole blocks of 32
+ * compare a fixed number of times without branching, so that the compiler vectorizes them.
+ */
+static uint32_t DueMask(LinearScheduleStore_t *instance, ScheduleIndex_t base, TimeSourceWideTickCount_t tick)
+{
+   const TimeSourceWideTickCount_t *times = &instance->schedules->time[base];
+   ScheduleIndex_t remaining = instance->limit - base;
+   uint32_t matches = 0;
+   ScheduleIndex_t bit;
+
+   if(remaining >= 32)
+   {
+      for(bit = 0; bit < 32; bit++)
+      {
+         matches |= (uint32_t)(times[bit] == tick) << bit;
+      }
+   }
+   else
+   {
+      for(bit = 0; bit < remaining; bit++)
+      {
+         matches |= (uint32_t)(times[bit] == tick) << bit;
+      }
+   }
+   return matches;
+}
+
+/*!
+ * Scans the packed time column a block at a time, and only looks at the sequence numbers of the few
+ * schedules that match.
+ */
+ScheduleIndex_t LinearScheduleStore_DueAt(I_ScheduleStore_t *_instance, TimeSourceWideTickCount_t tick)
+{
+   LinearScheduleStore_t *instance = (LinearScheduleStore_t *)_instance;
+   ScheduleIndex_t found = SCHEDULE_INDEX_NONE;
+   ScheduleIndex_t base;
+
+   for(base = 0; base < instance->limit; base += 32)
+   {
+      uint32_t matches = DueMask(instance, base, tick);
+      ScheduleIndex_t i;
+
+      for(i = base; matches != 0; i++, matches >>= 1)
+      {
+         if(((matches & 1) != 0) &&
+            (instance->sequence[i] != LINEARSCHEDULESTORE_NOT_STORED) &&
+            ((found == SCHEDULE_INDEX_NONE) || InsertedBefore(instance, i, found)))
+         {
+            found = i;
+         }
+      }
+   }
+   return found;
+}
+
+/*!
+ * Schedules that are not stored are pushed to UINT64_MAX with a mask rather than a branch, so that the
+ * compiler can vectorize the pass.
+ */
+bool LinearScheduleStore_NextDueTime(I_ScheduleStore_t *_instance, TimeSourceWideTickCount_t from, TimeSourceWideTickCount_t *tick)
+{
+   LinearScheduleStore_t *instance = (LinearScheduleStore_t *)_instance;
+   const TimeSourceWideTickCount_t *times = instance->schedules->time;
+   const ScheduleIndex_t *sequence = instance->sequence;
+   ScheduleIndex_t limit = instance->limit;
+   TimeSourceWideTickCount_t earliest = UINT64_MAX;
+   ScheduleIndex_t i;
+   (void)from;
+
+   if(instance->count == 0)
+   {
+      return false;
+   }
+
+   for(i = 0; i < limit; i++)
+   {
+      TimeSourceWideTickCount_t notStored = (sequence[i] == LINEARSCHEDULESTORE_NOT_STORED);
+      TimeSourceWideTickCount_t time = times[i] | (0 - notStored);
+
+      earliest = (time < earliest) ? time : earliest;
+   }
+   *tick = earliest;
+   return true;
+}
+
+ScheduleIndex_t LinearScheduleStore_Find(
+   I_ScheduleStore_t *_instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time,
+   TimeSourceWideTickCount_t timeMask)
+{
+   LinearScheduleStore_t *instance = (LinearScheduleStore_t *)_instance;
+   const ScheduleTable_t *schedules = instance->schedules;
+   ScheduleIndex_t found = SCHEDULE_INDEX_NONE;
+   ScheduleIndex_t i;
+
+   for(i = 0; i < instance->limit; i++)
+   {
+      if((instance->sequence[i] != LINEARSCHEDULESTORE_NOT_STORED) &&
+         ScheduleTable_Matches(schedules, i, lightId, lightState, time, timeMask) &&
+         ((found == SCHEDULE_INDEX_NONE) ||
+            (schedules->time[i] < schedules->time[found]) ||
+            ((schedules->time[i] == schedules->time[found]) && InsertedBefore(instance, i, found))))
+      {
+         found = i;
+      }
+   }
+   return found;
+}
+
+/*!
+ * Points to a word of fixed state: the count, then the limit, then the next sequence number.
+ */
+static ScheduleIndex_t *StateWord(LinearScheduleStore_t *instance, uint32_t word)
+{
+   uassert(word < LINEARSCHEDULESTORE_STATE_WORDS);
+   if(word == 0)
+   {
+      return &instance->count;
+   }
+   return (word == 1) ? &instance->limit : &instance->nextSequence;
+}
+
+uint32_t LinearScheduleStore_GetStateWord(I_ScheduleStore_t *_instance, uint32_t word)
+{
+   return *StateWord((LinearScheduleStore_t *)_instance, word);
+}
+
+void LinearScheduleStore_SetStateWord(I_ScheduleStore_t *_instance, uint32_t word, uint32_t value)
+{
+   *StateWord((LinearScheduleStore_t *)_instance, word) = value;
+}
+
+/*!
+ * Every schedule below the limit must be marked as not stored or with a sequence number handed out
+ * before the next one, the schedule just below the limit must be stored, and the count must match the
+ * schedules marked as stored.
+ */
+bool LinearScheduleStore_IsValid(I_ScheduleStore_t *_instance, ScheduleIndex_t capacity)
+{
+   LinearScheduleStore_t *instance = (LinearScheduleStore_t *)_instance;
+   ScheduleIndex_t stored = 0;
+   ScheduleIndex_t i;
+
+   if((instance->limit > capacity) || (instance->nextSequence == LINEARSCHEDULESTORE_NOT_STORED))
+   {
+      return false;
+   }
+
+   if((instance->limit > 0) && (instance->sequence[instance->limit - 1] == LINEARSCHEDULESTORE_NOT_STORED))
+   {
+      return false;
+   }
+
+   for(i = 0; i < instance->limit; i++)
+   {
+      if(instance->sequence[i] != LINEARSCHEDULESTORE_NOT_STORED)
+      {
+         if((int32_t)(instance->sequence[i] - instance->nextSequence) >= 0)
+         {
+            return false;
+         }
+         stored++;
+      }
+   }
+   return stored == instance->count;
+}
@@ -0,0 +1,65 @@
+/*!
+ * @file
+ * @brief Schedule store that marks each stored schedule with the order it was inserted in.  Inserting
+ * and removing take constant time; finding the schedules due at a tick and the next due time take a
+ * pass over the packed time column of the table, up to the highest schedule stored, which the
+ * compiler can vectorize.  Uses the least RAM and code, so suits small tables.
+ */
+
+#ifndef LINEARSCHEDULESTORE_H
+#define LINEARSCHEDULESTORE_H
+
+#include "I_ScheduleStore.h"
+
+/*!
+ * Number of columns of the schedule table used by the store: the insertion sequence number of each
+ * schedule, or LINEARSCHEDULESTORE_NOT_STORED.
+ */
+#define LINEARSCHEDULESTORE_COLUMNS (1)
+
+/*!
+ * Number of words of fixed state: the number of schedules stored, one past the highest schedule
+ * stored, and the next sequence number.
+ */
+#define LINEARSCHEDULESTORE_STATE_WORDS (3)
+
+/*!
+ * Sequence number of a schedule that is not in the store.  Never handed out to a stored schedule.
+ */
+#define LINEARSCHEDULESTORE_NOT_STORED ((ScheduleIndex_t)UINT32_MAX)
+
+typedef struct
+{
+   I_ScheduleStore_t interface;
+   const ScheduleTable_t *schedules;
+   ScheduleIndex_t *sequence;
+   ScheduleIndex_t count;
+   ScheduleIndex_t limit;
+   ScheduleIndex_t nextSequence;
+} LinearScheduleStore_t;
+
+/*!
+ * Initialize an empty linear store.
+ * @param instance The store.
+ * @param schedules The schedule table.  Its store column must hold LINEARSCHEDULESTORE_COLUMNS * capacity
+ *    indices.
+ * @param capacity Number of schedules in the table.
+ */
+void LinearScheduleStore_Init(LinearScheduleStore_t *instance, const ScheduleTable_t *schedules, ScheduleIndex_t capacity);
+
+void LinearScheduleStore_Clear(I_ScheduleStore_t *instance);
+void LinearScheduleStore_Insert(I_ScheduleStore_t *instance, ScheduleIndex_t index);
+void LinearScheduleStore_Remove(I_ScheduleStore_t *instance, ScheduleIndex_t index);
+ScheduleIndex_t LinearScheduleStore_DueAt(I_ScheduleStore_t *instance, TimeSourceWideTickCount_t tick);
+bool LinearScheduleStore_NextDueTime(I_ScheduleStore_t *instance, TimeSourceWideTickCount_t from, TimeSourceWideTickCount_t *tick);
+ScheduleIndex_t LinearScheduleStore_Find(
+   I_ScheduleStore_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time,
+   TimeSourceWideTickCount_t timeMask);
+uint32_t LinearScheduleStore_GetStateWord(I_ScheduleStore_t *instance, uint32_t word);
+void LinearScheduleStore_SetStateWord(I_ScheduleStore_t *instance, uint32_t word, uint32_t value);
+bool LinearScheduleStore_IsValid(I_ScheduleStore_t *instance, ScheduleIndex_t capacity);
+
+#endif
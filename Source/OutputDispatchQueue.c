@@ -0,0 +1,172 @@
+/*!
+ * @file
+ * @brief Output dispatch queue implementation.
+ */
+
+#include "OutputDispatchQueue.h"
+#include "uassert.h"
+
+typedef char BatchMustFitInCount[((OUTPUTDISPATCHQUEUE_BATCH_SIZE > 0) && (OUTPUTDISPATCHQUEUE_BATCH_SIZE <= UINT16_MAX)) ? 1 : -1];
+
+/*!
+ * Each channel's byte says whether the channel is queued and, if so, the state to write to it.
+ */
+#define CHANNEL_QUEUED (1U << 0)
+#define CHANNEL_STATE (1U << 1)
+
+/*!
+ * Sets the state of a channel and queues the channel if it is not already queued.  The channel byte is
+ * swapped in one atomic exchange, so if the consumer takes the channel at the same time either it sees
+ * the new state or the channel is queued again.  A channel stays marked as queued until the consumer
+ * has taken its entry out of the queue, so the queue holds each channel at most once and cannot fill.
+ */
+static void Enqueue(OutputDispatchQueue_t *instance, DigitalOutputChannel_t channel, bool state)
+{
+   uint8_t previous;
+   uint32_t head;
+   uint32_t depth;
+
+   uassert(channel < instance->channelCount);
+   previous = __atomic_exchange_n(&instance->channels[channel], (uint8_t)(CHANNEL_QUEUED | (state ? CHANNEL_STATE : 0)), __ATOMIC_ACQ_REL);
+   if(previous & CHANNEL_QUEUED)
+   {
+      instance->coalescedWrites++;
+      return;
+   }
+
+   head = instance->head;
+   instance->entries[head & instance->mask] = channel;
+   __atomic_store_n(&instance->head, head + 1, __ATOMIC_RELEASE);
+
+   depth = (head + 1) - __atomic_load_n(&instance->tail, __ATOMIC_ACQUIRE);
+   if(depth > instance->highWaterMark)
+   {
+      instance->highWaterMark = depth;
+   }
+}
+
+static void Write(I_DigitalOutputGroup_t *_instance, const DigitalOutputChannel_t channel, const bool state)
+{
+   Enqueue((OutputDispatchQueue_t *)_instance, channel, state);
+}
+
+static void WriteMany(I_DigitalOutputGroup_t *_instance, const DigitalOutputWrite_t *writes, const uint16_t count)
+{
+   uint16_t i;
+
+   for(i = 0; i < count; i++)
+   {
+      Enqueue((OutputDispatchQueue_t *)_instance, writes[i].channel, writes[i].state);
+   }
+}
+
+static const I_DigitalOutputGroup_Api_t api =
+   { Write, WriteMany };
+
+void OutputDispatchQueue_Init(
+   OutputDispatchQueue_t *instance,
+   I_DigitalOutputGroup_t *output,
+   DigitalOutputChannel_t *entries,
+   uint32_t size,
+   uint8_t *channels,
+   uint32_t channelCount)
+{
+   uint32_t i;
+
+   uassert(instance);
+   uassert(output);
+   uassert(entries);
+   uassert(channels);
+   uassert((size > 0) && ((size & (size - 1)) == 0));
+   uassert(size >= channelCount);
+   instance->interface.api = &api;
+   instance->output = output;
+   instance->entries = entries;
+   instance->channels = channels;
+   instance->channelCount = channelCount;
+   instance->mask = size - 1;
+   instance->head = 0;
+   instance->tail = 0;
+   instance->highWaterMark = 0;
+   instance->coalescedWrites = 0;
+
+   for(i = 0; i < channelCount; i++)
+   {
+      channels[i] = 0;
+   }
+}
+
+/*!
+ * The consumer releases an entry before it takes the channel's state, so that the producer only queues
+ * the channel again once its entry is free.
+ */
+uint32_t OutputDispatchQueue_Dispatch(OutputDispatchQueue_t *instance, uint32_t maxWrites)
+{
+   DigitalOutputWrite_t batch[OUTPUTDISPATCHQUEUE_BATCH_SIZE];
+   bool canWriteMany;
+   uint16_t batched = 0;
+   uint32_t written = 0;
+   uint32_t head;
+   uint32_t tail;
+
+   uassert(instance);
+   canWriteMany = DigitalOutputGroup_HasWriteMany(instance->output);
+   head = __atomic_load_n(&instance->head, __ATOMIC_ACQUIRE);
+   tail = instance->tail;
+
+   while((tail != head) && (written < maxWrites))
+   {
+      DigitalOutputChannel_t channel = instance->entries[tail & instance->mask];
+      bool state;
+
+      tail++;
+      __atomic_store_n(&instance->tail, tail, __ATOMIC_RELEASE);
+      state = (__atomic_exchange_n(&instance->channels[channel], 0, __ATOMIC_ACQ_REL) & CHANNEL_STATE) != 0;
+      written++;
+
+      if(!canWriteMany)
+      {
+         DigitalOutputGroup_Write(instance->output, channel, state);
+         continue;
+      }
+
+      batch[batched].channel = channel;
+      batch[batched].state = state;
+      batched++;
+      if(batched == OUTPUTDISPATCHQUEUE_BATCH_SIZE)
+      {
+         DigitalOutputGroup_WriteMany(instance->output, batch, batched);
+         batched = 0;
+      }
+   }
+
+   if(batched > 0)
+   {
+      DigitalOutputGroup_WriteMany(instance->output, batch, batched);
+   }
+   return written;
+}
+
+uint32_t OutputDispatchQueue_GetDepth(OutputDispatchQueue_t *instance)
+{
+   uassert(instance);
+   return __atomic_load_n(&instance->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&instance->tail, __ATOMIC_ACQUIRE);
+}
+
+uint32_t OutputDispatchQueue_GetHighWaterMark(OutputDispatchQueue_t *instance)
+{
+   uassert(instance);
+   return instance->highWaterMark;
+}
+
+void OutputDispatchQueue_ResetHighWaterMark(OutputDispatchQueue_t *instance)
+{
+   uassert(instance);
+   instance->highWaterMark = OutputDispatchQueue_GetDepth(instance);
+}
+
+uint32_t OutputDispatchQueue_GetCoalescedWriteCount(OutputDispatchQueue_t *instance)
+{
+   uassert(instance);
+   return instance->coalescedWrites;
+}
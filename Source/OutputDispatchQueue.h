@@ -0,0 +1,100 @@
+/*!
+ * @file
+ * @brief Digital output group that queues writes for another digital output group, so that a light
+ * scheduler run never waits on a slow output bus.  Writes are queued by the context that runs the
+ * scheduler and written to the real group by a separate consumer, such as a thread or an idle task,
+ * calling OutputDispatchQueue_Dispatch.
+ *
+ * The queue is lock-free with a single producer and a single consumer.  A channel is queued at most
+ * once: writing a channel that is still queued only changes the state that will be written, in the
+ * channel's place in the queue, so the queue never needs more than one entry per channel and never
+ * fills up.  Writes to different channels are dispatched in the order the channels were first queued.
+ */
+
+#ifndef OUTPUTDISPATCHQUEUE_H
+#define OUTPUTDISPATCHQUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "I_DigitalOutputGroup.h"
+
+/*!
+ * Number of writes collected by a dispatch before they are submitted to an output group that supports
+ * writing several channels at once.
+ */
+#ifndef OUTPUTDISPATCHQUEUE_BATCH_SIZE
+#define OUTPUTDISPATCHQUEUE_BATCH_SIZE (16)
+#endif
+
+typedef struct
+{
+   I_DigitalOutputGroup_t interface;
+   I_DigitalOutputGroup_t *output;
+   DigitalOutputChannel_t *entries;
+   uint8_t *channels;
+   uint32_t channelCount;
+   uint32_t mask;
+   uint32_t head;
+   uint32_t tail;
+   uint32_t highWaterMark;
+   uint32_t coalescedWrites;
+} OutputDispatchQueue_t;
+
+/*!
+ * Initialize an empty dispatch queue.
+ * @param instance The dispatch queue.
+ * @param output The digital output group that queued writes are dispatched to.
+ * @param entries Storage for the queued channels.  Must stay valid for as long as the queue is used.
+ * @param size Number of channels that fit in entries.  Must be a power of two no smaller than
+ *    channelCount.
+ * @param channels Storage for the queued state of each channel.  Must hold channelCount bytes and stay
+ *    valid for as long as the queue is used.
+ * @param channelCount Number of channels that can be written.
+ */
+void OutputDispatchQueue_Init(
+   OutputDispatchQueue_t *instance,
+   I_DigitalOutputGroup_t *output,
+   DigitalOutputChannel_t *entries,
+   uint32_t size,
+   uint8_t *channels,
+   uint32_t channelCount);
+
+/*!
+ * Write the queued writes to the output group.  Only called by the consumer.
+ * @param instance The dispatch queue.
+ * @param maxWrites The most writes to make.
+ * @return The number of writes made.
+ */
+uint32_t OutputDispatchQueue_Dispatch(OutputDispatchQueue_t *instance, uint32_t maxWrites);
+
+/*!
+ * Get the number of channels waiting to be dispatched.  May be called by the producer or the consumer.
+ * @param instance The dispatch queue.
+ * @return The number of queued channels.
+ */
+uint32_t OutputDispatchQueue_GetDepth(OutputDispatchQueue_t *instance);
+
+/*!
+ * Get the most channels that have been queued at once since the queue was initialized or the mark was
+ * reset.  Only called by the producer.
+ * @param instance The dispatch queue.
+ * @return The high-water mark of the queue depth.
+ */
+uint32_t OutputDispatchQueue_GetHighWaterMark(OutputDispatchQueue_t *instance);
+
+/*!
+ * Reset the high-water mark to the current depth.  Only called by the producer.
+ * @param instance The dispatch queue.
+ */
+void OutputDispatchQueue_ResetHighWaterMark(OutputDispatchQueue_t *instance);
+
+/*!
+ * Get the number of writes that replaced the state of a channel that was still queued.  Only called by
+ * the producer.
+ * @param instance The dispatch queue.
+ * @return The number of coalesced writes.
+ */
+uint32_t OutputDispatchQueue_GetCoalescedWriteCount(OutputDispatchQueue_t *instance);
+
+#endif
@@ -0,0 +1,280 @@
+/*!
+ * @file
+ * @brief Sharded light scheduler implementation.
+ */
+
+#include "ShardedLightScheduler.h"
+#include "uassert.h"
+
+static TimeSourceTickCount_t GetLatchedTicks(I_TimeSource_t *timeSource)
+{
+   return (TimeSourceTickCount_t)((ShardedLightSchedulerTickLatch_t *)timeSource)->ticks;
+}
+
+static TimeSourceWideTickCount_t GetLatchedWideTicks(I_TimeSource_t *timeSource)
+{
+   return ((ShardedLightSchedulerTickLatch_t *)timeSource)->ticks;
+}
+
+static const I_TimeSource_Api_t tickLatchApi =
+   { GetLatchedTicks, GetLatchedWideTicks };
+
+static LightScheduler_t *ShardFor(ShardedLightScheduler_t *instance, DigitalOutputChannel_t lightId)
+{
+   return &instance->shards[lightId % instance->numShards].scheduler;
+}
+
+/*!
+ * Holds a worker until every worker has been created, or until starting has failed and the worker must
+ * exit without ever waiting on the tick barriers.
+ */
+static bool WaitForStart(ShardedLightScheduler_t *instance)
+{
+   bool failed;
+
+   pthread_mutex_lock(&instance->startLock);
+   while(!instance->started)
+   {
+      pthread_cond_wait(&instance->startChanged, &instance->startLock);
+   }
+   failed = instance->startFailed;
+   pthread_mutex_unlock(&instance->startLock);
+   return !failed;
+}
+
+/*!
+ * Runs the shard once per tick.  The barriers order every access to the shard by the worker between
+ * the accesses made by the thread that owns the sharded scheduler.
+ */
+static void *RunShard(void *context)
+{
+   LightSchedulerShard_t *shard = context;
+   ShardedLightScheduler_t *instance = shard->parent;
+
+   if(!WaitForStart(instance))
+   {
+      return NULL;
+   }
+
+   while(true)
+   {
+      pthread_barrier_wait(&instance->tickStarted);
+      if(instance->stopping)
+      {
+         break;
+      }
+
+      LightScheduler_Run(&shard->scheduler);
+      pthread_barrier_wait(&instance->tickFinished);
+   }
+   return NULL;
+}
+
+/*!
+ * Creates the start gate and the tick barriers, destroying the ones already created if one fails.
+ */
+static bool InitSynchronization(ShardedLightScheduler_t *instance)
+{
+   if(pthread_mutex_init(&instance->startLock, NULL) != 0)
+   {
+      return false;
+   }
+
+   if(pthread_cond_init(&instance->startChanged, NULL) != 0)
+   {
+      pthread_mutex_destroy(&instance->startLock);
+      return false;
+   }
+
+   if(pthread_barrier_init(&instance->tickStarted, NULL, instance->numShards + 1) != 0)
+   {
+      pthread_cond_destroy(&instance->startChanged);
+      pthread_mutex_destroy(&instance->startLock);
+      return false;
+   }
+
+   if(pthread_barrier_init(&instance->tickFinished, NULL, instance->numShards + 1) != 0)
+   {
+      pthread_barrier_destroy(&instance->tickStarted);
+      pthread_cond_destroy(&instance->startChanged);
+      pthread_mutex_destroy(&instance->startLock);
+      return false;
+   }
+   return true;
+}
+
+static void DestroySynchronization(ShardedLightScheduler_t *instance)
+{
+   pthread_barrier_destroy(&instance->tickFinished);
+   pthread_barrier_destroy(&instance->tickStarted);
+   pthread_cond_destroy(&instance->startChanged);
+   pthread_mutex_destroy(&instance->startLock);
+}
+
+/*!
+ * Opens the start gate for the workers, telling them whether to run or to exit.
+ */
+static void Start(ShardedLightScheduler_t *instance, bool failed)
+{
+   pthread_mutex_lock(&instance->startLock);
+   instance->startFailed = failed;
+   instance->started = true;
+   pthread_cond_broadcast(&instance->startChanged);
+   pthread_mutex_unlock(&instance->startLock);
+}
+
+static void JoinShards(ShardedLightScheduler_t *instance, uint32_t numShards)
+{
+   uint32_t i;
+
+   for(i = 0; i < numShards; i++)
+   {
+      pthread_join(instance->shards[i].thread, NULL);
+   }
+}
+
+bool ShardedLightScheduler_Init(
+   ShardedLightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   LightSchedulerShard_t *shards,
+   uint32_t numShards,
+   uint64_t *storage,
+   ScheduleIndex_t capacityPerShard)
+{
+   uint32_t i;
+
+   uassert(instance);
+   uassert(lights);
+   uassert(timeSource);
+   uassert(shards);
+   uassert(numShards > 0);
+   uassert(storage);
+   instance->shards = shards;
+   instance->numShards = numShards;
+   instance->started = false;
+   instance->startFailed = false;
+   instance->stopping = false;
+   instance->tickLatch.interface.api = &tickLatchApi;
+   instance->tickLatch.ticks = 0;
+   instance->lastTick = 0;
+   instance->timeSource = timeSource;
+
+   if(!InitSynchronization(instance))
+   {
+      return false;
+   }
+
+   for(i = 0; i < numShards; i++)
+   {
+      LightScheduler_InitWithStorage(
+         &shards[i].scheduler,
+         lights,
+         &instance->tickLatch.interface,
+         &storage[i * LIGHTSCHEDULER_STORAGE_WORDS(capacityPerShard)],
+         capacityPerShard);
+      shards[i].parent = instance;
+   }
+
+   for(i = 0; i < numShards; i++)
+   {
+      if(pthread_create(&shards[i].thread, NULL, RunShard, &shards[i]) != 0)
+      {
+         Start(instance, true);
+         JoinShards(instance, i);
+         DestroySynchronization(instance);
+         return false;
+      }
+   }
+
+   Start(instance, false);
+   return true;
+}
+
+void ShardedLightScheduler_Destroy(ShardedLightScheduler_t *instance)
+{
+   uassert(instance);
+   instance->stopping = true;
+   pthread_barrier_wait(&instance->tickStarted);
+   JoinShards(instance, instance->numShards);
+   DestroySynchronization(instance);
+}
+
+ScheduleHandle_t ShardedLightScheduler_AddScheduleAt(
+   ShardedLightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time)
+{
+   uassert(instance);
+   return LightScheduler_AddScheduleAt(ShardFor(instance, lightId), lightId, lightState, time);
+}
+
+ScheduleHandle_t ShardedLightScheduler_AddRecurringSchedule(
+   ShardedLightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period)
+{
+   uassert(instance);
+   return LightScheduler_AddRecurringSchedule(ShardFor(instance, lightId), lightId, lightState, start, period);
+}
+
+bool ShardedLightScheduler_RemoveScheduleByHandle(
+   ShardedLightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   ScheduleHandle_t handle)
+{
+   uassert(instance);
+   return LightScheduler_RemoveScheduleByHandle(ShardFor(instance, lightId), handle);
+}
+
+void ShardedLightScheduler_SetCatchUp(ShardedLightScheduler_t *instance, bool enabled)
+{
+   uint32_t i;
+
+   uassert(instance);
+   for(i = 0; i < instance->numShards; i++)
+   {
+      LightScheduler_SetCatchUp(&instance->shards[i].scheduler, enabled);
+   }
+}
+
+void ShardedLightScheduler_Run(ShardedLightScheduler_t *instance)
+{
+   uassert(instance);
+
+   if(TimeSource_HasWideTicks(instance->timeSource))
+   {
+      instance->tickLatch.ticks = TimeSource_GetWideTicks(instance->timeSource);
+   }
+   else
+   {
+      instance->tickLatch.ticks = TimeSource_ExtendTicks(instance->lastTick, TimeSource_GetTicks(instance->timeSource));
+   }
+   instance->lastTick = instance->tickLatch.ticks;
+
+   pthread_barrier_wait(&instance->tickStarted);
+   pthread_barrier_wait(&instance->tickFinished);
+}
+
+bool ShardedLightScheduler_GetNextDueTime(ShardedLightScheduler_t *instance, TimeSourceWideTickCount_t *nextDueTime)
+{
+   bool found = false;
+   uint32_t i;
+
+   uassert(instance);
+   uassert(nextDueTime);
+   for(i = 0; i < instance->numShards; i++)
+   {
+      TimeSourceWideTickCount_t shardNextDue;
+
+      if(LightScheduler_GetNextDueTime(&instance->shards[i].scheduler, &shardNextDue) && (!found || (shardNextDue < *nextDueTime)))
+      {
+         *nextDueTime = shardNextDue;
+         found = true;
+      }
+   }
+   return found;
+}
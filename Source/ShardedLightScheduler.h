@@ -0,0 +1,153 @@
+/*!
+ * @file
+ * @brief Light scheduler front-end that partitions schedules by channel across several light scheduler
+ * shards, each run by its own worker thread.  Every shard processes the same tick before a run returns.
+ *
+ * Requires POSIX threads.  All functions must be called from one thread; the shards are only touched
+ * by their workers while a run is in progress.
+ */
+
+#ifndef SHARDEDLIGHTSCHEDULER_H
+#define SHARDEDLIGHTSCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "I_TimeSource.h"
+#include "I_DigitalOutputGroup.h"
+#include "LightScheduler.h"
+
+struct ShardedLightScheduler_t;
+
+/*!
+ * Time source given to the shards, which reports the time read once by the sharded scheduler for the
+ * current run.
+ */
+typedef struct
+{
+   I_TimeSource_t interface;
+   TimeSourceWideTickCount_t ticks;
+} ShardedLightSchedulerTickLatch_t;
+
+typedef struct
+{
+   LightScheduler_t scheduler;
+   pthread_t thread;
+   struct ShardedLightScheduler_t *parent;
+} LightSchedulerShard_t;
+
+typedef struct ShardedLightScheduler_t
+{
+   LightSchedulerShard_t *shards;
+   uint32_t numShards;
+   pthread_barrier_t tickStarted;
+   pthread_barrier_t tickFinished;
+   pthread_mutex_t startLock;
+   pthread_cond_t startChanged;
+   bool started;
+   bool startFailed;
+   bool stopping;
+   ShardedLightSchedulerTickLatch_t tickLatch;
+   TimeSourceWideTickCount_t lastTick;
+   I_TimeSource_t *timeSource;
+} ShardedLightScheduler_t;
+
+/*!
+ * Initialize a sharded light scheduler and start one worker thread per shard.  If the threads or the
+ * objects they synchronize with cannot be created, the workers already started are stopped and joined,
+ * and the sharded scheduler must not be used or destroyed.
+ * @param instance The sharded light scheduler.
+ * @param lights A digital output group that can be used to control the lights.  Each channel is only
+ *    ever written by the worker of the shard that owns it, in the order its schedules come due, but
+ *    workers write concurrently, so the group must accept concurrent writes to different channels.
+ * @param timeSource This is how the sharded light scheduler will get the current time.  It is read once
+ *    per run, by the thread calling ShardedLightScheduler_Run.
+ * @param shards Storage for the shards.  Must stay valid until ShardedLightScheduler_Destroy.
+ * @param numShards The number of shards and worker threads.  Channel x is owned by shard x % numShards.
+ * @param storage Storage for the schedules.  Must hold numShards *
+ *    LIGHTSCHEDULER_STORAGE_WORDS(capacityPerShard) words and stay valid until
+ *    ShardedLightScheduler_Destroy.
+ * @param capacityPerShard Number of schedules that fit in each shard.
+ * @return True if every worker thread was started.
+ */
+bool ShardedLightScheduler_Init(
+   ShardedLightScheduler_t *instance,
+   I_DigitalOutputGroup_t *lights,
+   I_TimeSource_t *timeSource,
+   LightSchedulerShard_t *shards,
+   uint32_t numShards,
+   uint64_t *storage,
+   ScheduleIndex_t capacityPerShard);
+
+/*!
+ * Stop and join the worker threads.
+ * @param instance The sharded light scheduler.
+ */
+void ShardedLightScheduler_Destroy(ShardedLightScheduler_t *instance);
+
+/*!
+ * Schedule a light to be turned on/off once at a wide tick count in the shard that owns the light.
+ * @param instance The sharded light scheduler.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param time The wide tick count at which lightState will be written to the light.
+ * @return A handle for removing the schedule, which is not valid if the shard was full.
+ */
+ScheduleHandle_t ShardedLightScheduler_AddScheduleAt(
+   ShardedLightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time);
+
+/*!
+ * Schedule a light to be turned on/off every period ticks in the shard that owns the light.
+ * @param instance The sharded light scheduler.
+ * @param lightId The light ID that will be controlled by the scheduler.
+ * @param lightState The state that will be written for the light (on/off).
+ * @param start The wide tick count of the first occurrence.
+ * @param period The number of ticks between occurrences.  Must not be 0 or UINT64_MAX.
+ * @return A handle for removing the schedule, which is not valid if the shard was full.
+ */
+ScheduleHandle_t ShardedLightScheduler_AddRecurringSchedule(
+   ShardedLightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t start,
+   TimeSourceWideTickCount_t period);
+
+/*!
+ * Remove a light schedule using the handle returned when it was added.
+ * @param instance The sharded light scheduler.
+ * @param lightId The light ID the schedule was added for, which selects the shard.
+ * @param handle The handle of the schedule.
+ * @return True if the schedule was removed, false if the handle was stale or not valid.
+ */
+bool ShardedLightScheduler_RemoveScheduleByHandle(
+   ShardedLightScheduler_t *instance,
+   DigitalOutputChannel_t lightId,
+   ScheduleHandle_t handle);
+
+/*!
+ * Enable or disable catch-up in every shard.
+ * @param instance The sharded light scheduler.
+ * @param enabled True to run schedules for ticks missed between runs.
+ */
+void ShardedLightScheduler_SetCatchUp(ShardedLightScheduler_t *instance, bool enabled);
+
+/*!
+ * Read the time once and have every shard run the schedules due at that time in parallel.  Returns
+ * once all shards are done.
+ * @param instance The sharded light scheduler.
+ */
+void ShardedLightScheduler_Run(ShardedLightScheduler_t *instance);
+
+/*!
+ * Get the wide tick count at which the next schedule in any shard is due.
+ * @param instance The sharded light scheduler.
+ * @param nextDueTime Set to the tick at which the next schedule is due, if there is one.
+ * @return True if a schedule is pending.
+ */
+bool ShardedLightScheduler_GetNextDueTime(ShardedLightScheduler_t *instance, TimeSourceWideTickCount_t *nextDueTime);
+
+#endif
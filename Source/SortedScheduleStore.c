@@ -0,0 +1,231 @@
+/*!
+ * @file
+ * @brief Sorted array schedule store implementation.
+ */
+
+#include <string.h>
+#include "SortedScheduleStore.h"
+#include "uassert.h"
+
+static const I_ScheduleStore_Api_t api =
+   {
+      SortedScheduleStore_Clear,
+      SortedScheduleStore_Insert,
+      SortedScheduleStore_Remove,
+      SortedScheduleStore_DueAt,
+      SortedScheduleStore_NextDueTime,
+      SortedScheduleStore_Find,
+      SortedScheduleStore_GetStateWord,
+      SortedScheduleStore_SetStateWord,
+      SortedScheduleStore_IsValid
+   };
+
+/*!
+ * Position of the first schedule due after time, if after is set, or at or after time otherwise.
+ */
+static ScheduleIndex_t Search(SortedScheduleStore_t *instance, TimeSourceWideTickCount_t time, bool after)
+{
+   const TimeSourceWideTickCount_t *times = instance->schedules->time;
+   ScheduleIndex_t low = instance->first;
+   ScheduleIndex_t high = instance->first + instance->count;
+
+   while(low < high)
+   {
+      ScheduleIndex_t middle = low + ((high - low) / 2);
+      TimeSourceWideTickCount_t middleTime = times[instance->order[middle]];
+
+      if((middleTime < time) || (after && (middleTime == time)))
+      {
+         low = middle + 1;
+      }
+      else
+      {
+         high = middle;
+      }
+   }
+   return low;
+}
+
+/*!
+ * Moves the schedules back to the start of the array once they reach its end.
+ */
+static void MakeRoomAtEnd(SortedScheduleStore_t *instance)
+{
+   if((instance->first + instance->count) == instance->capacity)
+   {
+      uassert(instance->first > 0);
+      memmove(instance->order, instance->order + instance->first, instance->count * sizeof(ScheduleIndex_t));
+      instance->first = 0;
+   }
+}
+
+void SortedScheduleStore_Init(SortedScheduleStore_t *instance, const ScheduleTable_t *schedules, ScheduleIndex_t capacity)
+{
+   uassert(instance);
+   uassert(schedules);
+   instance->interface.api = &api;
+   instance->schedules = schedules;
+   instance->order = schedules->store;
+   instance->capacity = capacity;
+   SortedScheduleStore_Clear(&instance->interface);
+}
+
+void SortedScheduleStore_Clear(I_ScheduleStore_t *_instance)
+{
+   SortedScheduleStore_t *instance = (SortedScheduleStore_t *)_instance;
+   instance->first = 0;
+   instance->count = 0;
+}
+
+/*!
+ * Inserts after every schedule due at or before the same time.
+ */
+void SortedScheduleStore_Insert(I_ScheduleStore_t *_instance, ScheduleIndex_t index)
+{
+   SortedScheduleStore_t *instance = (SortedScheduleStore_t *)_instance;
+   ScheduleIndex_t position;
+   ScheduleIndex_t end;
+
+   MakeRoomAtEnd(instance);
+   position = Search(instance, instance->schedules->time[index], true);
+   end = instance->first + instance->count;
+
+   memmove(instance->order + position + 1, instance->order + position, (end - position) * sizeof(ScheduleIndex_t));
+   instance->order[position] = index;
+   instance->count++;
+}
+
+/*!
+ * Removing the first schedule only moves the start of the array.
+ */
+void SortedScheduleStore_Remove(I_ScheduleStore_t *_instance, ScheduleIndex_t index)
+{
+   SortedScheduleStore_t *instance = (SortedScheduleStore_t *)_instance;
+   ScheduleIndex_t position = Search(instance, instance->schedules->time[index], false);
+   ScheduleIndex_t end = instance->first + instance->count;
+
+   while(instance->order[position] != index)
+   {
+      position++;
+      uassert(position < end);
+   }
+
+   instance->count--;
+   if(position == instance->first)
+   {
+      instance->first++;
+   }
+   else
+   {
+      memmove(instance->order + position, instance->order + position + 1, (end - position - 1) * sizeof(ScheduleIndex_t));
+   }
+}
+
+ScheduleIndex_t SortedScheduleStore_DueAt(I_ScheduleStore_t *_instance, TimeSourceWideTickCount_t tick)
+{
+   SortedScheduleStore_t *instance = (SortedScheduleStore_t *)_instance;
+   ScheduleIndex_t head;
+
+   if(instance->count == 0)
+   {
+      return SCHEDULE_INDEX_NONE;
+   }
+
+   head = instance->order[instance->first];
+   return (instance->schedules->time[head] == tick) ? head : SCHEDULE_INDEX_NONE;
+}
+
+bool SortedScheduleStore_NextDueTime(I_ScheduleStore_t *_instance, TimeSourceWideTickCount_t from, TimeSourceWideTickCount_t *tick)
+{
+   SortedScheduleStore_t *instance = (SortedScheduleStore_t *)_instance;
+   (void)from;
+
+   if(instance->count == 0)
+   {
+      return false;
+   }
+
+   *tick = instance->schedules->time[instance->order[instance->first]];
+   return true;
+}
+
+/*!
+ * A full time mask can be searched for; otherwise every schedule is compared, in time order.
+ */
+ScheduleIndex_t SortedScheduleStore_Find(
+   I_ScheduleStore_t *_instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time,
+   TimeSourceWideTickCount_t timeMask)
+{
+   SortedScheduleStore_t *instance = (SortedScheduleStore_t *)_instance;
+   ScheduleIndex_t position = (timeMask == UINT64_MAX) ? Search(instance, time, false) : instance->first;
+   ScheduleIndex_t end = instance->first + instance->count;
+
+   for(; position < end; position++)
+   {
+      ScheduleIndex_t i = instance->order[position];
+
+      if(ScheduleTable_Matches(instance->schedules, i, lightId, lightState, time, timeMask))
+      {
+         return i;
+      }
+      if((timeMask == UINT64_MAX) && (instance->schedules->time[i] != time))
+      {
+         break;
+      }
+   }
+   return SCHEDULE_INDEX_NONE;
+}
+
+uint32_t SortedScheduleStore_GetStateWord(I_ScheduleStore_t *_instance, uint32_t word)
+{
+   SortedScheduleStore_t *instance = (SortedScheduleStore_t *)_instance;
+   uassert(word < SORTEDSCHEDULESTORE_STATE_WORDS);
+   return (word == 0) ? instance->first : instance->count;
+}
+
+void SortedScheduleStore_SetStateWord(I_ScheduleStore_t *_instance, uint32_t word, uint32_t value)
+{
+   SortedScheduleStore_t *instance = (SortedScheduleStore_t *)_instance;
+   uassert(word < SORTEDSCHEDULESTORE_STATE_WORDS);
+   if(word == 0)
+   {
+      instance->first = value;
+   }
+   else
+   {
+      instance->count = value;
+   }
+}
+
+/*!
+ * The array must lie within the table, refer only to schedules in the table and be sorted by due time,
+ * since searches rely on the order.
+ */
+bool SortedScheduleStore_IsValid(I_ScheduleStore_t *_instance, ScheduleIndex_t capacity)
+{
+   SortedScheduleStore_t *instance = (SortedScheduleStore_t *)_instance;
+   const TimeSourceWideTickCount_t *times = instance->schedules->time;
+   ScheduleIndex_t position;
+
+   if((instance->first > capacity) || (instance->count > (capacity - instance->first)))
+   {
+      return false;
+   }
+
+   for(position = instance->first; position < (instance->first + instance->count); position++)
+   {
+      if(instance->order[position] >= capacity)
+      {
+         return false;
+      }
+
+      if((position > instance->first) && (times[instance->order[position - 1]] > times[instance->order[position]]))
+      {
+         return false;
+      }
+   }
+   return true;
+}
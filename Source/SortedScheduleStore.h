@@ -0,0 +1,59 @@
+/*!
+ * @file
+ * @brief Schedule store that keeps schedules in an array sorted by due time.  The schedules due next
+ * are at the front, so getting them and removing them takes constant time, and finding a schedule by
+ * its wide time takes a binary search.  Inserting shifts the schedules due later, so is cheapest when
+ * schedules are added in time order.
+ */
+
+#ifndef SORTEDSCHEDULESTORE_H
+#define SORTEDSCHEDULESTORE_H
+
+#include "I_ScheduleStore.h"
+
+/*!
+ * Number of columns of the schedule table used by the store: the sorted array.
+ */
+#define SORTEDSCHEDULESTORE_COLUMNS (1)
+
+/*!
+ * Number of words of fixed state: the position of the first schedule in the array and the number of
+ * schedules.
+ */
+#define SORTEDSCHEDULESTORE_STATE_WORDS (2)
+
+typedef struct
+{
+   I_ScheduleStore_t interface;
+   const ScheduleTable_t *schedules;
+   ScheduleIndex_t *order;
+   ScheduleIndex_t capacity;
+   ScheduleIndex_t first;
+   ScheduleIndex_t count;
+} SortedScheduleStore_t;
+
+/*!
+ * Initialize an empty sorted store.
+ * @param instance The store.
+ * @param schedules The schedule table.  Its store column must hold SORTEDSCHEDULESTORE_COLUMNS * capacity
+ *    indices.
+ * @param capacity Number of schedules in the table.
+ */
+void SortedScheduleStore_Init(SortedScheduleStore_t *instance, const ScheduleTable_t *schedules, ScheduleIndex_t capacity);
+
+void SortedScheduleStore_Clear(I_ScheduleStore_t *instance);
+void SortedScheduleStore_Insert(I_ScheduleStore_t *instance, ScheduleIndex_t index);
+void SortedScheduleStore_Remove(I_ScheduleStore_t *instance, ScheduleIndex_t index);
+ScheduleIndex_t SortedScheduleStore_DueAt(I_ScheduleStore_t *instance, TimeSourceWideTickCount_t tick);
+bool SortedScheduleStore_NextDueTime(I_ScheduleStore_t *instance, TimeSourceWideTickCount_t from, TimeSourceWideTickCount_t *tick);
+ScheduleIndex_t SortedScheduleStore_Find(
+   I_ScheduleStore_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time,
+   TimeSourceWideTickCount_t timeMask);
+uint32_t SortedScheduleStore_GetStateWord(I_ScheduleStore_t *instance, uint32_t word);
+void SortedScheduleStore_SetStateWord(I_ScheduleStore_t *instance, uint32_t word, uint32_t value);
+bool SortedScheduleStore_IsValid(I_ScheduleStore_t *instance, ScheduleIndex_t capacity);
+
+#endif
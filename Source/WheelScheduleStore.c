@@ -0,0 +1,366 @@
+/*!
+ * @file
+ * @brief Timing wheel schedule store implementation.
+ */
+
+#include "WheelScheduleStore.h"
+#include "uassert.h"
+
+#define WHEEL_MASK ((ScheduleIndex_t)(LIGHTSCHEDULER_WHEEL_SLOTS - 1))
+
+typedef char WheelSlotsMustBeAPowerOfTwo[((LIGHTSCHEDULER_WHEEL_SLOTS & WHEEL_MASK) == 0) ? 1 : -1];
+typedef char WheelSlotsMustNotExceedTickRange[(LIGHTSCHEDULER_WHEEL_SLOTS <= ((uint32_t)UINT16_MAX + 1)) ? 1 : -1];
+
+static const I_ScheduleStore_Api_t api =
+   {
+      WheelScheduleStore_Clear,
+      WheelScheduleStore_Insert,
+      WheelScheduleStore_Remove,
+      WheelScheduleStore_DueAt,
+      WheelScheduleStore_NextDueTime,
+      WheelScheduleStore_Find,
+      WheelScheduleStore_GetStateWord,
+      WheelScheduleStore_SetStateWord,
+      WheelScheduleStore_IsValid
+   };
+
+static ScheduleIndex_t BucketFor(TimeSourceWideTickCount_t time)
+{
+   return (ScheduleIndex_t)(time & WHEEL_MASK);
+}
+
+static bool BucketIsOccupied(WheelScheduleStore_t *instance, ScheduleIndex_t bucket)
+{
+   return (instance->occupied[bucket / 32] & (1UL << (bucket % 32))) != 0;
+}
+
+static void MarkBucketOccupied(WheelScheduleStore_t *instance, ScheduleIndex_t bucket)
+{
+   instance->occupied[bucket / 32] |= (1UL << (bucket % 32));
+   instance->occupiedWords[bucket / 1024] |= (1UL << ((bucket / 32) % 32));
+}
+
+static void MarkBucketEmpty(WheelScheduleStore_t *instance, ScheduleIndex_t bucket)
+{
+   instance->occupied[bucket / 32] &= ~(1UL << (bucket % 32));
+   if(instance->occupied[bucket / 32] == 0)
+   {
+      instance->occupiedWords[bucket / 1024] &= ~(1UL << ((bucket / 32) % 32));
+   }
+}
+
+/*!
+ * Distance from bucket to the next occupied bucket, wrapping around the wheel.  Returns limit if no
+ * bucket closer than limit is occupied.  Empty words are skipped 32 buckets at a time, and runs of 32
+ * empty words 1024 buckets at a time.
+ */
+static ScheduleIndex_t DistanceToOccupiedBucket(WheelScheduleStore_t *instance, ScheduleIndex_t bucket, ScheduleIndex_t limit)
+{
+   ScheduleIndex_t distance = 0;
+
+   while(distance < limit)
+   {
+      ScheduleIndex_t current = (bucket + distance) & WHEEL_MASK;
+
+      if(((current % 1024) == 0) && (instance->occupiedWords[current / 1024] == 0))
+      {
+         distance += 1024;
+      }
+      else if(((current % 32) == 0) && (instance->occupied[current / 32] == 0))
+      {
+         distance += 32;
+      }
+      else if(BucketIsOccupied(instance, current))
+      {
+         return distance;
+      }
+      else
+      {
+         distance++;
+      }
+   }
+
+   return limit;
+}
+
+/*!
+ * Points to a word of fixed state: the heads, then the tails, then the occupancy bitmaps.
+ */
+static uint32_t *StateWord(WheelScheduleStore_t *instance, uint32_t word)
+{
+   uassert(word < WHEELSCHEDULESTORE_STATE_WORDS);
+
+   if(word < LIGHTSCHEDULER_WHEEL_SLOTS)
+   {
+      return &instance->head[word];
+   }
+   word -= LIGHTSCHEDULER_WHEEL_SLOTS;
+
+   if(word < LIGHTSCHEDULER_WHEEL_SLOTS)
+   {
+      return &instance->tail[word];
+   }
+   word -= LIGHTSCHEDULER_WHEEL_SLOTS;
+
+   if(word < LIGHTSCHEDULER_WHEEL_WORDS)
+   {
+      return &instance->occupied[word];
+   }
+   return &instance->occupiedWords[word - LIGHTSCHEDULER_WHEEL_WORDS];
+}
+
+void WheelScheduleStore_Init(WheelScheduleStore_t *instance, const ScheduleTable_t *schedules, ScheduleIndex_t capacity)
+{
+   uassert(instance);
+   uassert(schedules);
+   instance->interface.api = &api;
+   instance->schedules = schedules;
+   instance->next = schedules->store;
+   instance->prev = schedules->store + capacity;
+   WheelScheduleStore_Clear(&instance->interface);
+}
+
+void WheelScheduleStore_Clear(I_ScheduleStore_t *_instance)
+{
+   WheelScheduleStore_t *instance = (WheelScheduleStore_t *)_instance;
+   ScheduleIndex_t i;
+
+   for(i = 0; i < LIGHTSCHEDULER_WHEEL_SLOTS; i++)
+   {
+      instance->head[i] = SCHEDULE_INDEX_NONE;
+      instance->tail[i] = SCHEDULE_INDEX_NONE;
+   }
+
+   for(i = 0; i < LIGHTSCHEDULER_WHEEL_WORDS; i++)
+   {
+      instance->occupied[i] = 0;
+   }
+
+   for(i = 0; i < LIGHTSCHEDULER_WHEEL_SUMMARY_WORDS; i++)
+   {
+      instance->occupiedWords[i] = 0;
+   }
+}
+
+/*!
+ * Links a schedule into its bucket, after every schedule due at or before the same time.  Buckets are
+ * usually appended to in time order, so the walk back from the tail is short.
+ */
+void WheelScheduleStore_Insert(I_ScheduleStore_t *_instance, ScheduleIndex_t index)
+{
+   WheelScheduleStore_t *instance = (WheelScheduleStore_t *)_instance;
+   const TimeSourceWideTickCount_t *times = instance->schedules->time;
+   TimeSourceWideTickCount_t time = times[index];
+   ScheduleIndex_t bucket = BucketFor(time);
+   ScheduleIndex_t prev = instance->tail[bucket];
+   ScheduleIndex_t next;
+
+   while((prev != SCHEDULE_INDEX_NONE) && (times[prev] > time))
+   {
+      prev = instance->prev[prev];
+   }
+
+   if(prev == SCHEDULE_INDEX_NONE)
+   {
+      next = instance->head[bucket];
+      instance->head[bucket] = index;
+      MarkBucketOccupied(instance, bucket);
+   }
+   else
+   {
+      next = instance->next[prev];
+      instance->next[prev] = index;
+   }
+
+   instance->prev[index] = prev;
+   instance->next[index] = next;
+   if(next == SCHEDULE_INDEX_NONE)
+   {
+      instance->tail[bucket] = index;
+   }
+   else
+   {
+      instance->prev[next] = index;
+   }
+}
+
+void WheelScheduleStore_Remove(I_ScheduleStore_t *_instance, ScheduleIndex_t index)
+{
+   WheelScheduleStore_t *instance = (WheelScheduleStore_t *)_instance;
+   ScheduleIndex_t bucket = BucketFor(instance->schedules->time[index]);
+   ScheduleIndex_t prev = instance->prev[index];
+   ScheduleIndex_t next = instance->next[index];
+
+   if(prev == SCHEDULE_INDEX_NONE)
+   {
+      instance->head[bucket] = next;
+      if(next == SCHEDULE_INDEX_NONE)
+      {
+         MarkBucketEmpty(instance, bucket);
+      }
+   }
+   else
+   {
+      instance->next[prev] = next;
+   }
+
+   if(next == SCHEDULE_INDEX_NONE)
+   {
+      instance->tail[bucket] = prev;
+   }
+   else
+   {
+      instance->prev[next] = prev;
+   }
+}
+
+/*!
+ * Nothing is due before tick, so the schedules due at tick are at the head of its bucket.
+ */
+ScheduleIndex_t WheelScheduleStore_DueAt(I_ScheduleStore_t *_instance, TimeSourceWideTickCount_t tick)
+{
+   WheelScheduleStore_t *instance = (WheelScheduleStore_t *)_instance;
+   ScheduleIndex_t head = instance->head[BucketFor(tick)];
+
+   if((head == SCHEDULE_INDEX_NONE) || (instance->schedules->time[head] != tick))
+   {
+      return SCHEDULE_INDEX_NONE;
+   }
+   return head;
+}
+
+/*!
+ * Every schedule is due at or after from, so the first bucket whose head is due in the current turn
+ * of the wheel holds the earliest schedule.  If no bucket matches within a full turn, the earliest
+ * head is the answer.
+ */
+bool WheelScheduleStore_NextDueTime(I_ScheduleStore_t *_instance, TimeSourceWideTickCount_t from, TimeSourceWideTickCount_t *tick)
+{
+   WheelScheduleStore_t *instance = (WheelScheduleStore_t *)_instance;
+   TimeSourceWideTickCount_t earliest = UINT64_MAX;
+   ScheduleIndex_t distance = 0;
+   bool found = false;
+
+   while(distance < LIGHTSCHEDULER_WHEEL_SLOTS)
+   {
+      TimeSourceWideTickCount_t headTime;
+
+      distance += DistanceToOccupiedBucket(instance, BucketFor(from + distance), LIGHTSCHEDULER_WHEEL_SLOTS - distance);
+      if(distance >= LIGHTSCHEDULER_WHEEL_SLOTS)
+      {
+         break;
+      }
+
+      headTime = instance->schedules->time[instance->head[BucketFor(from + distance)]];
+      if(headTime == from + distance)
+      {
+         *tick = headTime;
+         return true;
+      }
+      if(headTime <= earliest)
+      {
+         earliest = headTime;
+         found = true;
+      }
+      distance++;
+   }
+
+   if(found)
+   {
+      *tick = earliest;
+   }
+   return found;
+}
+
+/*!
+ * The wheel has no more than 65536 buckets, so a schedule matching a 16-bit time is in that time's
+ * bucket too, and only that bucket is searched.
+ */
+ScheduleIndex_t WheelScheduleStore_Find(
+   I_ScheduleStore_t *_instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time,
+   TimeSourceWideTickCount_t timeMask)
+{
+   WheelScheduleStore_t *instance = (WheelScheduleStore_t *)_instance;
+   ScheduleIndex_t i;
+
+   for(i = instance->head[BucketFor(time)]; i != SCHEDULE_INDEX_NONE; i = instance->next[i])
+   {
+      if(ScheduleTable_Matches(instance->schedules, i, lightId, lightState, time, timeMask))
+      {
+         return i;
+      }
+   }
+   return SCHEDULE_INDEX_NONE;
+}
+
+uint32_t WheelScheduleStore_GetStateWord(I_ScheduleStore_t *instance, uint32_t word)
+{
+   return *StateWord((WheelScheduleStore_t *)instance, word);
+}
+
+void WheelScheduleStore_SetStateWord(I_ScheduleStore_t *instance, uint32_t word, uint32_t value)
+{
+   *StateWord((WheelScheduleStore_t *)instance, word) = value;
+}
+
+/*!
+ * Walks every bucket, checking the links both ways and that no more schedules are linked than fit in the
+ * table, which also rules out cycles, and that each schedule is in the bucket for its time and sorted by
+ * it.  The occupancy bitmaps must match the buckets exactly, since a bucket marked occupied is assumed to
+ * have a head.
+ */
+bool WheelScheduleStore_IsValid(I_ScheduleStore_t *_instance, ScheduleIndex_t capacity)
+{
+   WheelScheduleStore_t *instance = (WheelScheduleStore_t *)_instance;
+   const TimeSourceWideTickCount_t *times = instance->schedules->time;
+   ScheduleIndex_t linked = 0;
+   ScheduleIndex_t bucket;
+   uint32_t word;
+
+   for(bucket = 0; bucket < LIGHTSCHEDULER_WHEEL_SLOTS; bucket++)
+   {
+      ScheduleIndex_t prev = SCHEDULE_INDEX_NONE;
+      ScheduleIndex_t i;
+
+      if(BucketIsOccupied(instance, bucket) != (instance->head[bucket] != SCHEDULE_INDEX_NONE))
+      {
+         return false;
+      }
+
+      for(i = instance->head[bucket]; i != SCHEDULE_INDEX_NONE; i = instance->next[i])
+      {
+         if((i >= capacity) || (linked == capacity) || (instance->prev[i] != prev))
+         {
+            return false;
+         }
+
+         if((BucketFor(times[i]) != bucket) || ((prev != SCHEDULE_INDEX_NONE) && (times[prev] > times[i])))
+         {
+            return false;
+         }
+         linked++;
+         prev = i;
+      }
+
+      if(instance->tail[bucket] != prev)
+      {
+         return false;
+      }
+   }
+
+   for(word = 0; word < LIGHTSCHEDULER_WHEEL_WORDS; word++)
+   {
+      uint32_t buckets = ((word + 1) * 32 <= LIGHTSCHEDULER_WHEEL_SLOTS) ? 32 : (LIGHTSCHEDULER_WHEEL_SLOTS % 32);
+      uint32_t unused = (buckets == 32) ? 0 : ~((1UL << buckets) - 1);
+      bool summary = (instance->occupiedWords[word / 32] & (1UL << (word % 32))) != 0;
+
+      if(((instance->occupied[word] & unused) != 0) || (summary != (instance->occupied[word] != 0)))
+      {
+         return false;
+      }
+   }
+   return true;
+}
@@ -0,0 +1,73 @@
+/*!
+ * @file
+ * @brief Schedule store that keeps schedules in a hashed timing wheel.  A schedule lives in the bucket
+ * for (time % LIGHTSCHEDULER_WHEEL_SLOTS), sorted by its wide time, so finding the schedules due at a
+ * tick only visits that tick's bucket.  Inserting, removing and getting the schedules due at a tick take
+ * constant time while buckets stay short.  Suits large tables.
+ */
+
+#ifndef WHEELSCHEDULESTORE_H
+#define WHEELSCHEDULESTORE_H
+
+#include "I_ScheduleStore.h"
+
+/*!
+ * Number of buckets in the timing wheel.  Must be a power of two no larger than 65536.  Each slot costs
+ * two schedule indices of RAM.
+ */
+#ifndef LIGHTSCHEDULER_WHEEL_SLOTS
+#define LIGHTSCHEDULER_WHEEL_SLOTS (16)
+#endif
+
+#define LIGHTSCHEDULER_WHEEL_WORDS ((LIGHTSCHEDULER_WHEEL_SLOTS + 31) / 32)
+#define LIGHTSCHEDULER_WHEEL_SUMMARY_WORDS ((LIGHTSCHEDULER_WHEEL_WORDS + 31) / 32)
+
+/*!
+ * Number of columns of the schedule table used by the store: the next and previous schedules in a
+ * bucket.
+ */
+#define WHEELSCHEDULESTORE_COLUMNS (2)
+
+/*!
+ * Number of words of fixed state: the bucket heads and tails and the occupancy bitmaps.
+ */
+#define WHEELSCHEDULESTORE_STATE_WORDS \
+   ((2 * LIGHTSCHEDULER_WHEEL_SLOTS) + LIGHTSCHEDULER_WHEEL_WORDS + LIGHTSCHEDULER_WHEEL_SUMMARY_WORDS)
+
+typedef struct
+{
+   I_ScheduleStore_t interface;
+   const ScheduleTable_t *schedules;
+   ScheduleIndex_t *next;
+   ScheduleIndex_t *prev;
+   ScheduleIndex_t head[LIGHTSCHEDULER_WHEEL_SLOTS];
+   ScheduleIndex_t tail[LIGHTSCHEDULER_WHEEL_SLOTS];
+   uint32_t occupied[LIGHTSCHEDULER_WHEEL_WORDS];
+   uint32_t occupiedWords[LIGHTSCHEDULER_WHEEL_SUMMARY_WORDS];
+} WheelScheduleStore_t;
+
+/*!
+ * Initialize an empty timing wheel store.
+ * @param instance The store.
+ * @param schedules The schedule table.  Its store column must hold WHEELSCHEDULESTORE_COLUMNS * capacity
+ *    indices.
+ * @param capacity Number of schedules in the table.
+ */
+void WheelScheduleStore_Init(WheelScheduleStore_t *instance, const ScheduleTable_t *schedules, ScheduleIndex_t capacity);
+
+void WheelScheduleStore_Clear(I_ScheduleStore_t *instance);
+void WheelScheduleStore_Insert(I_ScheduleStore_t *instance, ScheduleIndex_t index);
+void WheelScheduleStore_Remove(I_ScheduleStore_t *instance, ScheduleIndex_t index);
+ScheduleIndex_t WheelScheduleStore_DueAt(I_ScheduleStore_t *instance, TimeSourceWideTickCount_t tick);
+bool WheelScheduleStore_NextDueTime(I_ScheduleStore_t *instance, TimeSourceWideTickCount_t from, TimeSourceWideTickCount_t *tick);
+ScheduleIndex_t WheelScheduleStore_Find(
+   I_ScheduleStore_t *instance,
+   DigitalOutputChannel_t lightId,
+   bool lightState,
+   TimeSourceWideTickCount_t time,
+   TimeSourceWideTickCount_t timeMask);
+uint32_t WheelScheduleStore_GetStateWord(I_ScheduleStore_t *instance, uint32_t word);
+void WheelScheduleStore_SetStateWord(I_ScheduleStore_t *instance, uint32_t word, uint32_t value);
+bool WheelScheduleStore_IsValid(I_ScheduleStore_t *instance, ScheduleIndex_t capacity);
+
+#endif
@@ -0,0 +1,23 @@
+/*!
+ * @file
+ * @brief Implementation of CycleCounter_Mock.
+ */
+
+#include "CppUTestExt/MockSupport.h"
+#include "CycleCounter_Mock.h"
+#include "I_CycleCounter.h"
+
+static CycleCount_t GetCycles(I_CycleCounter_t *cycleCounter)
+{
+   return mock().actualCall("GetCycles")
+      .onObject((void *)cycleCounter)
+      .returnValue().getUnsignedIntValue();
+}
+
+static const I_CycleCounter_Api_t cycleCounterApi =
+   { GetCycles };
+
+void CycleCounter_Mock_Init(CycleCounter_Mock_t *instance)
+{
+   instance->interface.api = &cycleCounterApi;
+}
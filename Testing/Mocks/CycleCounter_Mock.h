@@ -0,0 +1,21 @@
+/*!
+ * @file
+ * @brief Simple mock of a cycle counter object, used for testing.
+ */
+
+#ifndef CYCLECOUNTER_MOCK_H
+#define CYCLECOUNTER_MOCK_H
+
+extern "C"
+{
+#include "I_CycleCounter.h"
+}
+
+typedef struct
+{
+   I_CycleCounter_t interface;
+} CycleCounter_Mock_t;
+
+void CycleCounter_Mock_Init(CycleCounter_Mock_t *instance);
+
+#endif
@@ -14,10 +14,35 @@ static void Write(I_DigitalOutputGroup_t *instance, const DigitalOutputChannel_t
       .withParameter("state", state);
 }
 
+static void WriteMany(I_DigitalOutputGroup_t *instance, const DigitalOutputWrite_t *writes, const uint16_t count)
+{
+   uint16_t i;
+
+   mock().actualCall("WriteMany")
+      .onObject(instance)
+      .withParameter("count", count);
+
+   for(i = 0; i < count; i++)
+   {
+      mock().actualCall("WriteManyEntry")
+         .onObject(instance)
+         .withParameter("channel", writes[i].channel)
+         .withParameter("state", writes[i].state);
+   }
+}
+
 static const I_DigitalOutputGroup_Api_t api =
-   { Write };
+   { Write, NULL };
+
+static const I_DigitalOutputGroup_Api_t writeManyApi =
+   { Write, WriteMany };
 
 void DigitalOutputGroup_Mock_Init(DigitalOutputGroup_Mock_t *instance)
 {
    instance->interface.api = &api;
 }
+
+void DigitalOutputGroup_Mock_InitWithWriteMany(DigitalOutputGroup_Mock_t *instance)
+{
+   instance->interface.api = &writeManyApi;
+}
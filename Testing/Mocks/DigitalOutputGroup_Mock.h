@@ -15,4 +15,10 @@ typedef struct
 
 void DigitalOutputGroup_Mock_Init(DigitalOutputGroup_Mock_t *instance);
 
+/*!
+ * Initialize a digital output group mock that also supports WriteMany.  Each call is recorded as a
+ * WriteMany call with the count followed by a WriteManyEntry call per write.
+ */
+void DigitalOutputGroup_Mock_InitWithWriteMany(DigitalOutputGroup_Mock_t *instance);
+
 #endif
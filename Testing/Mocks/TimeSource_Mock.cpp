@@ -16,10 +16,25 @@ static TimeSourceTickCount_t GetTicks(I_TimeSource_t *timeSource)
       .returnValue().getIntValue();
 }
 
+static TimeSourceWideTickCount_t GetWideTicks(I_TimeSource_t *timeSource)
+{
+   return mock().actualCall("GetWideTicks")
+      .onObject((void *)timeSource)
+      .returnValue().getUnsignedLongIntValue();
+}
+
 static const I_TimeSource_Api_t tsApi =
-   { GetTicks };
+   { GetTicks, NULL };
+
+static const I_TimeSource_Api_t wideTsApi =
+   { GetTicks, GetWideTicks };
 
 void TimeSource_Mock_Init(TimeSource_Mock_t *instance)
 {
    instance->interface.api = &tsApi;
 }
+
+void TimeSource_Mock_InitWide(TimeSource_Mock_t *instance)
+{
+   instance->interface.api = &wideTsApi;
+}
@@ -18,4 +18,9 @@ typedef struct
 
 void TimeSource_Mock_Init(TimeSource_Mock_t *instance);
 
+/*!
+ * Initialize a time source mock that also provides a wide tick count.
+ */
+void TimeSource_Mock_InitWide(TimeSource_Mock_t *instance);
+
 #endif
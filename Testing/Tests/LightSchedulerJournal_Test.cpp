@@ -0,0 +1,327 @@
+/*!
+
+* @file
+
+* @brief Tests for light scheduler journal implementation.
+
+*/
+
+extern "C"
+{
+#include <string.h>
+#include "LightSchedulerJournal.h"
+#include "LightSchedulerSnapshot.h"
+}
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "DigitalOutputGroup_Mock.h"
+#include "TimeSource_Mock.h"
+#include "uassert_test.h"
+
+enum
+{
+   Capacity = 4,
+   LogRecords = 8,
+   LogSize = LightSchedulerJournal_HeaderSize + (LogRecords * LightSchedulerJournal_RecordSize),
+   SnapshotWords = 1024
+};
+
+TEST_GROUP(LightSchedulerJournal)
+{
+   LightScheduler_t scheduler;
+   LightScheduler_t rebooted;
+   LightSchedulerJournal_t journal;
+   LightSchedulerJournal_t rebootedJournal;
+   uint64_t storage[LIGHTSCHEDULER_STORAGE_WORDS(Capacity)];
+   uint64_t rebootedStorage[LIGHTSCHEDULER_STORAGE_WORDS(Capacity)];
+   uint64_t snapshot[SnapshotWords];
+   uint8_t log[LogSize];
+   DigitalOutputGroup_Mock_t fakeDigitalOutputGroup;
+   TimeSource_Mock_t fakeTimeSource;
+
+   void setup()
+   {
+      DigitalOutputGroup_Mock_Init(&fakeDigitalOutputGroup);
+      TimeSource_Mock_InitWide(&fakeTimeSource);
+      LightScheduler_InitWithStorage(&scheduler, Lights(), TimeSource(), storage, Capacity);
+      LightSchedulerJournal_Init(&journal, &scheduler, log, sizeof(log));
+   }
+
+   I_DigitalOutputGroup_t *Lights()
+   {
+      return (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup;
+   }
+
+   I_TimeSource_t *TimeSource()
+   {
+      return (I_TimeSource_t *)&fakeTimeSource;
+   }
+
+   void WhenWideTimeIs(TimeSourceWideTickCount_t time)
+   {
+      mock().expectOneCall("GetWideTicks").onObject(&fakeTimeSource.interface).andReturnValue((unsigned long)time);
+   }
+
+   void GivenSchedulerHasRunAt(TimeSourceWideTickCount_t time)
+   {
+      WhenWideTimeIs(time);
+      LightScheduler_Run(&scheduler);
+   }
+
+   void GivenJournalHasRunAt(TimeSourceWideTickCount_t time)
+   {
+      WhenWideTimeIs(time);
+      CHECK_TRUE(LightSchedulerJournal_Run(&journal));
+   }
+
+   void ThenLightShouldBeOn(DigitalOutputChannel_t lightId)
+   {
+      mock().expectOneCall("Write").onObject(&fakeDigitalOutputGroup.interface).withParameter("channel", lightId).withParameter("state", true);
+   }
+
+   void WhenSchedulerReboots()
+   {
+      LightScheduler_InitWithStorage(&rebooted, Lights(), TimeSource(), rebootedStorage, Capacity);
+   }
+
+   void WhenSchedulerRebootsFromSnapshot()
+   {
+      CHECK_TRUE(LightSchedulerSnapshot_Restore(&rebooted, Lights(), TimeSource(), (uint8_t *)snapshot, sizeof(snapshot), rebootedStorage, Capacity));
+   }
+
+   void WhenJournalIsReplayed()
+   {
+      CHECK_TRUE(LightSchedulerJournal_Replay(&rebootedJournal, &rebooted, log, sizeof(log)));
+   }
+
+   void WhenRebootedIsRunAt(TimeSourceWideTickCount_t time)
+   {
+      WhenWideTimeIs(time);
+      LightScheduler_Run(&rebooted);
+   }
+
+   void ThenRebootedShouldHaveSchedules(ScheduleIndex_t count)
+   {
+      UNSIGNED_LONGS_EQUAL(count, rebooted.numSchedules);
+   }
+};
+
+TEST(LightSchedulerJournal, ChecksForNull)
+{
+   CHECK_ASSERTION_FAILED(LightSchedulerJournal_Init(NULL, &scheduler, log, sizeof(log)));
+   CHECK_ASSERTION_FAILED(LightSchedulerJournal_Init(&journal, NULL, log, sizeof(log)));
+   CHECK_ASSERTION_FAILED(LightSchedulerJournal_Init(&journal, &scheduler, NULL, sizeof(log)));
+   CHECK_ASSERTION_FAILED(LightSchedulerJournal_Init(&journal, &scheduler, log, LightSchedulerJournal_HeaderSize - 1));
+   CHECK_ASSERTION_FAILED(LightSchedulerJournal_Replay(&journal, NULL, log, sizeof(log)));
+   CHECK_ASSERTION_FAILED(LightSchedulerJournal_AddScheduleAt(NULL, 1, true, 10));
+   CHECK_ASSERTION_FAILED(LightSchedulerJournal_Run(NULL));
+   CHECK_ASSERTION_FAILED(LightSchedulerJournal_GetSize(NULL));
+}
+
+TEST(LightSchedulerJournal, ShouldAppendOneRecordPerChange)
+{
+   UNSIGNED_LONGS_EQUAL(LightSchedulerJournal_HeaderSize, LightSchedulerJournal_GetSize(&journal));
+   ScheduleHandle_t handle = LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 10);
+   LightSchedulerJournal_AddRecurringSchedule(&journal, 2, false, 10, 20);
+   CHECK_TRUE(LightSchedulerJournal_RemoveScheduleByHandle(&journal, handle));
+   UNSIGNED_LONGS_EQUAL(LightSchedulerJournal_HeaderSize + (3 * LightSchedulerJournal_RecordSize), LightSchedulerJournal_GetSize(&journal));
+}
+
+TEST(LightSchedulerJournal, ShouldNotRecordChangesThatFail)
+{
+   ScheduleHandle_t handle = LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 10);
+   CHECK_TRUE(LightSchedulerJournal_RemoveScheduleByHandle(&journal, handle));
+   CHECK_FALSE(LightSchedulerJournal_RemoveScheduleByHandle(&journal, handle));
+   UNSIGNED_LONGS_EQUAL(LightSchedulerJournal_HeaderSize + (2 * LightSchedulerJournal_RecordSize), LightSchedulerJournal_GetSize(&journal));
+}
+
+TEST(LightSchedulerJournal, ShouldRebuildSchedulesFromJournal)
+{
+   ScheduleHandle_t removed = LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 10);
+   LightSchedulerJournal_AddScheduleAt(&journal, 2, true, 20);
+   LightSchedulerJournal_AddRecurringSchedule(&journal, 3, true, 15, 100);
+   LightSchedulerJournal_RemoveScheduleByHandle(&journal, removed);
+
+   WhenSchedulerReboots();
+   WhenJournalIsReplayed();
+   ThenRebootedShouldHaveSchedules(2);
+
+   WhenRebootedIsRunAt(10);
+   ThenLightShouldBeOn(3);
+   WhenRebootedIsRunAt(15);
+   ThenLightShouldBeOn(2);
+   WhenRebootedIsRunAt(20);
+   ThenLightShouldBeOn(3);
+   WhenRebootedIsRunAt(115);
+}
+
+TEST(LightSchedulerJournal, ShouldKeepHandlesValidAcrossReplay)
+{
+   ScheduleHandle_t handle = LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 10);
+   WhenSchedulerReboots();
+   WhenJournalIsReplayed();
+   CHECK_TRUE(LightSchedulerJournal_RemoveScheduleByHandle(&rebootedJournal, handle));
+   ThenRebootedShouldHaveSchedules(0);
+}
+
+TEST(LightSchedulerJournal, ShouldRebuildSlotsReusedAfterOneShotRan)
+{
+   LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 10);
+   ThenLightShouldBeOn(1);
+   GivenSchedulerHasRunAt(10);
+   ScheduleHandle_t reused = LightSchedulerJournal_AddScheduleAt(&journal, 2, true, 20);
+
+   WhenSchedulerReboots();
+   WhenJournalIsReplayed();
+   ThenRebootedShouldHaveSchedules(1);
+   CHECK_TRUE(LightScheduler_RemoveScheduleByHandle(&rebooted, reused));
+}
+
+TEST(LightSchedulerJournal, ShouldKeepJournalingAfterReplay)
+{
+   LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 10);
+   WhenSchedulerReboots();
+   WhenJournalIsReplayed();
+   LightSchedulerJournal_AddScheduleAt(&rebootedJournal, 2, true, 20);
+   UNSIGNED_LONGS_EQUAL(LightSchedulerJournal_HeaderSize + (2 * LightSchedulerJournal_RecordSize), LightSchedulerJournal_GetSize(&rebootedJournal));
+
+   WhenSchedulerReboots();
+   CHECK_TRUE(LightSchedulerJournal_Replay(&rebootedJournal, &rebooted, log, sizeof(log)));
+   ThenRebootedShouldHaveSchedules(2);
+}
+
+TEST(LightSchedulerJournal, ShouldStopAtIncompleteRecord)
+{
+   LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 10);
+   LightSchedulerJournal_AddScheduleAt(&journal, 2, true, 20);
+   log[LightSchedulerJournal_HeaderSize + LightSchedulerJournal_RecordSize + 20] ^= 0xFF;
+
+   WhenSchedulerReboots();
+   WhenJournalIsReplayed();
+   ThenRebootedShouldHaveSchedules(1);
+   UNSIGNED_LONGS_EQUAL(LightSchedulerJournal_HeaderSize + LightSchedulerJournal_RecordSize, LightSchedulerJournal_GetSize(&rebootedJournal));
+}
+
+TEST(LightSchedulerJournal, ShouldStopAtErasedRecord)
+{
+   LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 10);
+   memset(log + LightSchedulerJournal_GetSize(&journal), 0xFF, sizeof(log) - LightSchedulerJournal_GetSize(&journal));
+
+   WhenSchedulerReboots();
+   CHECK_TRUE(LightSchedulerJournal_Replay(&rebootedJournal, &rebooted, log, sizeof(log)));
+   ThenRebootedShouldHaveSchedules(1);
+}
+
+TEST(LightSchedulerJournal, ShouldNotAddWhenJournalIsFull)
+{
+   uint8_t smallLog[LightSchedulerJournal_HeaderSize + LightSchedulerJournal_RecordSize];
+   LightSchedulerJournal_Init(&journal, &scheduler, smallLog, sizeof(smallLog));
+   ScheduleHandle_t handle = LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 10);
+   CHECK_FALSE(ScheduleHandle_IsValid(LightSchedulerJournal_AddScheduleAt(&journal, 2, true, 20)));
+   CHECK_FALSE(ScheduleHandle_IsValid(LightSchedulerJournal_AddRecurringSchedule(&journal, 2, true, 20, 10)));
+   CHECK_FALSE(LightSchedulerJournal_RemoveScheduleByHandle(&journal, handle));
+   UNSIGNED_LONGS_EQUAL(1, scheduler.numSchedules);
+}
+
+TEST(LightSchedulerJournal, ShouldNotRunOneShotAgainAfterReplay)
+{
+   GivenSchedulerHasRunAt(5);
+   LightSchedulerJournal_Compact(&journal, (uint8_t *)snapshot, sizeof(snapshot));
+   LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 10);
+   ThenLightShouldBeOn(1);
+   GivenJournalHasRunAt(10);
+
+   WhenSchedulerRebootsFromSnapshot();
+   WhenJournalIsReplayed();
+   ThenRebootedShouldHaveSchedules(0);
+   LightScheduler_SetCatchUp(&rebooted, true);
+   WhenRebootedIsRunAt(20);
+}
+
+TEST(LightSchedulerJournal, ShouldNotRunRecurringOccurrencesAgainAfterReplay)
+{
+   GivenSchedulerHasRunAt(5);
+   LightSchedulerJournal_Compact(&journal, (uint8_t *)snapshot, sizeof(snapshot));
+   LightSchedulerJournal_AddRecurringSchedule(&journal, 1, true, 10, 100);
+   ThenLightShouldBeOn(1);
+   GivenJournalHasRunAt(10);
+
+   WhenSchedulerRebootsFromSnapshot();
+   WhenJournalIsReplayed();
+   ThenRebootedShouldHaveSchedules(1);
+   LightScheduler_SetCatchUp(&rebooted, true);
+   WhenRebootedIsRunAt(50);
+   ThenLightShouldBeOn(1);
+   WhenRebootedIsRunAt(110);
+}
+
+TEST(LightSchedulerJournal, ShouldOnlyRecordFirstRunAndRunsWhereSchedulesCameDue)
+{
+   LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 10);
+   GivenJournalHasRunAt(5);
+   GivenJournalHasRunAt(6);
+   ThenLightShouldBeOn(1);
+   GivenJournalHasRunAt(10);
+   GivenJournalHasRunAt(11);
+   UNSIGNED_LONGS_EQUAL(LightSchedulerJournal_HeaderSize + (3 * LightSchedulerJournal_RecordSize), LightSchedulerJournal_GetSize(&journal));
+}
+
+TEST(LightSchedulerJournal, ShouldExtendTickCountSchedulesAgainstFirstRunOnReplay)
+{
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   CHECK_TRUE(LightSchedulerJournal_Compact(&journal, (uint8_t *)snapshot, sizeof(snapshot)) > 0);
+   GivenJournalHasRunAt(70000);
+
+   WhenSchedulerRebootsFromSnapshot();
+   WhenJournalIsReplayed();
+   ThenRebootedShouldHaveSchedules(1);
+   WhenRebootedIsRunAt((2 * LIGHTSCHEDULER_TICK_ROLLOVER_PERIOD) + 9);
+   ThenLightShouldBeOn(1);
+   WhenRebootedIsRunAt((2 * LIGHTSCHEDULER_TICK_ROLLOVER_PERIOD) + 10);
+}
+
+TEST(LightSchedulerJournal, ShouldReportRunThatCannotBeRecorded)
+{
+   uint8_t smallLog[LightSchedulerJournal_HeaderSize + LightSchedulerJournal_RecordSize];
+   LightSchedulerJournal_Init(&journal, &scheduler, smallLog, sizeof(smallLog));
+   LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 10);
+   ThenLightShouldBeOn(1);
+   WhenWideTimeIs(10);
+   CHECK_FALSE(LightSchedulerJournal_Run(&journal));
+   UNSIGNED_LONGS_EQUAL(0, scheduler.numSchedules);
+}
+
+TEST(LightSchedulerJournal, ShouldRebuildFromCompactedSnapshotAndJournal)
+{
+   LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 30);
+   GivenSchedulerHasRunAt(5);
+   CHECK_TRUE(LightSchedulerJournal_Compact(&journal, (uint8_t *)snapshot, sizeof(snapshot)) > 0);
+   UNSIGNED_LONGS_EQUAL(LightSchedulerJournal_HeaderSize, LightSchedulerJournal_GetSize(&journal));
+   LightSchedulerJournal_AddScheduleAt(&journal, 2, true, 20);
+
+   WhenSchedulerRebootsFromSnapshot();
+   WhenJournalIsReplayed();
+   ThenRebootedShouldHaveSchedules(2);
+   ThenLightShouldBeOn(2);
+   WhenRebootedIsRunAt(20);
+   ThenLightShouldBeOn(1);
+   WhenRebootedIsRunAt(30);
+}
+
+TEST(LightSchedulerJournal, ShouldKeepJournalWhenSnapshotDoesNotFit)
+{
+   LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 30);
+   UNSIGNED_LONGS_EQUAL(0, LightSchedulerJournal_Compact(&journal, (uint8_t *)snapshot, 1));
+   UNSIGNED_LONGS_EQUAL(LightSchedulerJournal_HeaderSize + LightSchedulerJournal_RecordSize, LightSchedulerJournal_GetSize(&journal));
+}
+
+TEST(LightSchedulerJournal, ShouldNotReplayJournalStartedFromOtherSchedules)
+{
+   LightSchedulerJournal_AddScheduleAt(&journal, 1, true, 30);
+   GivenSchedulerHasRunAt(5);
+   LightSchedulerJournal_Compact(&journal, (uint8_t *)snapshot, sizeof(snapshot));
+
+   WhenSchedulerReboots();
+   CHECK_FALSE(LightSchedulerJournal_Replay(&rebootedJournal, &rebooted, log, sizeof(log)));
+   ThenRebootedShouldHaveSchedules(0);
+}
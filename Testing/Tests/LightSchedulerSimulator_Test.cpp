@@ -0,0 +1,126 @@
+/*!
+
+* @file
+
+* @brief Tests for light scheduler simulator implementation.
+
+*/
+
+extern "C"
+{
+#include "LightSchedulerSimulator.h"
+}
+#include "CppUTest/TestHarness.h"
+#include "uassert_test.h"
+
+enum
+{
+   NumChannels = 40
+};
+
+TEST_GROUP(LightSchedulerSimulator)
+{
+   LightSchedulerSimulator_t simulator;
+   LightScheduler_t scheduler;
+   uint32_t states[LIGHTSCHEDULER_SIMULATOR_STATE_WORDS(NumChannels)];
+   uint64_t storage[LIGHTSCHEDULER_STORAGE_WORDS(NumChannels)];
+
+   void setup()
+   {
+      LightSchedulerSimulator_Init(&simulator, states, NumChannels);
+      LightScheduler_InitWithStorage(
+         &scheduler,
+         LightSchedulerSimulator_GetLights(&simulator),
+         LightSchedulerSimulator_GetTimeSource(&simulator),
+         storage,
+         NumChannels);
+   }
+
+   void ThenRunsUntilShouldBe(TimeSourceWideTickCount_t end, uint64_t runs)
+   {
+      UNSIGNED_LONGS_EQUAL(runs, LightSchedulerSimulator_RunUntil(&simulator, &scheduler, end));
+      UNSIGNED_LONGS_EQUAL(end, LightSchedulerSimulator_GetTicks(&simulator));
+   }
+};
+
+TEST(LightSchedulerSimulator, ChecksForNull)
+{
+   CHECK_ASSERTION_FAILED(LightSchedulerSimulator_Init(NULL, states, NumChannels));
+   CHECK_ASSERTION_FAILED(LightSchedulerSimulator_Init(&simulator, NULL, NumChannels));
+   CHECK_ASSERTION_FAILED(LightSchedulerSimulator_RunUntil(&simulator, NULL, 10));
+}
+
+TEST(LightSchedulerSimulator, ShouldStartWithEveryChannelOff)
+{
+   CHECK_FALSE(LightSchedulerSimulator_GetState(&simulator, 0));
+   CHECK_FALSE(LightSchedulerSimulator_GetState(&simulator, NumChannels - 1));
+   UNSIGNED_LONGS_EQUAL(0, LightSchedulerSimulator_GetEventCount(&simulator));
+   CHECK_ASSERTION_FAILED(LightSchedulerSimulator_GetState(&simulator, NumChannels));
+}
+
+TEST(LightSchedulerSimulator, ShouldOnlyRunAtTicksWithSomethingDue)
+{
+   LightScheduler_AddScheduleAt(&scheduler, 1, true, 1000);
+   LightScheduler_AddScheduleAt(&scheduler, 2, true, 1000000);
+   LightScheduler_AddScheduleAt(&scheduler, 3, true, 5000000);
+   ThenRunsUntilShouldBe(2000000, 3);
+   CHECK_TRUE(LightSchedulerSimulator_GetState(&simulator, 1));
+   CHECK_TRUE(LightSchedulerSimulator_GetState(&simulator, 2));
+   CHECK_FALSE(LightSchedulerSimulator_GetState(&simulator, 3));
+   UNSIGNED_LONGS_EQUAL(2, LightSchedulerSimulator_GetEventCount(&simulator));
+}
+
+TEST(LightSchedulerSimulator, ShouldRunScheduleDueAtTheEnd)
+{
+   LightScheduler_AddScheduleAt(&scheduler, 1, true, 100);
+   ThenRunsUntilShouldBe(100, 1);
+   CHECK_TRUE(LightSchedulerSimulator_GetState(&simulator, 1));
+}
+
+TEST(LightSchedulerSimulator, ShouldContinueFromWhereItStopped)
+{
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 20);
+   LightScheduler_AddRecurringSchedule(&scheduler, 1, false, 20, 20);
+   ThenRunsUntilShouldBe(25, 3);
+   CHECK_FALSE(LightSchedulerSimulator_GetState(&simulator, 1));
+   ThenRunsUntilShouldBe(30, 1);
+   CHECK_TRUE(LightSchedulerSimulator_GetState(&simulator, 1));
+   UNSIGNED_LONGS_EQUAL(3, LightSchedulerSimulator_GetEventCount(&simulator));
+}
+
+TEST(LightSchedulerSimulator, ShouldRecordEveryWriteOfARun)
+{
+   DigitalOutputChannel_t i;
+   for(i = 0; i < NumChannels; i++)
+   {
+      LightScheduler_AddScheduleAt(&scheduler, i, true, 10);
+   }
+   LightSchedulerSimulator_RunUntil(&simulator, &scheduler, 10);
+   UNSIGNED_LONGS_EQUAL(NumChannels, LightSchedulerSimulator_GetEventCount(&simulator));
+   CHECK_TRUE(LightSchedulerSimulator_GetState(&simulator, NumChannels - 1));
+}
+
+TEST(LightSchedulerSimulator, ShouldDigestChannelStates)
+{
+   uint64_t allOff = LightSchedulerSimulator_GetDigest(&simulator);
+   LightScheduler_AddScheduleAt(&scheduler, 5, true, 10);
+   LightSchedulerSimulator_RunUntil(&simulator, &scheduler, 10);
+   uint64_t fiveOn = LightSchedulerSimulator_GetDigest(&simulator);
+   CHECK_TRUE(allOff != fiveOn);
+
+   LightScheduler_AddScheduleAt(&scheduler, 5, false, 20);
+   LightSchedulerSimulator_RunUntil(&simulator, &scheduler, 20);
+   CHECK_TRUE(allOff == LightSchedulerSimulator_GetDigest(&simulator));
+}
+
+TEST(LightSchedulerSimulator, ShouldRejectWritesToUnknownChannels)
+{
+   LightScheduler_AddScheduleAt(&scheduler, NumChannels, true, 10);
+   CHECK_ASSERTION_FAILED(LightSchedulerSimulator_RunUntil(&simulator, &scheduler, 10));
+}
+
+TEST(LightSchedulerSimulator, ShouldNotRunBackwards)
+{
+   LightSchedulerSimulator_RunUntil(&simulator, &scheduler, 10);
+   CHECK_ASSERTION_FAILED(LightSchedulerSimulator_RunUntil(&simulator, &scheduler, 9));
+}
@@ -0,0 +1,347 @@
+/*!
+
+* @file
+
+* @brief Tests for light scheduler snapshot implementation.
+
+*/
+
+extern "C"
+{
+#include <stdio.h>
+#include <string.h>
+#include "LightSchedulerSnapshot.h"
+#include "LightSchedulerSnapshotFile.h"
+}
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "DigitalOutputGroup_Mock.h"
+#include "TimeSource_Mock.h"
+#include "uassert_test.h"
+
+enum
+{
+   Capacity = 8,
+   ImageWords = 4096
+};
+
+static const char snapshotPath[] = "Testing/Build/LightSchedulerSnapshot_Test.bin";
+
+TEST_GROUP(LightSchedulerSnapshot)
+{
+   LightScheduler_t original;
+   LightScheduler_t restored;
+   uint64_t originalStorage[LIGHTSCHEDULER_STORAGE_WORDS(Capacity)];
+   uint64_t restoredStorage[LIGHTSCHEDULER_STORAGE_WORDS(Capacity)];
+   uint64_t image[ImageWords];
+   size_t imageSize;
+   DigitalOutputGroup_Mock_t fakeDigitalOutputGroup;
+   TimeSource_Mock_t fakeTimeSource;
+
+   void setup()
+   {
+      DigitalOutputGroup_Mock_Init(&fakeDigitalOutputGroup);
+      TimeSource_Mock_InitWide(&fakeTimeSource);
+      LightScheduler_InitWithStorage(&original, Lights(), TimeSource(), originalStorage, Capacity);
+      imageSize = 0;
+   }
+
+   I_DigitalOutputGroup_t *Lights()
+   {
+      return (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup;
+   }
+
+   I_TimeSource_t *TimeSource()
+   {
+      return (I_TimeSource_t *)&fakeTimeSource;
+   }
+
+   uint8_t *Image()
+   {
+      return (uint8_t *)image;
+   }
+
+   void WhenWideTimeIs(TimeSourceWideTickCount_t time)
+   {
+      mock().expectOneCall("GetWideTicks").onObject(&fakeTimeSource.interface).andReturnValue((unsigned long)time);
+   }
+
+   void GivenOriginalHasRunAt(TimeSourceWideTickCount_t time)
+   {
+      WhenWideTimeIs(time);
+      LightScheduler_Run(&original);
+   }
+
+   void WhenSnapshotIsSaved()
+   {
+      imageSize = LightSchedulerSnapshot_Save(&original, Image(), sizeof(image));
+      CHECK_TRUE(imageSize > 0);
+   }
+
+   void WhenSnapshotIsRestored()
+   {
+      CHECK_TRUE(LightSchedulerSnapshot_Restore(&restored, Lights(), TimeSource(), Image(), imageSize, restoredStorage, Capacity));
+   }
+
+   void WhenSnapshotIsMapped()
+   {
+      CHECK_TRUE(LightSchedulerSnapshot_Map(&restored, Lights(), TimeSource(), Image(), imageSize));
+   }
+
+   void ThenLightShouldBeOn(DigitalOutputChannel_t lightId)
+   {
+      mock().expectOneCall("Write").onObject(&fakeDigitalOutputGroup.interface).withParameter("channel", lightId).withParameter("state", true);
+   }
+
+   void ThenLightShouldBeOff(DigitalOutputChannel_t lightId)
+   {
+      mock().expectOneCall("Write").onObject(&fakeDigitalOutputGroup.interface).withParameter("channel", lightId).withParameter("state", false);
+   }
+
+   void WhenRestoredIsRunAt(TimeSourceWideTickCount_t time)
+   {
+      WhenWideTimeIs(time);
+      LightScheduler_Run(&restored);
+   }
+
+   void ThenRestoredShouldRunTheOriginalSchedules()
+   {
+      WhenRestoredIsRunAt(20);
+      WhenWideTimeIs(30);
+      ThenLightShouldBeOn(1);
+      ThenLightShouldBeOff(2);
+      LightScheduler_Run(&restored);
+      WhenWideTimeIs(80);
+      ThenLightShouldBeOff(2);
+      LightScheduler_Run(&restored);
+   }
+
+   void GivenOriginalHasSchedules()
+   {
+      LightScheduler_AddScheduleAt(&original, 1, true, 30);
+      LightScheduler_AddRecurringSchedule(&original, 2, false, 30, 50);
+      LightScheduler_AddScheduleAt(&original, 3, true, 10);
+      GivenOriginalHasRunAt(5);
+      WhenWideTimeIs(10);
+      ThenLightShouldBeOn(3);
+      LightScheduler_Run(&original);
+   }
+};
+
+TEST(LightSchedulerSnapshot, ChecksForNull)
+{
+   CHECK_ASSERTION_FAILED(LightSchedulerSnapshot_Size(NULL));
+   CHECK_ASSERTION_FAILED(LightSchedulerSnapshot_Save(NULL, Image(), sizeof(image)));
+   CHECK_ASSERTION_FAILED(LightSchedulerSnapshot_Save(&original, NULL, sizeof(image)));
+   CHECK_ASSERTION_FAILED(LightSchedulerSnapshot_Capacity(NULL, sizeof(image)));
+   CHECK_ASSERTION_FAILED(LightSchedulerSnapshot_Restore(&restored, Lights(), TimeSource(), NULL, 0, restoredStorage, Capacity));
+   CHECK_ASSERTION_FAILED(LightSchedulerSnapshot_Map(&restored, Lights(), TimeSource(), NULL, 0));
+}
+
+TEST(LightSchedulerSnapshot, ShouldWriteTheReportedSize)
+{
+   UNSIGNED_LONGS_EQUAL(LightSchedulerSnapshot_Size(&original), LightSchedulerSnapshot_Save(&original, Image(), sizeof(image)));
+}
+
+TEST(LightSchedulerSnapshot, ShouldNotWriteToBufferThatIsTooSmall)
+{
+   UNSIGNED_LONGS_EQUAL(0, LightSchedulerSnapshot_Save(&original, Image(), LightSchedulerSnapshot_Size(&original) - 1));
+}
+
+TEST(LightSchedulerSnapshot, ShouldWriteFixedLittleEndianHeader)
+{
+   WhenSnapshotIsSaved();
+   BYTES_EQUAL('L', Image()[0]);
+   BYTES_EQUAL('S', Image()[1]);
+   BYTES_EQUAL('S', Image()[2]);
+   BYTES_EQUAL('N', Image()[3]);
+   BYTES_EQUAL(LightSchedulerSnapshot_Version, Image()[4]);
+   BYTES_EQUAL(0, Image()[5]);
+   BYTES_EQUAL(Capacity, Image()[12]);
+   UNSIGNED_LONGS_EQUAL(Capacity, LightSchedulerSnapshot_Capacity(Image(), imageSize));
+}
+
+TEST(LightSchedulerSnapshot, ShouldRejectSnapshotsThatAreNotValid)
+{
+   WhenSnapshotIsSaved();
+   UNSIGNED_LONGS_EQUAL(0, LightSchedulerSnapshot_Capacity(Image(), imageSize - 1));
+   Image()[4]++;
+   UNSIGNED_LONGS_EQUAL(0, LightSchedulerSnapshot_Capacity(Image(), imageSize));
+   CHECK_FALSE(LightSchedulerSnapshot_Restore(&restored, Lights(), TimeSource(), Image(), imageSize, restoredStorage, Capacity));
+   CHECK_FALSE(LightSchedulerSnapshot_Map(&restored, Lights(), TimeSource(), Image(), imageSize));
+}
+
+TEST(LightSchedulerSnapshot, ShouldRejectSnapshotsFromAnotherScheduleStore)
+{
+   WhenSnapshotIsSaved();
+   BYTES_EQUAL(LIGHTSCHEDULER_STORE, Image()[20]);
+   Image()[20]++;
+   UNSIGNED_LONGS_EQUAL(0, LightSchedulerSnapshot_Capacity(Image(), imageSize));
+}
+
+TEST(LightSchedulerSnapshot, ShouldRejectSnapshotsWithCorruptedSchedules)
+{
+   GivenOriginalHasSchedules();
+   WhenSnapshotIsSaved();
+   Image()[imageSize - 40] ^= 1;
+   UNSIGNED_LONGS_EQUAL(0, LightSchedulerSnapshot_Capacity(Image(), imageSize));
+   CHECK_FALSE(LightSchedulerSnapshot_Restore(&restored, Lights(), TimeSource(), Image(), imageSize, restoredStorage, Capacity));
+   CHECK_FALSE(LightSchedulerSnapshot_Map(&restored, Lights(), TimeSource(), Image(), imageSize));
+}
+
+TEST(LightSchedulerSnapshot, ShouldRejectSnapshotsWithSchedulesOutsideTheTable)
+{
+   GivenOriginalHasSchedules();
+   original.schedules.live[0] = Capacity;
+   WhenSnapshotIsSaved();
+   CHECK_FALSE(LightSchedulerSnapshot_Restore(&restored, Lights(), TimeSource(), Image(), imageSize, restoredStorage, Capacity));
+   CHECK_FALSE(LightSchedulerSnapshot_Map(&restored, Lights(), TimeSource(), Image(), imageSize));
+}
+
+TEST(LightSchedulerSnapshot, ShouldRejectSnapshotsWithActiveSchedulesOutsideTheLiveSet)
+{
+   GivenOriginalHasSchedules();
+   original.numSchedules--;
+   WhenSnapshotIsSaved();
+   CHECK_FALSE(LightSchedulerSnapshot_Restore(&restored, Lights(), TimeSource(), Image(), imageSize, restoredStorage, Capacity));
+}
+
+TEST(LightSchedulerSnapshot, ShouldRejectSnapshotsWithStoreOutsideTheTable)
+{
+   GivenOriginalHasSchedules();
+   LightSchedulerStore_SetStateWord(&original.store.interface, 0, Capacity + 1);
+   WhenSnapshotIsSaved();
+   CHECK_FALSE(LightSchedulerSnapshot_Restore(&restored, Lights(), TimeSource(), Image(), imageSize, restoredStorage, Capacity));
+   CHECK_FALSE(LightSchedulerSnapshot_Map(&restored, Lights(), TimeSource(), Image(), imageSize));
+}
+
+TEST(LightSchedulerSnapshot, ShouldNotRestoreIntoStorageOfAnotherCapacity)
+{
+   WhenSnapshotIsSaved();
+   CHECK_FALSE(LightSchedulerSnapshot_Restore(&restored, Lights(), TimeSource(), Image(), imageSize, restoredStorage, Capacity - 1));
+}
+
+TEST(LightSchedulerSnapshot, ShouldNotRestoreSnapshotThatIsNotValidIntoStorageOfNoCapacity)
+{
+   WhenSnapshotIsSaved();
+   Image()[4]++;
+   CHECK_FALSE(LightSchedulerSnapshot_Restore(&restored, Lights(), TimeSource(), Image(), imageSize, restoredStorage, 0));
+}
+
+TEST(LightSchedulerSnapshot, ShouldNotMapMisalignedSnapshot)
+{
+   WhenSnapshotIsSaved();
+   memmove(Image() + 1, Image(), imageSize);
+   CHECK_FALSE(LightSchedulerSnapshot_Map(&restored, Lights(), TimeSource(), Image() + 1, imageSize));
+}
+
+TEST(LightSchedulerSnapshot, ShouldRestoreSchedules)
+{
+   GivenOriginalHasSchedules();
+   WhenSnapshotIsSaved();
+   WhenSnapshotIsRestored();
+   ThenRestoredShouldRunTheOriginalSchedules();
+}
+
+TEST(LightSchedulerSnapshot, ShouldRunMappedSnapshotInPlace)
+{
+   GivenOriginalHasSchedules();
+   WhenSnapshotIsSaved();
+   WhenSnapshotIsMapped();
+   POINTERS_EQUAL(Image() + LightSchedulerSnapshot_Size(&original) - (8 * LIGHTSCHEDULER_STORAGE_WORDS(Capacity)), restored.schedules.time);
+   ThenRestoredShouldRunTheOriginalSchedules();
+}
+
+TEST(LightSchedulerSnapshot, ShouldKeepHandlesValid)
+{
+   ScheduleHandle_t handle = LightScheduler_AddScheduleAt(&original, 1, true, 30);
+   WhenSnapshotIsSaved();
+   WhenSnapshotIsRestored();
+   CHECK_TRUE(LightScheduler_RemoveScheduleByHandle(&restored, handle));
+}
+
+TEST(LightSchedulerSnapshot, ShouldRestoreLastProcessedTickAndCatchUp)
+{
+   LightScheduler_SetCatchUp(&original, true);
+   LightScheduler_AddScheduleAt(&original, 1, true, 30);
+   LightScheduler_AddScheduleAt(&original, 2, true, 40);
+   GivenOriginalHasRunAt(25);
+   WhenSnapshotIsSaved();
+   WhenSnapshotIsRestored();
+   WhenWideTimeIs(40);
+   ThenLightShouldBeOn(1);
+   ThenLightShouldBeOn(2);
+   LightScheduler_Run(&restored);
+}
+
+TEST(LightSchedulerSnapshot, ShouldAddToRestoredScheduler)
+{
+   GivenOriginalHasSchedules();
+   WhenSnapshotIsSaved();
+   WhenSnapshotIsMapped();
+   LightScheduler_AddScheduleAt(&restored, 4, true, 20);
+   ThenLightShouldBeOn(4);
+   WhenRestoredIsRunAt(20);
+   ThenLightShouldBeOn(1);
+   ThenLightShouldBeOff(2);
+   WhenRestoredIsRunAt(30);
+}
+
+TEST(LightSchedulerSnapshot, ShouldRunSnapshotFileFromMapping)
+{
+   LightSchedulerSnapshotFile_t file;
+   GivenOriginalHasSchedules();
+   CHECK_TRUE(LightSchedulerSnapshotFile_Save(&original, snapshotPath));
+   CHECK_TRUE(LightSchedulerSnapshotFile_Load(&file, &restored, Lights(), TimeSource(), snapshotPath));
+   ThenRestoredShouldRunTheOriginalSchedules();
+   LightSchedulerSnapshotFile_Close(&file);
+   remove(snapshotPath);
+}
+
+TEST(LightSchedulerSnapshot, ShouldReplaceSnapshotFileWithoutLeavingTemporaryFile)
+{
+   LightSchedulerSnapshotFile_t file;
+   char temporaryPath[sizeof(snapshotPath) + 4];
+   FILE *old;
+   GivenOriginalHasSchedules();
+   old = fopen(snapshotPath, "wb");
+   fputs("old snapshot", old);
+   fclose(old);
+   CHECK_TRUE(LightSchedulerSnapshotFile_Save(&original, snapshotPath));
+   sprintf(temporaryPath, "%s.tmp", snapshotPath);
+   POINTERS_EQUAL(NULL, fopen(temporaryPath, "rb"));
+   CHECK_TRUE(LightSchedulerSnapshotFile_Load(&file, &restored, Lights(), TimeSource(), snapshotPath));
+   LightSchedulerSnapshotFile_Close(&file);
+   remove(snapshotPath);
+}
+
+TEST(LightSchedulerSnapshot, ShouldNotLoadCorruptedSnapshotFile)
+{
+   LightSchedulerSnapshotFile_t file;
+   FILE *corrupted;
+   int byte;
+   GivenOriginalHasSchedules();
+   CHECK_TRUE(LightSchedulerSnapshotFile_Save(&original, snapshotPath));
+   corrupted = fopen(snapshotPath, "r+b");
+   fseek(corrupted, -40, SEEK_END);
+   byte = fgetc(corrupted);
+   fseek(corrupted, -40, SEEK_END);
+   fputc(byte ^ 1, corrupted);
+   fclose(corrupted);
+   CHECK_FALSE(LightSchedulerSnapshotFile_Load(&file, &restored, Lights(), TimeSource(), snapshotPath));
+   POINTERS_EQUAL(NULL, file.image);
+   remove(snapshotPath);
+}
+
+TEST(LightSchedulerSnapshot, ShouldNotLoadMissingOrInvalidSnapshotFile)
+{
+   LightSchedulerSnapshotFile_t file;
+   FILE *invalid;
+   CHECK_FALSE(LightSchedulerSnapshotFile_Load(&file, &restored, Lights(), TimeSource(), "Testing/Build/Missing.bin"));
+   invalid = fopen(snapshotPath, "wb");
+   fputs("not a snapshot", invalid);
+   fclose(invalid);
+   CHECK_FALSE(LightSchedulerSnapshotFile_Load(&file, &restored, Lights(), TimeSource(), snapshotPath));
+   POINTERS_EQUAL(NULL, file.image);
+   remove(snapshotPath);
+}
@@ -13,20 +13,43 @@ extern "C"
 }
 #include "CppUTest/TestHarness.h"
 #include "CppUTestExt/MockSupport.h"
+#include "CycleCounter_Mock.h"
 #include "DigitalOutputGroup_Mock.h"
 #include "TimeSource_Mock.h"
 #include "uassert_test.h"
 
+static const LightScheduleEntry_t dailyEntries[] = {
+   LIGHTSCHEDULER_ENTRY(10, 1, true),
+   LIGHTSCHEDULER_ENTRY(20, 2, true),
+   LIGHTSCHEDULER_ENTRY(20, 3, true),
+   LIGHTSCHEDULER_ENTRY(40, 1, false)
+};
+static const LightScheduleTable_t dailyTable = LIGHTSCHEDULER_TABLE(dailyEntries, 100);
+static const LightScheduleTable_t onceTable = LIGHTSCHEDULER_TABLE(dailyEntries, 0);
+
+enum
+{
+   StorageCapacity = MAX_SCHEDULES * 2,
+   ShadowChannels = 40,
+   QueueSize = 4
+};
+
 TEST_GROUP(LightScheduler)
 {
    LightScheduler_t scheduler;
+   uint64_t storage[LIGHTSCHEDULER_STORAGE_WORDS(StorageCapacity)];
+   uint32_t shadow[LIGHTSCHEDULER_SHADOW_WORDS(ShadowChannels)];
+   ScheduleIndex_t lightIndex[LIGHTSCHEDULER_LIGHT_INDEX_SIZE(ShadowChannels, StorageCapacity)];
+   LightSchedulerCommand_t commands[QueueSize];
    DigitalOutputGroup_Mock_t fakeDigitalOutputGroup;
    TimeSource_Mock_t fakeTimeSource;
+   CycleCounter_Mock_t fakeCycleCounter;
 
    void setup()
    {
       DigitalOutputGroup_Mock_Init(&fakeDigitalOutputGroup);
       TimeSource_Mock_Init(&fakeTimeSource);
+      CycleCounter_Mock_Init(&fakeCycleCounter);
    }
 
    void WhenLightSchedulerIsInitialized()
@@ -34,6 +57,11 @@ TEST_GROUP(LightScheduler)
       LightScheduler_Init(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource);
    }
 
+   void WhenLightSchedulerIsInitializedWithStorage(ScheduleIndex_t capacity)
+   {
+      LightScheduler_InitWithStorage(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource, storage, capacity);
+   }
+
    void NothingShouldHappen()
    {
    }
@@ -76,11 +104,66 @@ TEST_GROUP(LightScheduler)
       LightScheduler_RemoveSchedule(instance, lightId, lightState, time);
    }
 
+   void GivenTimeSourceHasWideTicks()
+   {
+      TimeSource_Mock_InitWide(&fakeTimeSource);
+   }
+
+   void WhenEventScheduledAtWideTime(DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time)
+   {
+      LightScheduler_AddScheduleAt(&scheduler, lightId, lightState, time);
+   }
+
+   void AfterRemoveScheduleAtWideTime(DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time)
+   {
+      LightScheduler_RemoveScheduleAt(&scheduler, lightId, lightState, time);
+   }
+
+   void WhenRecurringEventScheduled(DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t start, TimeSourceWideTickCount_t period)
+   {
+      LightScheduler_AddRecurringSchedule(&scheduler, lightId, lightState, start, period);
+   }
+
+   void AfterRemoveRecurringSchedule(DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t start, TimeSourceWideTickCount_t period)
+   {
+      LightScheduler_RemoveRecurringSchedule(&scheduler, lightId, lightState, start, period);
+   }
+
+   void ThenRemoveByHandleShouldSucceed(ScheduleHandle_t handle)
+   {
+      CHECK_TRUE(LightScheduler_RemoveScheduleByHandle(&scheduler, handle));
+   }
+
+   void ThenRemoveByHandleShouldBeIgnored(ScheduleHandle_t handle)
+   {
+      CHECK_FALSE(LightScheduler_RemoveScheduleByHandle(&scheduler, handle));
+   }
+
+   void GivenConstantTable(const LightScheduleTable_t *table)
+   {
+      LightScheduler_SetConstantTable(&scheduler, table);
+   }
+
+   void GivenCommandQueueIsEnabled()
+   {
+      LightScheduler_EnableCommandQueue(&scheduler, commands, QueueSize);
+   }
+
+   void WhenEventIsQueuedAt(DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time)
+   {
+      CHECK_TRUE(LightScheduler_QueueScheduleAt(&scheduler, lightId, lightState, time));
+   }
+
    void WhenTimeIs(TimeSourceTickCount_t time)
    {
       mock().expectOneCall("GetTicks").onObject(&fakeTimeSource.interface).andReturnValue(time);
    }
 
+   void WhenWideTimeIs(TimeSourceWideTickCount_t time)
+   {
+      mock().expectOneCall("GetWideTicks").onObject(&fakeTimeSource.interface).andReturnValue((unsigned long)time);
+   }
+
    void ThenLightShouldBeOn(DigitalOutputChannel_t lightId)
    {
       mock().expectOneCall("Write").onObject(&fakeDigitalOutputGroup.interface).withParameter("channel", lightId).withParameter("state", true);
@@ -91,10 +174,112 @@ TEST_GROUP(LightScheduler)
       mock().expectOneCall("Write").onObject(&fakeDigitalOutputGroup.interface).withParameter("channel", lightId).withParameter("state", false);
    }
 
+   void GivenLightsCanBeWrittenTogether()
+   {
+      DigitalOutputGroup_Mock_InitWithWriteMany(&fakeDigitalOutputGroup);
+   }
+
+   void ThenLightsShouldBeWrittenTogether(uint16_t count)
+   {
+      mock().expectOneCall("WriteMany").onObject(&fakeDigitalOutputGroup.interface).withParameter("count", count);
+   }
+
+   void ThenLightShouldBeWrittenInBatch(DigitalOutputChannel_t lightId, bool state)
+   {
+      mock().expectOneCall("WriteManyEntry").onObject(&fakeDigitalOutputGroup.interface).withParameter("channel", lightId).withParameter("state", state);
+   }
+
+   void GivenRedundantWritesAreSuppressed()
+   {
+      LightScheduler_EnableWriteSuppression(&scheduler, shadow, ShadowChannels);
+   }
+
+   void ThenElidedWriteCountShouldBe(uint32_t expected)
+   {
+      UNSIGNED_LONGS_EQUAL(expected, LightScheduler_GetElidedWriteCount(&scheduler));
+   }
+
+   void GivenLightsAreIndexed()
+   {
+      LightScheduler_EnableLightIndex(&scheduler, lightIndex, ShadowChannels);
+   }
+
+   void ThenRemoveAllForLightShouldRemove(DigitalOutputChannel_t lightId, uint32_t expected)
+   {
+      UNSIGNED_LONGS_EQUAL(expected, LightScheduler_RemoveAllForLight(&scheduler, lightId));
+   }
+
+   void ThenNextForLightShouldBe(DigitalOutputChannel_t lightId, TimeSourceWideTickCount_t expectedTime, bool expectedState)
+   {
+      TimeSourceWideTickCount_t time = 0;
+      bool state = !expectedState;
+      CHECK_TRUE(LightScheduler_GetNextForLight(&scheduler, lightId, &time, &state));
+      UNSIGNED_LONGS_EQUAL(expectedTime, time);
+      CHECK_EQUAL(expectedState, state);
+   }
+
+   void ThenNothingShouldBeNextForLight(DigitalOutputChannel_t lightId)
+   {
+      TimeSourceWideTickCount_t time;
+      bool state;
+      CHECK_FALSE(LightScheduler_GetNextForLight(&scheduler, lightId, &time, &state));
+   }
+
+   void ThenNothingShouldBeDue()
+   {
+      TimeSourceWideTickCount_t nextDueTime;
+      CHECK_FALSE(LightScheduler_GetNextDueTime(&scheduler, &nextDueTime));
+   }
+
+   void ThenNextDueTimeShouldBe(TimeSourceWideTickCount_t expected)
+   {
+      TimeSourceWideTickCount_t nextDueTime = 0;
+      CHECK_TRUE(LightScheduler_GetNextDueTime(&scheduler, &nextDueTime));
+      UNSIGNED_LONGS_EQUAL(expected, nextDueTime);
+   }
+
    void WhenSchedulerIsRun(LightScheduler_t * instance)
    {
       LightScheduler_Run(instance);
    }
+
+   void GivenCatchUpIsEnabled()
+   {
+      LightScheduler_SetCatchUp(&scheduler, true);
+   }
+
+   void GivenSchedulerHasRunAt(TimeSourceTickCount_t time)
+   {
+      WhenTimeIs(time);
+      WhenSchedulerIsRun(&scheduler);
+   }
+
+   void GivenSchedulerHasRunAtWideTime(TimeSourceWideTickCount_t time)
+   {
+      WhenWideTimeIs(time);
+      WhenSchedulerIsRun(&scheduler);
+   }
+
+   void GivenCallsMustHappenInOrder()
+   {
+      mock().strictOrder();
+   }
+
+   void GivenRunLatencyIsMeasured()
+   {
+      LightScheduler_SetCycleCounter(&scheduler, &fakeCycleCounter.interface);
+   }
+
+   void WhenRunTakesCycles(CycleCount_t start, CycleCount_t end)
+   {
+      mock().expectOneCall("GetCycles").onObject(&fakeCycleCounter.interface).andReturnValue(start);
+      mock().expectOneCall("GetCycles").onObject(&fakeCycleCounter.interface).andReturnValue(end);
+   }
+
+   const LightSchedulerStats_t *Stats()
+   {
+      return LightScheduler_GetStats(&scheduler);
+   }
 };
 
 TEST(LightScheduler, InitNullChecks)
@@ -104,6 +289,12 @@ TEST(LightScheduler, InitNullChecks)
    CHECK_ASSERTION_FAILED(LightScheduler_Init(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, NULL));
 }
 
+TEST(LightScheduler, InitWithStorageChecks)
+{
+   CHECK_ASSERTION_FAILED(LightScheduler_InitWithStorage(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource, NULL, StorageCapacity));
+   CHECK_ASSERTION_FAILED(LightScheduler_InitWithStorage(&scheduler, (I_DigitalOutputGroup_t *)&fakeDigitalOutputGroup, (I_TimeSource_t *)&fakeTimeSource, storage, 0));
+}
+
 TEST(LightScheduler, CheckNullSchedulerAddEventFails)
 {
    CHECK_ASSERTION_FAILED(WhenEventScheduledAt(NULL, 1, true, 10));
@@ -219,4 +410,1451 @@ TEST(LightScheduler, RemoveInvalidSchedule)
    WhenLightSchedulerIsInitialized();
    WhenLightScheduledOnAt(&scheduler, 1, 20);
    CHECK_ASSERTION_FAILED(AfterRemoveScheduleAt(&scheduler, 2, false, 24));
-}
\ No newline at end of file
+}
+
+TEST(LightScheduler, ShouldOnlyRunSchedulesForCurrentTickWhenSharingWheelBucket)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenLightScheduledOnAt(&scheduler, 2, 10 + LIGHTSCHEDULER_WHEEL_SLOTS);
+   WhenTimeIs(10 + LIGHTSCHEDULER_WHEEL_SLOTS);
+   ThenLightShouldBeOn(2);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldKeepOtherSchedulesInBucketAfterRemove)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenLightScheduledOnAt(&scheduler, 2, 10 + LIGHTSCHEDULER_WHEEL_SLOTS);
+   WhenLightScheduledOnAt(&scheduler, 3, 10);
+   AfterRemoveScheduleAt(&scheduler, 1, true, 10);
+   WhenTimeIs(10);
+   ThenLightShouldBeOn(3);
+   WhenSchedulerIsRun(&scheduler);
+   WhenTimeIs(10 + LIGHTSCHEDULER_WHEEL_SLOTS);
+   ThenLightShouldBeOn(2);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldUseCallerProvidedStorageCapacity)
+{
+   DigitalOutputChannel_t i;
+   WhenLightSchedulerIsInitializedWithStorage(StorageCapacity);
+   for(i = 0; i <= StorageCapacity; i++)
+   {
+      WhenLightScheduledOnAt(&scheduler, i, 10);
+   }
+   WhenTimeIs(10);
+   for(i = 0; i < StorageCapacity; i++)
+   {
+      ThenLightShouldBeOn(i);
+   }
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldReuseSlotFreedFromCallerProvidedStorage)
+{
+   WhenLightSchedulerIsInitializedWithStorage(1);
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   AfterRemoveScheduleAt(&scheduler, 1, true, 10);
+   WhenLightScheduledOffAt(&scheduler, 2, 10);
+   WhenTimeIs(10);
+   ThenLightShouldBeOff(2);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, CheckNullSchedulerSetCatchUpFails)
+{
+   CHECK_ASSERTION_FAILED(LightScheduler_SetCatchUp(NULL, true));
+}
+
+TEST(LightScheduler, ShouldSkipMissedTicksWithoutCatchUp)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 11);
+   GivenSchedulerHasRunAt(10);
+   WhenTimeIs(12);
+   NothingShouldHappen();
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldRunMissedTicksInOrderWithCatchUp)
+{
+   GivenCallsMustHappenInOrder();
+   WhenLightSchedulerIsInitialized();
+   GivenCatchUpIsEnabled();
+   WhenLightScheduledOffAt(&scheduler, 1, 13);
+   WhenLightScheduledOnAt(&scheduler, 2, 11);
+   WhenLightScheduledOnAt(&scheduler, 1, 12);
+   WhenLightScheduledOnAt(&scheduler, 3, 14);
+   GivenSchedulerHasRunAt(10);
+   WhenTimeIs(13);
+   ThenLightShouldBeOn(2);
+   ThenLightShouldBeOn(1);
+   ThenLightShouldBeOff(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldNotRunScheduleBeforeFirstRunWithCatchUp)
+{
+   WhenLightSchedulerIsInitialized();
+   GivenCatchUpIsEnabled();
+   WhenLightScheduledOnAt(&scheduler, 1, 9);
+   WhenTimeIs(10);
+   NothingShouldHappen();
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldNotRunTickTwiceWithCatchUp)
+{
+   WhenLightSchedulerIsInitialized();
+   GivenCatchUpIsEnabled();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   WhenTimeIs(10);
+   NothingShouldHappen();
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldCatchUpAcrossTickRollover)
+{
+   GivenCallsMustHappenInOrder();
+   WhenLightSchedulerIsInitialized();
+   GivenCatchUpIsEnabled();
+   WhenLightScheduledOnAt(&scheduler, 1, UINT16_MAX);
+   WhenLightScheduledOnAt(&scheduler, 2, 0);
+   WhenLightScheduledOnAt(&scheduler, 3, 2);
+   GivenSchedulerHasRunAt(UINT16_MAX - 1);
+   WhenTimeIs(1);
+   ThenLightShouldBeOn(1);
+   ThenLightShouldBeOn(2);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldCatchUpSchedulesSharingBucketOverLongGap)
+{
+   GivenCallsMustHappenInOrder();
+   WhenLightSchedulerIsInitialized();
+   GivenCatchUpIsEnabled();
+   WhenLightScheduledOnAt(&scheduler, 1, 10 + (3 * LIGHTSCHEDULER_WHEEL_SLOTS));
+   WhenLightScheduledOnAt(&scheduler, 2, 10 + LIGHTSCHEDULER_WHEEL_SLOTS);
+   GivenSchedulerHasRunAt(0);
+   WhenTimeIs(10 + (4 * LIGHTSCHEDULER_WHEEL_SLOTS));
+   ThenLightShouldBeOn(2);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldNotRunScheduleAgainAfterTickRollover)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNothingShouldBeDue();
+   GivenSchedulerHasRunAt(40000);
+   GivenSchedulerHasRunAt(10);
+}
+
+TEST(LightScheduler, ShouldRunScheduleAddedBeforeFirstRunWhenTickCountNextReachesIt)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   GivenSchedulerHasRunAt(50000);
+   ThenNextDueTimeShouldBe(65546);
+   GivenSchedulerHasRunAt(65535);
+   WhenTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, ShouldRunScheduleAddedBeforeFirstRunAtTheTickOfTheFirstRun)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 50000);
+   WhenTimeIs(50000);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldRunScheduleAddedBeforeFirstRunWithWideTimeSource)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenEventScheduledAtWideTime(2, true, 10);
+   GivenSchedulerHasRunAtWideTime(0x30005);
+   ThenNextDueTimeShouldBe(0x3000A);
+   WhenWideTimeIs(0x3000A);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldRemoveScheduleAddedBeforeFirstRunByTickCount)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   AfterRemoveScheduleAt(&scheduler, 1, true, 10);
+   GivenSchedulerHasRunAt(50000);
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, RecurringPeriodChecks)
+{
+   WhenLightSchedulerIsInitialized();
+   CHECK_ASSERTION_FAILED(WhenRecurringEventScheduled(1, true, 10, UINT64_MAX));
+}
+
+TEST(LightScheduler, ShouldFreeSlotsOfSchedulesThatHaveRun)
+{
+   WhenLightSchedulerIsInitialized();
+   AfterScheduleMaximumSchedulesOnAt(&scheduler, 10);
+   WhenTimeIs(10);
+   ThenLights1to10ShouldBeOn(&scheduler);
+   WhenSchedulerIsRun(&scheduler);
+   AfterScheduleMaximumSchedulesOnAt(&scheduler, 20);
+   WhenTimeIs(20);
+   ThenLights1to10ShouldBeOn(&scheduler);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldFreeSlotOfScheduleThatWasMissed)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   GivenSchedulerHasRunAt(9);
+   GivenSchedulerHasRunAt(11);
+   ThenNothingShouldBeDue();
+   GivenSchedulerHasRunAt(40000);
+   GivenSchedulerHasRunAt(10);
+}
+
+TEST(LightScheduler, ShouldRunScheduleAtWideTimeFromWideTimeSource)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenEventScheduledAtWideTime(1, true, 0x123456789ULL + LIGHTSCHEDULER_TICK_ROLLOVER_PERIOD);
+   WhenWideTimeIs(0x123456789ULL);
+   NothingShouldHappen();
+   WhenSchedulerIsRun(&scheduler);
+   WhenWideTimeIs(0x123456789ULL + LIGHTSCHEDULER_TICK_ROLLOVER_PERIOD);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldRunScheduleAtWideTimeOnlyOnce)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenEventScheduledAtWideTime(1, true, 100000);
+   GivenSchedulerHasRunAtWideTime(99999);
+   WhenWideTimeIs(100000);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   WhenWideTimeIs(100000 + LIGHTSCHEDULER_TICK_ROLLOVER_PERIOD);
+   NothingShouldHappen();
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldExtendTickCountForWideSchedules)
+{
+   GivenCallsMustHappenInOrder();
+   WhenLightSchedulerIsInitialized();
+   GivenCatchUpIsEnabled();
+   WhenEventScheduledAtWideTime(1, true, (3 * LIGHTSCHEDULER_TICK_ROLLOVER_PERIOD) + 5);
+   GivenSchedulerHasRunAt(0);
+   GivenSchedulerHasRunAt(40000);
+   GivenSchedulerHasRunAt(10000);
+   GivenSchedulerHasRunAt(50000);
+   GivenSchedulerHasRunAt(20000);
+   GivenSchedulerHasRunAt(60000);
+   WhenTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldCatchUpScheduleAddedForProcessedTick)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenCatchUpIsEnabled();
+   GivenSchedulerHasRunAtWideTime(1000);
+   WhenEventScheduledAtWideTime(1, true, 10);
+   WhenWideTimeIs(1005);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldCatchUpAcrossMoreThanOneTurnOfTheWheel)
+{
+   GivenCallsMustHappenInOrder();
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenCatchUpIsEnabled();
+   WhenEventScheduledAtWideTime(1, true, 1000000);
+   WhenEventScheduledAtWideTime(2, true, 10 + (5 * LIGHTSCHEDULER_WHEEL_SLOTS));
+   WhenEventScheduledAtWideTime(3, true, 10 + (5 * LIGHTSCHEDULER_WHEEL_SLOTS));
+   WhenEventScheduledAtWideTime(4, false, 3);
+   GivenSchedulerHasRunAtWideTime(0);
+   WhenWideTimeIs(999999);
+   ThenLightShouldBeOff(4);
+   ThenLightShouldBeOn(2);
+   ThenLightShouldBeOn(3);
+   WhenSchedulerIsRun(&scheduler);
+   WhenWideTimeIs(2000000);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldDoNothingAfterRemoveScheduleAtWideTime)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenEventScheduledAtWideTime(1, true, 100000);
+   WhenEventScheduledAtWideTime(1, true, 100000 + LIGHTSCHEDULER_TICK_ROLLOVER_PERIOD);
+   AfterRemoveScheduleAtWideTime(1, true, 100000);
+   WhenWideTimeIs(100000);
+   NothingShouldHappen();
+   WhenSchedulerIsRun(&scheduler);
+   CHECK_ASSERTION_FAILED(AfterRemoveScheduleAtWideTime(1, true, 100000));
+}
+
+TEST(LightScheduler, ShouldWriteDueLightsTogether)
+{
+   GivenCallsMustHappenInOrder();
+   GivenLightsCanBeWrittenTogether();
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenLightScheduledOffAt(&scheduler, 2, 10);
+   WhenLightScheduledOnAt(&scheduler, 3, 11);
+   WhenTimeIs(10);
+   ThenLightsShouldBeWrittenTogether(2);
+   ThenLightShouldBeWrittenInBatch(1, true);
+   ThenLightShouldBeWrittenInBatch(2, false);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldNotWriteTogetherWhenNothingIsDue)
+{
+   GivenLightsCanBeWrittenTogether();
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenTimeIs(9);
+   NothingShouldHappen();
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldWriteCaughtUpLightsTogetherInOrder)
+{
+   GivenCallsMustHappenInOrder();
+   GivenLightsCanBeWrittenTogether();
+   WhenLightSchedulerIsInitialized();
+   GivenCatchUpIsEnabled();
+   WhenLightScheduledOffAt(&scheduler, 1, 12);
+   WhenLightScheduledOnAt(&scheduler, 1, 11);
+   GivenSchedulerHasRunAt(10);
+   WhenTimeIs(12);
+   ThenLightsShouldBeWrittenTogether(2);
+   ThenLightShouldBeWrittenInBatch(1, true);
+   ThenLightShouldBeWrittenInBatch(1, false);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldSplitWritesIntoBatches)
+{
+   DigitalOutputChannel_t i;
+   GivenCallsMustHappenInOrder();
+   GivenLightsCanBeWrittenTogether();
+   WhenLightSchedulerIsInitializedWithStorage(LIGHTSCHEDULER_WRITE_BATCH_SIZE + 1);
+   for(i = 0; i <= LIGHTSCHEDULER_WRITE_BATCH_SIZE; i++)
+   {
+      WhenLightScheduledOnAt(&scheduler, i, 10);
+   }
+   WhenTimeIs(10);
+   ThenLightsShouldBeWrittenTogether(LIGHTSCHEDULER_WRITE_BATCH_SIZE);
+   for(i = 0; i < LIGHTSCHEDULER_WRITE_BATCH_SIZE; i++)
+   {
+      ThenLightShouldBeWrittenInBatch(i, true);
+   }
+   ThenLightsShouldBeWrittenTogether(1);
+   ThenLightShouldBeWrittenInBatch(LIGHTSCHEDULER_WRITE_BATCH_SIZE, true);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, CheckNullWriteSuppressionFails)
+{
+   WhenLightSchedulerIsInitialized();
+   CHECK_ASSERTION_FAILED(LightScheduler_EnableWriteSuppression(NULL, shadow, ShadowChannels));
+   CHECK_ASSERTION_FAILED(LightScheduler_EnableWriteSuppression(&scheduler, NULL, ShadowChannels));
+   CHECK_ASSERTION_FAILED(LightScheduler_ResetWriteSuppression(NULL));
+   CHECK_ASSERTION_FAILED(LightScheduler_GetElidedWriteCount(NULL));
+}
+
+TEST(LightScheduler, ShouldWriteSameStateAgainWithoutSuppression)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenLightScheduledOnAt(&scheduler, 1, 11);
+   WhenTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   WhenTimeIs(11);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   ThenElidedWriteCountShouldBe(0);
+}
+
+TEST(LightScheduler, ShouldSkipWriteOfStateAlreadyWritten)
+{
+   WhenLightSchedulerIsInitialized();
+   GivenRedundantWritesAreSuppressed();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenLightScheduledOnAt(&scheduler, 1, 11);
+   WhenLightScheduledOffAt(&scheduler, 1, 12);
+   WhenTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   WhenTimeIs(11);
+   NothingShouldHappen();
+   WhenSchedulerIsRun(&scheduler);
+   WhenTimeIs(12);
+   ThenLightShouldBeOff(1);
+   WhenSchedulerIsRun(&scheduler);
+   ThenElidedWriteCountShouldBe(1);
+}
+
+TEST(LightScheduler, ShouldSkipRedundantWritesWithinOneRun)
+{
+   WhenLightSchedulerIsInitialized();
+   GivenRedundantWritesAreSuppressed();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenLightScheduledOnAt(&scheduler, 2, 10);
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenTimeIs(10);
+   ThenLightShouldBeOn(1);
+   ThenLightShouldBeOn(2);
+   WhenSchedulerIsRun(&scheduler);
+   ThenElidedWriteCountShouldBe(1);
+}
+
+TEST(LightScheduler, ShouldAlwaysWriteChannelsThatAreNotTracked)
+{
+   WhenLightSchedulerIsInitialized();
+   GivenRedundantWritesAreSuppressed();
+   WhenLightScheduledOnAt(&scheduler, ShadowChannels, 10);
+   WhenLightScheduledOnAt(&scheduler, ShadowChannels, 11);
+   WhenTimeIs(10);
+   ThenLightShouldBeOn(ShadowChannels);
+   WhenSchedulerIsRun(&scheduler);
+   WhenTimeIs(11);
+   ThenLightShouldBeOn(ShadowChannels);
+   WhenSchedulerIsRun(&scheduler);
+   ThenElidedWriteCountShouldBe(0);
+}
+
+TEST(LightScheduler, ShouldWriteAgainAfterSuppressionIsReset)
+{
+   WhenLightSchedulerIsInitialized();
+   GivenRedundantWritesAreSuppressed();
+   WhenLightScheduledOnAt(&scheduler, 33, 10);
+   WhenLightScheduledOnAt(&scheduler, 33, 11);
+   WhenTimeIs(10);
+   ThenLightShouldBeOn(33);
+   WhenSchedulerIsRun(&scheduler);
+   LightScheduler_ResetWriteSuppression(&scheduler);
+   WhenTimeIs(11);
+   ThenLightShouldBeOn(33);
+   WhenSchedulerIsRun(&scheduler);
+   ThenElidedWriteCountShouldBe(0);
+}
+
+TEST(LightScheduler, ShouldSkipRedundantWritesInBatches)
+{
+   GivenLightsCanBeWrittenTogether();
+   WhenLightSchedulerIsInitialized();
+   GivenRedundantWritesAreSuppressed();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenTimeIs(10);
+   ThenLightsShouldBeWrittenTogether(1);
+   ThenLightShouldBeWrittenInBatch(1, true);
+   WhenSchedulerIsRun(&scheduler);
+   ThenElidedWriteCountShouldBe(1);
+}
+
+TEST(LightScheduler, RecurringScheduleChecks)
+{
+   WhenLightSchedulerIsInitialized();
+   CHECK_ASSERTION_FAILED(LightScheduler_AddRecurringSchedule(NULL, 1, true, 10, 5));
+   CHECK_ASSERTION_FAILED(WhenRecurringEventScheduled(1, true, 10, 0));
+   CHECK_ASSERTION_FAILED(LightScheduler_RemoveRecurringSchedule(NULL, 1, true, 10, 5));
+   CHECK_ASSERTION_FAILED(AfterRemoveRecurringSchedule(1, true, 10, 0));
+   CHECK_ASSERTION_FAILED(AfterRemoveRecurringSchedule(1, true, 10, 5));
+}
+
+TEST(LightScheduler, ShouldRunRecurringScheduleEveryPeriod)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenRecurringEventScheduled(1, true, 100, 1000);
+   WhenWideTimeIs(100);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   GivenSchedulerHasRunAtWideTime(1099);
+   WhenWideTimeIs(1100);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   WhenWideTimeIs(2100);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldRunDailyScheduleAgainTheNextDay)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenRecurringEventScheduled(1, true, 0, LIGHTSCHEDULER_DAILY_PERIOD(1000));
+   WhenWideTimeIs(0);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   GivenSchedulerHasRunAtWideTime(LIGHTSCHEDULER_DAILY_PERIOD(1000) - 1);
+   WhenWideTimeIs(LIGHTSCHEDULER_DAILY_PERIOD(1000));
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   CHECK(LIGHTSCHEDULER_WEEKLY_PERIOD(1000) == 7 * LIGHTSCHEDULER_DAILY_PERIOD(1000));
+}
+
+TEST(LightScheduler, ShouldSkipMissedOccurrencesOfRecurringScheduleWithoutCatchUp)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenRecurringEventScheduled(1, true, 100, 10);
+   GivenSchedulerHasRunAtWideTime(99);
+   WhenWideTimeIs(135);
+   NothingShouldHappen();
+   WhenSchedulerIsRun(&scheduler);
+   WhenWideTimeIs(140);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldRunEveryMissedOccurrenceOfRecurringScheduleWithCatchUp)
+{
+   GivenCallsMustHappenInOrder();
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenCatchUpIsEnabled();
+   WhenRecurringEventScheduled(1, true, 100, 10);
+   WhenRecurringEventScheduled(1, false, 105, 10);
+   GivenSchedulerHasRunAtWideTime(99);
+   WhenWideTimeIs(120);
+   ThenLightShouldBeOn(1);
+   ThenLightShouldBeOff(1);
+   ThenLightShouldBeOn(1);
+   ThenLightShouldBeOff(1);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldStartRecurringScheduleAtNextUnprocessedOccurrence)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenCatchUpIsEnabled();
+   GivenSchedulerHasRunAtWideTime(125);
+   WhenRecurringEventScheduled(1, true, 100, 10);
+   WhenWideTimeIs(129);
+   NothingShouldHappen();
+   WhenSchedulerIsRun(&scheduler);
+   WhenWideTimeIs(130);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldKeepOneSlotForRecurringSchedule)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitializedWithStorage(1);
+   WhenRecurringEventScheduled(1, true, 10, 10);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   UNSIGNED_LONGS_EQUAL(1, scheduler.numSchedules);
+   WhenEventScheduledAtWideTime(2, true, 20);
+   WhenWideTimeIs(20);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldDoNothingAfterRemoveRecurringSchedule)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenRecurringEventScheduled(1, true, 10, 7);
+   WhenRecurringEventScheduled(1, true, 11, 7);
+   GivenSchedulerHasRunAtWideTime(9);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   AfterRemoveRecurringSchedule(1, true, 10, 7);
+   WhenWideTimeIs(11);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   WhenWideTimeIs(17);
+   NothingShouldHappen();
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, NextDueTimeChecks)
+{
+   TimeSourceWideTickCount_t nextDueTime;
+   WhenLightSchedulerIsInitialized();
+   CHECK_ASSERTION_FAILED(LightScheduler_GetNextDueTime(NULL, &nextDueTime));
+   CHECK_ASSERTION_FAILED(LightScheduler_GetNextDueTime(&scheduler, NULL));
+}
+
+TEST(LightScheduler, ShouldHaveNothingDueWhenEmpty)
+{
+   WhenLightSchedulerIsInitialized();
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, ShouldReportEarliestScheduleAsNextDue)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenEventScheduledAtWideTime(1, true, 300);
+   ThenNextDueTimeShouldBe(300);
+   WhenEventScheduledAtWideTime(2, true, 200 + LIGHTSCHEDULER_TICK_ROLLOVER_PERIOD);
+   ThenNextDueTimeShouldBe(300);
+   WhenEventScheduledAtWideTime(3, true, 100);
+   ThenNextDueTimeShouldBe(100);
+}
+
+TEST(LightScheduler, ShouldAdvanceNextDueAfterRun)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenEventScheduledAtWideTime(1, true, 100);
+   WhenEventScheduledAtWideTime(2, true, 100 + (3 * LIGHTSCHEDULER_WHEEL_SLOTS));
+   WhenEventScheduledAtWideTime(3, true, 5000000);
+   WhenWideTimeIs(100);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNextDueTimeShouldBe(100 + (3 * LIGHTSCHEDULER_WHEEL_SLOTS));
+   WhenWideTimeIs(100 + (3 * LIGHTSCHEDULER_WHEEL_SLOTS));
+   ThenLightShouldBeOn(2);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNextDueTimeShouldBe(5000000);
+   WhenWideTimeIs(5000000);
+   ThenLightShouldBeOn(3);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, ShouldReportNextOccurrenceOfRecurringScheduleAsNextDue)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenRecurringEventScheduled(1, true, 10, 25);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNextDueTimeShouldBe(35);
+}
+
+TEST(LightScheduler, ShouldUpdateNextDueAfterRemove)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenEventScheduledAtWideTime(1, true, 100);
+   WhenEventScheduledAtWideTime(2, true, 100);
+   WhenEventScheduledAtWideTime(3, true, 70000);
+   AfterRemoveScheduleAtWideTime(1, true, 100);
+   ThenNextDueTimeShouldBe(100);
+   AfterRemoveScheduleAtWideTime(2, true, 100);
+   ThenNextDueTimeShouldBe(70000);
+   AfterRemoveScheduleAtWideTime(3, true, 70000);
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, ShouldNotAdvanceNextDueOnIdleRun)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenEventScheduledAtWideTime(1, true, 100);
+   GivenSchedulerHasRunAtWideTime(50);
+   ThenNextDueTimeShouldBe(100);
+}
+
+TEST(LightScheduler, CheckNullSchedulerRemoveByHandleFails)
+{
+   ScheduleHandle_t handle = { 0, 0 };
+   CHECK_ASSERTION_FAILED(LightScheduler_RemoveScheduleByHandle(NULL, handle));
+}
+
+TEST(LightScheduler, ShouldDoNothingAfterRemoveScheduleByHandle)
+{
+   WhenLightSchedulerIsInitialized();
+   ScheduleHandle_t handle = LightScheduler_AddSchedule(&scheduler, 1, true, 9);
+   ThenRemoveByHandleShouldSucceed(handle);
+   WhenTimeIs(9);
+   NothingShouldHappen();
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldRemoveOnlyTheHandledOneOfDuplicateSchedules)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   LightScheduler_AddScheduleAt(&scheduler, 1, true, 9);
+   ScheduleHandle_t handle = LightScheduler_AddScheduleAt(&scheduler, 1, true, 9);
+   ThenRemoveByHandleShouldSucceed(handle);
+   WhenWideTimeIs(9);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldIgnoreHandleOfRemovedSchedule)
+{
+   WhenLightSchedulerIsInitialized();
+   ScheduleHandle_t handle = LightScheduler_AddSchedule(&scheduler, 1, true, 9);
+   ThenRemoveByHandleShouldSucceed(handle);
+   ThenRemoveByHandleShouldBeIgnored(handle);
+}
+
+TEST(LightScheduler, ShouldIgnoreStaleHandleWhenSlotIsReused)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitializedWithStorage(1);
+   ScheduleHandle_t stale = LightScheduler_AddScheduleAt(&scheduler, 1, true, 9);
+   WhenWideTimeIs(9);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+
+   ScheduleHandle_t handle = LightScheduler_AddScheduleAt(&scheduler, 2, true, 12);
+   UNSIGNED_LONGS_EQUAL(stale.index, handle.index);
+   ThenRemoveByHandleShouldBeIgnored(stale);
+   WhenWideTimeIs(12);
+   ThenLightShouldBeOn(2);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldRemoveRecurringScheduleByHandle)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   ScheduleHandle_t handle = LightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 25);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   ThenRemoveByHandleShouldSucceed(handle);
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, ShouldReturnInvalidHandleWhenFull)
+{
+   WhenLightSchedulerIsInitialized();
+   AfterScheduleMaximumSchedulesOnAt(&scheduler, 10);
+   ScheduleHandle_t handle = LightScheduler_AddSchedule(&scheduler, 11, true, 10);
+   CHECK_FALSE(ScheduleHandle_IsValid(handle));
+   ThenRemoveByHandleShouldBeIgnored(handle);
+}
+
+TEST(LightScheduler, CommandQueueChecks)
+{
+   ScheduleHandle_t handle = { 0, 0 };
+   WhenLightSchedulerIsInitialized();
+   CHECK_ASSERTION_FAILED(LightScheduler_EnableCommandQueue(NULL, commands, QueueSize));
+   CHECK_ASSERTION_FAILED(LightScheduler_EnableCommandQueue(&scheduler, NULL, QueueSize));
+   CHECK_ASSERTION_FAILED(LightScheduler_EnableCommandQueue(&scheduler, commands, 0));
+   CHECK_ASSERTION_FAILED(LightScheduler_EnableCommandQueue(&scheduler, commands, 3));
+   CHECK_ASSERTION_FAILED(LightScheduler_QueueScheduleAt(&scheduler, 1, true, 10));
+   CHECK_ASSERTION_FAILED(LightScheduler_QueueRemoveScheduleByHandle(&scheduler, handle));
+   GivenCommandQueueIsEnabled();
+   CHECK_ASSERTION_FAILED(LightScheduler_QueueRecurringSchedule(&scheduler, 1, true, 10, 0));
+   CHECK_ASSERTION_FAILED(LightScheduler_QueueRemoveRecurringSchedule(&scheduler, 1, true, 10, 0));
+}
+
+TEST(LightScheduler, ShouldNotApplyQueuedScheduleBeforeRun)
+{
+   WhenLightSchedulerIsInitialized();
+   GivenCommandQueueIsEnabled();
+   WhenEventIsQueuedAt(1, true, 10);
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, ShouldRunQueuedScheduleAfterItIsDrained)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenCommandQueueIsEnabled();
+   WhenEventIsQueuedAt(1, true, 10);
+   GivenSchedulerHasRunAtWideTime(5);
+   ThenNextDueTimeShouldBe(10);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldRunQueuedScheduleDueOnTheDrainingRun)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenCommandQueueIsEnabled();
+   WhenEventIsQueuedAt(1, true, 10);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldApplyQueuedChangesInOrder)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenCommandQueueIsEnabled();
+   WhenEventIsQueuedAt(1, true, 10);
+   WhenEventIsQueuedAt(2, true, 10);
+   CHECK_TRUE(LightScheduler_QueueRemoveScheduleAt(&scheduler, 1, true, 10));
+   CHECK_TRUE(LightScheduler_QueueRecurringSchedule(&scheduler, 3, false, 10, 20));
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(2);
+   ThenLightShouldBeOff(3);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNextDueTimeShouldBe(30);
+}
+
+TEST(LightScheduler, ShouldRejectCommandsWhenQueueIsFull)
+{
+   uint8_t i;
+   WhenLightSchedulerIsInitialized();
+   GivenCommandQueueIsEnabled();
+   for(i = 0; i < QueueSize; i++)
+   {
+      WhenEventIsQueuedAt(i, true, 10);
+   }
+   CHECK_FALSE(LightScheduler_QueueScheduleAt(&scheduler, QueueSize, true, 10));
+}
+
+TEST(LightScheduler, ShouldAcceptCommandsAgainAfterQueueIsDrained)
+{
+   uint8_t i;
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenCommandQueueIsEnabled();
+   for(i = 0; i < QueueSize; i++)
+   {
+      WhenEventIsQueuedAt(i, true, 100);
+   }
+   GivenSchedulerHasRunAtWideTime(5);
+   for(i = 0; i < QueueSize; i++)
+   {
+      WhenEventIsQueuedAt(i + QueueSize, true, 100);
+   }
+   GivenSchedulerHasRunAtWideTime(6);
+   UNSIGNED_LONGS_EQUAL(2 * QueueSize, scheduler.numSchedules);
+}
+
+TEST(LightScheduler, ShouldIgnoreQueuedRemovalsOfMissingSchedules)
+{
+   ScheduleHandle_t handle;
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenCommandQueueIsEnabled();
+   handle = LightScheduler_AddScheduleAt(&scheduler, 1, true, 10);
+   LightScheduler_RemoveScheduleByHandle(&scheduler, handle);
+   CHECK_TRUE(LightScheduler_QueueRemoveScheduleAt(&scheduler, 2, true, 10));
+   CHECK_TRUE(LightScheduler_QueueRemoveRecurringSchedule(&scheduler, 2, true, 10, 20));
+   CHECK_TRUE(LightScheduler_QueueRemoveScheduleByHandle(&scheduler, handle));
+   GivenSchedulerHasRunAtWideTime(5);
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, ShouldRemoveScheduleByQueuedHandle)
+{
+   ScheduleHandle_t handle;
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenCommandQueueIsEnabled();
+   handle = LightScheduler_AddScheduleAt(&scheduler, 1, true, 10);
+   CHECK_TRUE(LightScheduler_QueueRemoveScheduleByHandle(&scheduler, handle));
+   GivenSchedulerHasRunAtWideTime(5);
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, ConstantTableChecks)
+{
+   static const LightScheduleEntry_t lateEntries[] = { LIGHTSCHEDULER_ENTRY(100, 1, true) };
+   static const LightScheduleTable_t entryOutsidePeriod = LIGHTSCHEDULER_TABLE(lateEntries, 100);
+   static const LightScheduleTable_t missingEntries = { NULL, 1, 0 };
+   WhenLightSchedulerIsInitialized();
+   CHECK_ASSERTION_FAILED(LightScheduler_SetConstantTable(NULL, &dailyTable));
+   CHECK_ASSERTION_FAILED(LightScheduler_SetConstantTable(&scheduler, &entryOutsidePeriod));
+   CHECK_ASSERTION_FAILED(LightScheduler_SetConstantTable(&scheduler, &missingEntries));
+}
+
+TEST(LightScheduler, ShouldRunConstantTableEntries)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenConstantTable(&dailyTable);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   WhenWideTimeIs(20);
+   ThenLightShouldBeOn(2);
+   ThenLightShouldBeOn(3);
+   WhenSchedulerIsRun(&scheduler);
+   WhenWideTimeIs(40);
+   ThenLightShouldBeOff(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldRepeatConstantTableEveryPeriod)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenConstantTable(&dailyTable);
+   GivenSchedulerHasRunAtWideTime(50);
+   ThenNextDueTimeShouldBe(110);
+   WhenWideTimeIs(110);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNextDueTimeShouldBe(120);
+}
+
+TEST(LightScheduler, ShouldRunConstantTableOnceWithoutPeriod)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenConstantTable(&onceTable);
+   WhenWideTimeIs(40);
+   ThenLightShouldBeOff(1);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, ShouldSkipMissedConstantTableEntriesWithoutCatchUp)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenConstantTable(&dailyTable);
+   GivenSchedulerHasRunAtWideTime(5);
+   WhenWideTimeIs(320);
+   ThenLightShouldBeOn(2);
+   ThenLightShouldBeOn(3);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNextDueTimeShouldBe(340);
+}
+
+TEST(LightScheduler, ShouldCatchUpConstantTableEntriesInOrder)
+{
+   GivenCallsMustHappenInOrder();
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenConstantTable(&dailyTable);
+   GivenCatchUpIsEnabled();
+   GivenSchedulerHasRunAtWideTime(30);
+   WhenWideTimeIs(120);
+   ThenLightShouldBeOff(1);
+   ThenLightShouldBeOn(1);
+   ThenLightShouldBeOn(2);
+   ThenLightShouldBeOn(3);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldWriteConstantTableEntriesBeforeAddedSchedules)
+{
+   GivenCallsMustHappenInOrder();
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenConstantTable(&dailyTable);
+   WhenEventScheduledAtWideTime(1, false, 10);
+   WhenEventScheduledAtWideTime(4, true, 5);
+   WhenWideTimeIs(5);
+   ThenLightShouldBeOn(4);
+   WhenSchedulerIsRun(&scheduler);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(1);
+   ThenLightShouldBeOff(1);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldSkipConstantTableEntriesAlreadyProcessed)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenSchedulerHasRunAtWideTime(20);
+   GivenConstantTable(&dailyTable);
+   ThenNextDueTimeShouldBe(40);
+}
+
+TEST(LightScheduler, ShouldStopRunningConstantTable)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenConstantTable(&dailyTable);
+   GivenConstantTable(NULL);
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, AddSchedulesChecks)
+{
+   WhenLightSchedulerIsInitialized();
+   CHECK_ASSERTION_FAILED(LightScheduler_AddSchedules(NULL, dailyEntries, 4, NULL));
+   CHECK_ASSERTION_FAILED(LightScheduler_AddSchedules(&scheduler, NULL, 4, NULL));
+   CHECK_TRUE(LightScheduler_AddSchedules(&scheduler, NULL, 0, NULL));
+}
+
+TEST(LightScheduler, ShouldRunSchedulesAddedInBulk)
+{
+   GivenCallsMustHappenInOrder();
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   CHECK_TRUE(LightScheduler_AddSchedules(&scheduler, dailyEntries, 4, NULL));
+   ThenNextDueTimeShouldBe(10);
+   WhenWideTimeIs(20);
+   ThenLightShouldBeOn(2);
+   ThenLightShouldBeOn(3);
+   WhenSchedulerIsRun(&scheduler);
+}
+
+TEST(LightScheduler, ShouldReturnHandlesOfSchedulesAddedInBulk)
+{
+   ScheduleHandle_t handles[4];
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   CHECK_TRUE(LightScheduler_AddSchedules(&scheduler, dailyEntries, 4, handles));
+   ThenRemoveByHandleShouldSucceed(handles[0]);
+   ThenNextDueTimeShouldBe(20);
+   ThenRemoveByHandleShouldSucceed(handles[1]);
+   ThenRemoveByHandleShouldSucceed(handles[2]);
+   ThenRemoveByHandleShouldSucceed(handles[3]);
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, ShouldAddNothingWhenBulkAddDoesNotFit)
+{
+   WhenLightSchedulerIsInitializedWithStorage(3);
+   CHECK_FALSE(LightScheduler_AddSchedules(&scheduler, dailyEntries, 4, NULL));
+   ThenNothingShouldBeDue();
+   CHECK_TRUE(LightScheduler_AddSchedules(&scheduler, dailyEntries, 3, NULL));
+   CHECK_FALSE(LightScheduler_AddSchedules(&scheduler, dailyEntries, 1, NULL));
+}
+
+TEST(LightScheduler, ShouldMoveBulkSchedulesForProcessedTicksToNextTick)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenSchedulerHasRunAtWideTime(15);
+   CHECK_TRUE(LightScheduler_AddSchedules(&scheduler, dailyEntries, 1, NULL));
+   ThenNextDueTimeShouldBe(16);
+}
+
+TEST(LightScheduler, ShouldRebuildIndexFromStorage)
+{
+   GivenCallsMustHappenInOrder();
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   ScheduleHandle_t removed = LightScheduler_AddScheduleAt(&scheduler, 1, true, 10);
+   ScheduleHandle_t kept = LightScheduler_AddScheduleAt(&scheduler, 2, true, 20);
+   scheduler.schedules.active[removed.index / 32] &= ~(1UL << (removed.index % 32));
+   LightScheduler_RebuildIndex(&scheduler);
+   UNSIGNED_LONGS_EQUAL(1, scheduler.numSchedules);
+   ThenNextDueTimeShouldBe(20);
+   CHECK_TRUE(ScheduleHandle_IsValid(LightScheduler_AddScheduleAt(&scheduler, 3, true, 30)));
+   WhenWideTimeIs(20);
+   ThenLightShouldBeOn(2);
+   WhenSchedulerIsRun(&scheduler);
+   WhenWideTimeIs(30);
+   ThenLightShouldBeOn(3);
+   WhenSchedulerIsRun(&scheduler);
+   ThenRemoveByHandleShouldBeIgnored(kept);
+}
+
+TEST(LightScheduler, ShouldMoveRebuiltSchedulesForProcessedTicksPastThem)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   ScheduleHandle_t once = LightScheduler_AddScheduleAt(&scheduler, 1, true, 100);
+   ScheduleHandle_t recurring = LightScheduler_AddRecurringSchedule(&scheduler, 2, true, 100, 100);
+   GivenSchedulerHasRunAtWideTime(50);
+   scheduler.schedules.time[once.index] = 10;
+   scheduler.schedules.time[recurring.index] = 10;
+   LightScheduler_RebuildIndex(&scheduler);
+   ThenNextDueTimeShouldBe(51);
+   UNSIGNED_LONGS_EQUAL(110, scheduler.schedules.time[recurring.index]);
+}
+
+TEST(LightScheduler, ShouldKeepActiveSchedulesDense)
+{
+   ScheduleHandle_t handles[5];
+   uint32_t i;
+   WhenLightSchedulerIsInitialized();
+   for(i = 0; i < 5; i++)
+   {
+      handles[i] = LightScheduler_AddRecurringSchedule(&scheduler, (DigitalOutputChannel_t)i, true, 10 + i, 100);
+   }
+   ThenRemoveByHandleShouldSucceed(handles[0]);
+   ThenRemoveByHandleShouldSucceed(handles[3]);
+   UNSIGNED_LONGS_EQUAL(3, scheduler.numSchedules);
+   for(i = 0; i < scheduler.numSchedules; i++)
+   {
+      ScheduleIndex_t index = scheduler.schedules.live[i];
+      CHECK_TRUE((index == handles[1].index) || (index == handles[2].index) || (index == handles[4].index));
+      UNSIGNED_LONGS_EQUAL(i, scheduler.schedules.livePosition[index]);
+   }
+
+   AfterRemoveRecurringSchedule(4, true, 14, 100);
+   AfterRemoveRecurringSchedule(1, true, 11, 100);
+   UNSIGNED_LONGS_EQUAL(1, scheduler.numSchedules);
+   UNSIGNED_LONGS_EQUAL(handles[2].index, scheduler.schedules.live[0]);
+}
+
+TEST(LightScheduler, LightIndexChecks)
+{
+   TimeSourceWideTickCount_t time;
+   bool state;
+   WhenLightSchedulerIsInitialized();
+   CHECK_ASSERTION_FAILED(LightScheduler_EnableLightIndex(NULL, lightIndex, ShadowChannels));
+   CHECK_ASSERTION_FAILED(LightScheduler_EnableLightIndex(&scheduler, NULL, ShadowChannels));
+   CHECK_ASSERTION_FAILED(LightScheduler_RemoveAllForLight(NULL, 1));
+   CHECK_ASSERTION_FAILED(LightScheduler_GetNextForLight(NULL, 1, &time, &state));
+   CHECK_ASSERTION_FAILED(LightScheduler_GetNextForLight(&scheduler, 1, NULL, &state));
+   CHECK_ASSERTION_FAILED(LightScheduler_GetNextForLight(&scheduler, 1, &time, NULL));
+}
+
+TEST(LightScheduler, ShouldRemoveAllSchedulesOfAnIndexedLight)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenLightsAreIndexed();
+   WhenEventScheduledAtWideTime(1, true, 10);
+   WhenEventScheduledAtWideTime(2, true, 10);
+   WhenEventScheduledAtWideTime(1, false, 20);
+   WhenRecurringEventScheduled(1, true, 15, 100);
+   ThenRemoveAllForLightShouldRemove(1, 3);
+   ThenRemoveAllForLightShouldRemove(1, 0);
+   ThenNextDueTimeShouldBe(10);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(2);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNothingShouldBeDue();
+}
+
+TEST(LightScheduler, ShouldRemoveAllSchedulesOfALightWithoutAnIndex)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenEventScheduledAtWideTime(1, true, 10);
+   WhenEventScheduledAtWideTime(2, true, 20);
+   WhenEventScheduledAtWideTime(1, false, 30);
+   ThenRemoveAllForLightShouldRemove(1, 2);
+   ThenNextDueTimeShouldBe(20);
+   ThenNothingShouldBeNextForLight(1);
+   ThenNextForLightShouldBe(2, 20, true);
+}
+
+TEST(LightScheduler, ShouldRemoveAllSchedulesOfALightThatIsNotIndexed)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenLightsAreIndexed();
+   WhenEventScheduledAtWideTime(ShadowChannels, true, 10);
+   WhenEventScheduledAtWideTime(1, true, 20);
+   WhenEventScheduledAtWideTime(ShadowChannels, false, 30);
+   ThenNextForLightShouldBe(ShadowChannels, 10, true);
+   ThenRemoveAllForLightShouldRemove(ShadowChannels, 2);
+   ThenNextForLightShouldBe(1, 20, true);
+}
+
+TEST(LightScheduler, ShouldGetNextTransitionOfALight)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenLightsAreIndexed();
+   WhenEventScheduledAtWideTime(1, true, 30);
+   WhenEventScheduledAtWideTime(1, false, 20);
+   WhenRecurringEventScheduled(1, true, 25, 100);
+   WhenEventScheduledAtWideTime(2, true, 10);
+   ThenNextForLightShouldBe(1, 20, false);
+   ThenNothingShouldBeNextForLight(3);
+
+   WhenWideTimeIs(20);
+   ThenLightShouldBeOff(1);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNextForLightShouldBe(1, 25, true);
+
+   WhenWideTimeIs(25);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNextForLightShouldBe(1, 30, true);
+}
+
+TEST(LightScheduler, ShouldKeepLightIndexAsSchedulesAreRunAndRemoved)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenLightsAreIndexed();
+   ScheduleHandle_t removed = LightScheduler_AddScheduleAt(&scheduler, 1, true, 20);
+   WhenEventScheduledAtWideTime(1, true, 10);
+   WhenEventScheduledAtWideTime(1, false, 30);
+   ThenRemoveByHandleShouldSucceed(removed);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(1);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNextForLightShouldBe(1, 30, false);
+   WhenEventScheduledAtWideTime(1, true, 40);
+   ThenRemoveAllForLightShouldRemove(1, 2);
+   ThenNothingShouldBeNextForLight(1);
+}
+
+TEST(LightScheduler, ShouldIndexSchedulesAddedBeforeIndexIsEnabled)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenEventScheduledAtWideTime(1, true, 10);
+   WhenEventScheduledAtWideTime(2, true, 10);
+   WhenEventScheduledAtWideTime(1, false, 20);
+   GivenLightsAreIndexed();
+   UNSIGNED_LONGS_EQUAL(2, LightScheduler_RemoveAllForLight(&scheduler, 1));
+   ThenNextForLightShouldBe(2, 10, true);
+}
+
+TEST(LightScheduler, ShouldRebuildLightIndexWithTheScheduleIndex)
+{
+   WhenLightSchedulerIsInitialized();
+   GivenLightsAreIndexed();
+   ScheduleHandle_t removed = LightScheduler_AddScheduleAt(&scheduler, 1, true, 10);
+   WhenEventScheduledAtWideTime(1, false, 20);
+   scheduler.schedules.active[removed.index / 32] &= ~(1UL << (removed.index % 32));
+   LightScheduler_RebuildIndex(&scheduler);
+   ThenNextForLightShouldBe(1, 20, false);
+   ThenRemoveAllForLightShouldRemove(1, 1);
+}
+
+TEST(LightScheduler, StatsChecks)
+{
+   CHECK_ASSERTION_FAILED(LightScheduler_GetStats(NULL));
+   CHECK_ASSERTION_FAILED(LightScheduler_ResetStats(NULL));
+   CHECK_ASSERTION_FAILED(LightScheduler_SetCycleCounter(NULL, &fakeCycleCounter.interface));
+}
+
+TEST(LightScheduler, ShouldStartWithNoStats)
+{
+   uint32_t i;
+   WhenLightSchedulerIsInitialized();
+   UNSIGNED_LONGS_EQUAL(0, Stats()->runs);
+   UNSIGNED_LONGS_EQUAL(0, Stats()->adds);
+   for(i = 0; i < LIGHTSCHEDULER_LATENCY_BUCKETS; i++)
+   {
+      UNSIGNED_LONGS_EQUAL(0, Stats()->runLatency[i]);
+   }
+}
+
+TEST(LightScheduler, ShouldCountRunsAddsRemovesAndWrites)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   ScheduleHandle_t handle = LightScheduler_AddScheduleAt(&scheduler, 1, true, 10);
+   LightScheduler_AddScheduleAt(&scheduler, 2, true, 10);
+   LightScheduler_AddRecurringSchedule(&scheduler, 3, true, 10, 100);
+   ThenRemoveByHandleShouldSucceed(handle);
+   ThenLightShouldBeOn(2);
+   ThenLightShouldBeOn(3);
+   GivenSchedulerHasRunAtWideTime(10);
+   GivenSchedulerHasRunAtWideTime(11);
+
+   UNSIGNED_LONGS_EQUAL(2, Stats()->runs);
+   UNSIGNED_LONGS_EQUAL(3, Stats()->adds);
+   UNSIGNED_LONGS_EQUAL(1, Stats()->removes);
+   UNSIGNED_LONGS_EQUAL(2, Stats()->schedulesEvaluated);
+   UNSIGNED_LONGS_EQUAL(2, Stats()->writes);
+}
+
+TEST(LightScheduler, ShouldCountAddsRejectedBecauseSchedulerIsFull)
+{
+   WhenLightSchedulerIsInitializedWithStorage(3);
+   CHECK_TRUE(LightScheduler_AddSchedules(&scheduler, dailyEntries, 3, NULL));
+   CHECK_FALSE(ScheduleHandle_IsValid(LightScheduler_AddScheduleAt(&scheduler, 1, true, 10)));
+   CHECK_FALSE(LightScheduler_AddSchedules(&scheduler, dailyEntries, 2, NULL));
+   UNSIGNED_LONGS_EQUAL(3, Stats()->adds);
+   UNSIGNED_LONGS_EQUAL(3, Stats()->rejectedAdds);
+}
+
+TEST(LightScheduler, ShouldCountSuppressedWritesAsEvaluatedButNotWritten)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenRedundantWritesAreSuppressed();
+   GivenConstantTable(&onceTable);
+   LightScheduler_AddScheduleAt(&scheduler, 1, true, 10);
+   ThenLightShouldBeOn(1);
+   GivenSchedulerHasRunAtWideTime(10);
+   UNSIGNED_LONGS_EQUAL(2, Stats()->schedulesEvaluated);
+   UNSIGNED_LONGS_EQUAL(1, Stats()->writes);
+}
+
+TEST(LightScheduler, ShouldCountTicksMissedBetweenRuns)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenSchedulerHasRunAtWideTime(10);
+   GivenSchedulerHasRunAtWideTime(11);
+   GivenSchedulerHasRunAtWideTime(15);
+   GivenSchedulerHasRunAtWideTime(15);
+   UNSIGNED_LONGS_EQUAL(3, Stats()->missedTicks);
+}
+
+TEST(LightScheduler, ShouldRecordRunLatencyInPowerOfTwoBuckets)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenRunLatencyIsMeasured();
+   WhenRunTakesCycles(100, 100);
+   GivenSchedulerHasRunAtWideTime(1);
+   WhenRunTakesCycles(100, 107);
+   GivenSchedulerHasRunAtWideTime(2);
+   WhenRunTakesCycles(100, 104);
+   GivenSchedulerHasRunAtWideTime(3);
+   WhenRunTakesCycles(UINT32_MAX - 15, 16);
+   GivenSchedulerHasRunAtWideTime(4);
+   WhenRunTakesCycles(0, UINT32_MAX);
+   GivenSchedulerHasRunAtWideTime(5);
+   UNSIGNED_LONGS_EQUAL(1, Stats()->runLatency[0]);
+   UNSIGNED_LONGS_EQUAL(2, Stats()->runLatency[2]);
+   UNSIGNED_LONGS_EQUAL(1, Stats()->runLatency[5]);
+   UNSIGNED_LONGS_EQUAL(1, Stats()->runLatency[LIGHTSCHEDULER_LATENCY_BUCKETS - 1]);
+}
+
+TEST(LightScheduler, ShouldResetStats)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenRunLatencyIsMeasured();
+   LightScheduler_AddScheduleAt(&scheduler, 1, true, 10);
+   WhenRunTakesCycles(0, 1);
+   GivenSchedulerHasRunAtWideTime(1);
+   LightScheduler_ResetStats(&scheduler);
+   UNSIGNED_LONGS_EQUAL(0, Stats()->runs);
+   UNSIGNED_LONGS_EQUAL(0, Stats()->adds);
+   UNSIGNED_LONGS_EQUAL(0, Stats()->runLatency[0]);
+}
+
+TEST(LightScheduler, RunWithBudgetChecks)
+{
+   WhenLightSchedulerIsInitialized();
+   CHECK_ASSERTION_FAILED(LightScheduler_RunWithBudget(NULL, 1));
+   CHECK_ASSERTION_FAILED(LightScheduler_RunWithBudget(&scheduler, 0));
+}
+
+TEST(LightScheduler, ShouldCompleteRunWithBudgetWhenNothingIsDue)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 20);
+   WhenTimeIs(10);
+   CHECK_TRUE(LightScheduler_RunWithBudget(&scheduler, 1));
+}
+
+TEST(LightScheduler, ShouldStopRunOnceBudgetIsSpent)
+{
+   WhenLightSchedulerIsInitialized();
+   WhenLightScheduledOnAt(&scheduler, 1, 10);
+   WhenLightScheduledOnAt(&scheduler, 2, 10);
+   WhenLightScheduledOnAt(&scheduler, 3, 10);
+   WhenTimeIs(10);
+   ThenLightShouldBeOn(1);
+   ThenLightShouldBeOn(2);
+   CHECK_FALSE(LightScheduler_RunWithBudget(&scheduler, 2));
+   mock().checkExpectations();
+
+   WhenTimeIs(10);
+   ThenLightShouldBeOn(3);
+   CHECK_TRUE(LightScheduler_RunWithBudget(&scheduler, 2));
+}
+
+TEST(LightScheduler, ShouldResumeUnfinishedRunAtTheTimeItStarted)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenEventScheduledAtWideTime(1, true, 10);
+   WhenEventScheduledAtWideTime(2, true, 10);
+   WhenEventScheduledAtWideTime(3, true, 11);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(1);
+   CHECK_FALSE(LightScheduler_RunWithBudget(&scheduler, 1));
+   mock().checkExpectations();
+
+   WhenWideTimeIs(11);
+   ThenLightShouldBeOn(2);
+   ThenLightShouldBeOn(3);
+   CHECK_TRUE(LightScheduler_RunWithBudget(&scheduler, 5));
+}
+
+TEST(LightScheduler, ShouldStopRunBetweenTicksWhenCatchingUp)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenCatchUpIsEnabled();
+   GivenSchedulerHasRunAtWideTime(5);
+   WhenRecurringEventScheduled(1, true, 10, 10);
+   WhenWideTimeIs(35);
+   ThenLightShouldBeOn(1);
+   ThenLightShouldBeOn(1);
+   CHECK_FALSE(LightScheduler_RunWithBudget(&scheduler, 2));
+   mock().checkExpectations();
+
+   ThenLightShouldBeOn(1);
+   CHECK_TRUE(LightScheduler_RunWithBudget(&scheduler, 1));
+   ThenNextDueTimeShouldBe(40);
+}
+
+TEST(LightScheduler, ShouldCountTableEntriesAgainstTheBudget)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   GivenConstantTable(&dailyTable);
+   WhenEventScheduledAtWideTime(4, true, 20);
+   WhenWideTimeIs(20);
+   ThenLightShouldBeOn(2);
+   CHECK_FALSE(LightScheduler_RunWithBudget(&scheduler, 1));
+   mock().checkExpectations();
+
+   ThenLightShouldBeOn(3);
+   ThenLightShouldBeOn(4);
+   CHECK_TRUE(LightScheduler_RunWithBudget(&scheduler, 2));
+   ThenNextDueTimeShouldBe(40);
+}
+
+TEST(LightScheduler, ShouldNotAddSchedulesBeforeTheTickAnUnfinishedRunStoppedAt)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenEventScheduledAtWideTime(1, true, 10);
+   WhenEventScheduledAtWideTime(2, true, 10);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(1);
+   CHECK_FALSE(LightScheduler_RunWithBudget(&scheduler, 1));
+
+   WhenEventScheduledAtWideTime(3, false, 5);
+   ThenNextDueTimeShouldBe(10);
+}
+
+TEST(LightScheduler, ShouldFinishUnfinishedRunWhenRunWithoutBudget)
+{
+   GivenTimeSourceHasWideTicks();
+   WhenLightSchedulerIsInitialized();
+   WhenEventScheduledAtWideTime(1, true, 10);
+   WhenEventScheduledAtWideTime(2, true, 10);
+   WhenWideTimeIs(10);
+   ThenLightShouldBeOn(1);
+   CHECK_FALSE(LightScheduler_RunWithBudget(&scheduler, 1));
+   mock().checkExpectations();
+
+   WhenWideTimeIs(12);
+   ThenLightShouldBeOn(2);
+   WhenSchedulerIsRun(&scheduler);
+   ThenNothingShouldBeDue();
+}
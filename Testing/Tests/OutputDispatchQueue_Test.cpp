@@ -0,0 +1,358 @@
+/*!
+
+* @file
+
+* @brief Tests for output dispatch queue implementation.
+
+*/
+
+extern "C"
+{
+#include <pthread.h>
+#include <string.h>
+#include "OutputDispatchQueue.h"
+#include "LightScheduler.h"
+}
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "DigitalOutputGroup_Mock.h"
+#include "TimeSource_Mock.h"
+#include "uassert_test.h"
+
+enum
+{
+   QueueSize = 8,
+   NumChannels = 8,
+   ProducerWrites = 200000
+};
+
+/*!
+ * Records the last state written to each channel.  Only written by the consumer thread.
+ */
+typedef struct
+{
+   I_DigitalOutputGroup_t interface;
+   bool state[NumChannels];
+   unsigned writes;
+} RecordingOutputGroup_t;
+
+static void RecordWrite(I_DigitalOutputGroup_t *instance, const DigitalOutputChannel_t channel, const bool state)
+{
+   RecordingOutputGroup_t *outputs = (RecordingOutputGroup_t *)instance;
+   outputs->state[channel] = state;
+   outputs->writes++;
+}
+
+static const I_DigitalOutputGroup_Api_t recordingOutputGroupApi =
+   { RecordWrite, NULL };
+
+typedef struct
+{
+   OutputDispatchQueue_t *queue;
+   bool done;
+} Consumer_t;
+
+static void *Consume(void *context)
+{
+   Consumer_t *consumer = (Consumer_t *)context;
+
+   while(!__atomic_load_n(&consumer->done, __ATOMIC_ACQUIRE))
+   {
+      OutputDispatchQueue_Dispatch(consumer->queue, UINT32_MAX);
+   }
+   OutputDispatchQueue_Dispatch(consumer->queue, UINT32_MAX);
+   return NULL;
+}
+
+TEST_GROUP(OutputDispatchQueue)
+{
+   OutputDispatchQueue_t queue;
+   DigitalOutputChannel_t entries[QueueSize];
+   uint8_t channels[NumChannels];
+   DigitalOutputGroup_Mock_t fakeDigitalOutputGroup;
+
+   void setup()
+   {
+      DigitalOutputGroup_Mock_Init(&fakeDigitalOutputGroup);
+   }
+
+   void GivenOutputsCanBeWrittenTogether()
+   {
+      DigitalOutputGroup_Mock_InitWithWriteMany(&fakeDigitalOutputGroup);
+   }
+
+   void WhenQueueIsInitialized()
+   {
+      OutputDispatchQueue_Init(&queue, &fakeDigitalOutputGroup.interface, entries, QueueSize, channels, NumChannels);
+   }
+
+   void WhenChannelIsWritten(DigitalOutputChannel_t channel, bool state)
+   {
+      DigitalOutputGroup_Write(&queue.interface, channel, state);
+   }
+
+   void ThenChannelShouldBeWritten(DigitalOutputChannel_t channel, bool state)
+   {
+      mock().expectOneCall("Write").onObject(&fakeDigitalOutputGroup.interface).withParameter("channel", channel).withParameter("state", state);
+   }
+
+   void ThenChannelsShouldBeWrittenTogether(uint16_t count)
+   {
+      mock().expectOneCall("WriteMany").onObject(&fakeDigitalOutputGroup.interface).withParameter("count", count);
+   }
+
+   void ThenChannelShouldBeWrittenInBatch(DigitalOutputChannel_t channel, bool state)
+   {
+      mock().expectOneCall("WriteManyEntry").onObject(&fakeDigitalOutputGroup.interface).withParameter("channel", channel).withParameter("state", state);
+   }
+
+   void ThenDispatchShouldWrite(uint32_t maxWrites, uint32_t expected)
+   {
+      UNSIGNED_LONGS_EQUAL(expected, OutputDispatchQueue_Dispatch(&queue, maxWrites));
+   }
+
+   void ThenDepthShouldBe(uint32_t expected)
+   {
+      UNSIGNED_LONGS_EQUAL(expected, OutputDispatchQueue_GetDepth(&queue));
+   }
+
+   void ThenHighWaterMarkShouldBe(uint32_t expected)
+   {
+      UNSIGNED_LONGS_EQUAL(expected, OutputDispatchQueue_GetHighWaterMark(&queue));
+   }
+
+   void ThenCoalescedWriteCountShouldBe(uint32_t expected)
+   {
+      UNSIGNED_LONGS_EQUAL(expected, OutputDispatchQueue_GetCoalescedWriteCount(&queue));
+   }
+};
+
+TEST(OutputDispatchQueue, InitChecks)
+{
+   CHECK_ASSERTION_FAILED(OutputDispatchQueue_Init(NULL, &fakeDigitalOutputGroup.interface, entries, QueueSize, channels, NumChannels));
+   CHECK_ASSERTION_FAILED(OutputDispatchQueue_Init(&queue, NULL, entries, QueueSize, channels, NumChannels));
+   CHECK_ASSERTION_FAILED(OutputDispatchQueue_Init(&queue, &fakeDigitalOutputGroup.interface, NULL, QueueSize, channels, NumChannels));
+   CHECK_ASSERTION_FAILED(OutputDispatchQueue_Init(&queue, &fakeDigitalOutputGroup.interface, entries, QueueSize, NULL, NumChannels));
+   CHECK_ASSERTION_FAILED(OutputDispatchQueue_Init(&queue, &fakeDigitalOutputGroup.interface, entries, 0, channels, NumChannels));
+   CHECK_ASSERTION_FAILED(OutputDispatchQueue_Init(&queue, &fakeDigitalOutputGroup.interface, entries, 6, channels, 4));
+   CHECK_ASSERTION_FAILED(OutputDispatchQueue_Init(&queue, &fakeDigitalOutputGroup.interface, entries, 4, channels, NumChannels));
+}
+
+TEST(OutputDispatchQueue, ShouldRejectChannelsOutOfRange)
+{
+   WhenQueueIsInitialized();
+   CHECK_ASSERTION_FAILED(WhenChannelIsWritten(NumChannels, true));
+   ThenDepthShouldBe(0);
+}
+
+TEST(OutputDispatchQueue, ShouldNotWriteUntilDispatched)
+{
+   WhenQueueIsInitialized();
+   WhenChannelIsWritten(1, true);
+   ThenDepthShouldBe(1);
+   mock().checkExpectations();
+
+   ThenChannelShouldBeWritten(1, true);
+   ThenDispatchShouldWrite(UINT32_MAX, 1);
+   ThenDepthShouldBe(0);
+}
+
+TEST(OutputDispatchQueue, ShouldDispatchNothingWhenEmpty)
+{
+   WhenQueueIsInitialized();
+   ThenDispatchShouldWrite(UINT32_MAX, 0);
+}
+
+TEST(OutputDispatchQueue, ShouldDispatchInTheOrderChannelsWereQueued)
+{
+   WhenQueueIsInitialized();
+   WhenChannelIsWritten(3, true);
+   WhenChannelIsWritten(1, false);
+   WhenChannelIsWritten(2, true);
+
+   ThenChannelShouldBeWritten(3, true);
+   ThenChannelShouldBeWritten(1, false);
+   ThenChannelShouldBeWritten(2, true);
+   mock().strictOrder();
+   ThenDispatchShouldWrite(UINT32_MAX, 3);
+}
+
+TEST(OutputDispatchQueue, ShouldCoalesceWritesToAChannelThatIsStillQueued)
+{
+   WhenQueueIsInitialized();
+   WhenChannelIsWritten(1, true);
+   WhenChannelIsWritten(2, true);
+   WhenChannelIsWritten(1, false);
+   ThenDepthShouldBe(2);
+   ThenCoalescedWriteCountShouldBe(1);
+
+   ThenChannelShouldBeWritten(1, false);
+   ThenChannelShouldBeWritten(2, true);
+   mock().strictOrder();
+   ThenDispatchShouldWrite(UINT32_MAX, 2);
+}
+
+TEST(OutputDispatchQueue, ShouldQueueChannelAgainOnceDispatched)
+{
+   WhenQueueIsInitialized();
+   WhenChannelIsWritten(1, true);
+   ThenChannelShouldBeWritten(1, true);
+   ThenDispatchShouldWrite(UINT32_MAX, 1);
+   mock().checkExpectations();
+
+   WhenChannelIsWritten(1, false);
+   ThenDepthShouldBe(1);
+   ThenCoalescedWriteCountShouldBe(0);
+   ThenChannelShouldBeWritten(1, false);
+   ThenDispatchShouldWrite(UINT32_MAX, 1);
+}
+
+TEST(OutputDispatchQueue, ShouldLimitWritesPerDispatch)
+{
+   WhenQueueIsInitialized();
+   WhenChannelIsWritten(1, true);
+   WhenChannelIsWritten(2, true);
+   WhenChannelIsWritten(3, true);
+
+   ThenChannelShouldBeWritten(1, true);
+   ThenChannelShouldBeWritten(2, true);
+   ThenDispatchShouldWrite(2, 2);
+   ThenDepthShouldBe(1);
+   mock().checkExpectations();
+
+   ThenChannelShouldBeWritten(3, true);
+   ThenDispatchShouldWrite(2, 1);
+}
+
+TEST(OutputDispatchQueue, ShouldHoldEveryChannelWithoutOverflowing)
+{
+   DigitalOutputChannel_t channel;
+
+   WhenQueueIsInitialized();
+   for(channel = 0; channel < NumChannels; channel++)
+   {
+      WhenChannelIsWritten(channel, true);
+      WhenChannelIsWritten(channel, false);
+   }
+   ThenDepthShouldBe(NumChannels);
+   ThenCoalescedWriteCountShouldBe(NumChannels);
+
+   for(channel = 0; channel < NumChannels; channel++)
+   {
+      ThenChannelShouldBeWritten(channel, false);
+   }
+   ThenDispatchShouldWrite(UINT32_MAX, NumChannels);
+}
+
+TEST(OutputDispatchQueue, ShouldTrackHighWaterMarkOfDepth)
+{
+   WhenQueueIsInitialized();
+   ThenHighWaterMarkShouldBe(0);
+   WhenChannelIsWritten(1, true);
+   WhenChannelIsWritten(2, true);
+   WhenChannelIsWritten(3, true);
+   ThenHighWaterMarkShouldBe(3);
+
+   mock().ignoreOtherCalls();
+   ThenDispatchShouldWrite(UINT32_MAX, 3);
+   WhenChannelIsWritten(4, true);
+   ThenDepthShouldBe(1);
+   ThenHighWaterMarkShouldBe(3);
+}
+
+TEST(OutputDispatchQueue, ShouldResetHighWaterMarkToCurrentDepth)
+{
+   WhenQueueIsInitialized();
+   WhenChannelIsWritten(1, true);
+   WhenChannelIsWritten(2, true);
+   WhenChannelIsWritten(3, true);
+
+   mock().ignoreOtherCalls();
+   ThenDispatchShouldWrite(2, 2);
+   OutputDispatchQueue_ResetHighWaterMark(&queue);
+   ThenHighWaterMarkShouldBe(1);
+}
+
+TEST(OutputDispatchQueue, ShouldQueueEachWriteOfAWriteMany)
+{
+   const DigitalOutputWrite_t writes[] = { { 1, true }, { 2, true }, { 1, false } };
+
+   WhenQueueIsInitialized();
+   CHECK_TRUE(DigitalOutputGroup_HasWriteMany(&queue.interface));
+   DigitalOutputGroup_WriteMany(&queue.interface, writes, 3);
+   ThenDepthShouldBe(2);
+   ThenCoalescedWriteCountShouldBe(1);
+
+   ThenChannelShouldBeWritten(1, false);
+   ThenChannelShouldBeWritten(2, true);
+   ThenDispatchShouldWrite(UINT32_MAX, 2);
+}
+
+TEST(OutputDispatchQueue, ShouldDispatchTogetherWhenOutputCanWriteMany)
+{
+   GivenOutputsCanBeWrittenTogether();
+   WhenQueueIsInitialized();
+   WhenChannelIsWritten(1, true);
+   WhenChannelIsWritten(2, false);
+
+   ThenChannelsShouldBeWrittenTogether(2);
+   ThenChannelShouldBeWrittenInBatch(1, true);
+   ThenChannelShouldBeWrittenInBatch(2, false);
+   ThenDispatchShouldWrite(UINT32_MAX, 2);
+}
+
+TEST(OutputDispatchQueue, ShouldDecoupleSchedulerRunsFromTheOutput)
+{
+   LightScheduler_t scheduler;
+   TimeSource_Mock_t fakeTimeSource;
+
+   TimeSource_Mock_Init(&fakeTimeSource);
+   WhenQueueIsInitialized();
+   LightScheduler_Init(&scheduler, &queue.interface, (I_TimeSource_t *)&fakeTimeSource);
+   LightScheduler_AddSchedule(&scheduler, 1, true, 10);
+   LightScheduler_AddSchedule(&scheduler, 2, true, 10);
+
+   mock().expectOneCall("GetTicks").onObject(&fakeTimeSource.interface).andReturnValue(10);
+   LightScheduler_Run(&scheduler);
+   ThenDepthShouldBe(2);
+   mock().checkExpectations();
+
+   ThenChannelShouldBeWritten(1, true);
+   ThenChannelShouldBeWritten(2, true);
+   ThenDispatchShouldWrite(UINT32_MAX, 2);
+}
+
+TEST(OutputDispatchQueue, ShouldDispatchLastStateWrittenByAnotherThread)
+{
+   RecordingOutputGroup_t outputs;
+   Consumer_t consumer;
+   pthread_t thread;
+   uint32_t i;
+
+   memset(&outputs, 0, sizeof(outputs));
+   outputs.interface.api = &recordingOutputGroupApi;
+   OutputDispatchQueue_Init(&queue, &outputs.interface, entries, QueueSize, channels, NumChannels);
+   consumer.queue = &queue;
+   consumer.done = false;
+   CHECK_EQUAL(0, pthread_create(&thread, NULL, Consume, &consumer));
+
+   for(i = 0; i < ProducerWrites; i++)
+   {
+      DigitalOutputGroup_Write(&queue.interface, (DigitalOutputChannel_t)(i % NumChannels), ((i / NumChannels) % 2) == 0);
+   }
+   for(i = 0; i < NumChannels; i++)
+   {
+      DigitalOutputGroup_Write(&queue.interface, (DigitalOutputChannel_t)i, (i % 3) == 0);
+   }
+
+   __atomic_store_n(&consumer.done, true, __ATOMIC_RELEASE);
+   CHECK_EQUAL(0, pthread_join(thread, NULL));
+
+   ThenDepthShouldBe(0);
+   CHECK_TRUE(OutputDispatchQueue_GetHighWaterMark(&queue) <= NumChannels);
+   UNSIGNED_LONGS_EQUAL(ProducerWrites + NumChannels, outputs.writes + OutputDispatchQueue_GetCoalescedWriteCount(&queue));
+   for(i = 0; i < NumChannels; i++)
+   {
+      CHECK_EQUAL((i % 3) == 0, outputs.state[i]);
+   }
+}
@@ -0,0 +1,482 @@
+/*!
+
+* @file
+
+* @brief Tests for the schedule store implementations, run against each of them through I_ScheduleStore.
+
+*/
+
+extern "C"
+{
+#include <string.h>
+#include "LinearScheduleStore.h"
+#include "SortedScheduleStore.h"
+#include "HeapScheduleStore.h"
+#include "WheelScheduleStore.h"
+}
+#include "CppUTest/TestHarness.h"
+#include "uassert_test.h"
+
+enum
+{
+   Capacity = 40,
+   MaxColumns = 3
+};
+
+class ScheduleStoreTest : public Utest
+{
+  protected:
+   TimeSourceWideTickCount_t times[Capacity];
+   uint32_t lightStates[LIGHTSCHEDULER_SCHEDULE_BITSET_WORDS(Capacity)];
+   DigitalOutputChannel_t lightIds[Capacity];
+   ScheduleIndex_t columns[MaxColumns * Capacity];
+   ScheduleTable_t table;
+   LinearScheduleStore_t linear;
+   SortedScheduleStore_t sorted;
+   HeapScheduleStore_t heap;
+   WheelScheduleStore_t wheel;
+   I_ScheduleStore_t *store;
+
+   void GivenTable()
+   {
+      memset(&table, 0, sizeof(table));
+      memset(lightStates, 0, sizeof(lightStates));
+      table.time = times;
+      table.lightState = lightStates;
+      table.lightId = lightIds;
+      table.store = columns;
+   }
+
+   void GivenScheduleFor(ScheduleIndex_t index, DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time)
+   {
+      times[index] = time;
+      lightIds[index] = lightId;
+      if(lightState)
+      {
+         lightStates[index / 32] |= (1UL << (index % 32));
+      }
+      ScheduleStore_Insert(store, index);
+   }
+
+   void GivenScheduleAt(ScheduleIndex_t index, TimeSourceWideTickCount_t time)
+   {
+      GivenScheduleFor(index, 0, false, time);
+   }
+
+   void WhenScheduleIsRemoved(ScheduleIndex_t index)
+   {
+      ScheduleStore_Remove(store, index);
+   }
+
+   void WhenScheduleIsMovedTo(ScheduleIndex_t index, TimeSourceWideTickCount_t time)
+   {
+      ScheduleStore_Remove(store, index);
+      times[index] = time;
+      ScheduleStore_Insert(store, index);
+   }
+
+   void ThenDueAtShouldBe(TimeSourceWideTickCount_t tick, ScheduleIndex_t expected)
+   {
+      UNSIGNED_LONGS_EQUAL(expected, ScheduleStore_DueAt(store, tick));
+   }
+
+   void ThenNothingShouldBeDueAt(TimeSourceWideTickCount_t tick)
+   {
+      ThenDueAtShouldBe(tick, SCHEDULE_INDEX_NONE);
+   }
+
+   void ThenSchedulesShouldComeDueInOrder(TimeSourceWideTickCount_t tick, const ScheduleIndex_t *expected, ScheduleIndex_t count)
+   {
+      ScheduleIndex_t i;
+
+      for(i = 0; i < count; i++)
+      {
+         ThenDueAtShouldBe(tick, expected[i]);
+         WhenScheduleIsRemoved(expected[i]);
+      }
+      ThenNothingShouldBeDueAt(tick);
+   }
+
+   void ThenNextDueTimeShouldBe(TimeSourceWideTickCount_t from, TimeSourceWideTickCount_t expected)
+   {
+      TimeSourceWideTickCount_t tick = 0;
+      CHECK_TRUE(ScheduleStore_NextDueTime(store, from, &tick));
+      UNSIGNED_LONGS_EQUAL(expected, (unsigned long)tick);
+   }
+
+   void ThenStoreShouldBeEmpty()
+   {
+      TimeSourceWideTickCount_t tick;
+      CHECK_FALSE(ScheduleStore_NextDueTime(store, 0, &tick));
+      ThenNothingShouldBeDueAt(0);
+   }
+
+   void ThenFindShouldReturn(
+      ScheduleIndex_t expected,
+      DigitalOutputChannel_t lightId,
+      bool lightState,
+      TimeSourceWideTickCount_t time,
+      TimeSourceWideTickCount_t timeMask)
+   {
+      UNSIGNED_LONGS_EQUAL(expected, ScheduleStore_Find(store, lightId, lightState, time, timeMask));
+   }
+
+   void ShouldBeEmptyAfterInit()
+   {
+      ThenStoreShouldBeEmpty();
+   }
+
+   void ShouldFindEarliestDueTime()
+   {
+      GivenScheduleAt(0, 30);
+      GivenScheduleAt(1, 10);
+      GivenScheduleAt(2, 20);
+      ThenNextDueTimeShouldBe(0, 10);
+      WhenScheduleIsRemoved(1);
+      ThenNextDueTimeShouldBe(11, 20);
+   }
+
+   void ShouldFindEarliestDueTimeMoreThanAWheelTurnAway()
+   {
+      GivenScheduleAt(0, 5 + (3 * LIGHTSCHEDULER_WHEEL_SLOTS));
+      GivenScheduleAt(1, 7 + LIGHTSCHEDULER_WHEEL_SLOTS);
+      ThenNextDueTimeShouldBe(0, 7 + LIGHTSCHEDULER_WHEEL_SLOTS);
+   }
+
+   void ShouldOnlyReturnSchedulesDueAtTheTick()
+   {
+      GivenScheduleAt(0, 10 + LIGHTSCHEDULER_WHEEL_SLOTS);
+      GivenScheduleAt(1, 11);
+      ThenNothingShouldBeDueAt(10);
+      ThenDueAtShouldBe(11, 1);
+   }
+
+   void ShouldReturnSchedulesDueAtATickInInsertionOrder()
+   {
+      const ScheduleIndex_t expected[] = { 3, 1, 4, 0 };
+
+      GivenScheduleAt(3, 10);
+      GivenScheduleAt(1, 10);
+      GivenScheduleAt(2, 20);
+      GivenScheduleAt(4, 10);
+      GivenScheduleAt(0, 10);
+      ThenSchedulesShouldComeDueInOrder(10, expected, 4);
+      ThenDueAtShouldBe(20, 2);
+   }
+
+   void ShouldReturnSchedulesDueAtATickAcrossTheTable()
+   {
+      const ScheduleIndex_t expected[] = { Capacity - 1, 0, 32 };
+
+      GivenScheduleAt(Capacity - 1, 10);
+      GivenScheduleAt(31, 5);
+      GivenScheduleAt(0, 10);
+      GivenScheduleAt(32, 10);
+      ThenNextDueTimeShouldBe(0, 5);
+      ThenDueAtShouldBe(5, 31);
+      WhenScheduleIsRemoved(31);
+      ThenNextDueTimeShouldBe(0, 10);
+      ThenSchedulesShouldComeDueInOrder(10, expected, 3);
+   }
+
+   void ShouldRemoveScheduleThatIsNotDueNext()
+   {
+      const ScheduleIndex_t expected[] = { 0, 2 };
+
+      GivenScheduleAt(0, 10);
+      GivenScheduleAt(1, 10);
+      GivenScheduleAt(2, 10);
+      GivenScheduleAt(3, 30);
+      WhenScheduleIsRemoved(1);
+      WhenScheduleIsRemoved(3);
+      ThenSchedulesShouldComeDueInOrder(10, expected, 2);
+      ThenStoreShouldBeEmpty();
+   }
+
+   void ShouldKeepDueOrderWhileSchedulesRecur()
+   {
+      TimeSourceWideTickCount_t tick;
+      ScheduleIndex_t i;
+
+      for(i = 0; i < Capacity; i++)
+      {
+         GivenScheduleAt(i, Capacity - i);
+      }
+
+      for(tick = 1; tick <= (4 * Capacity); tick++)
+      {
+         ScheduleIndex_t expected = (ScheduleIndex_t)(Capacity - 1 - ((tick - 1) % Capacity));
+
+         ThenNextDueTimeShouldBe(tick, tick);
+         ThenDueAtShouldBe(tick, expected);
+         WhenScheduleIsMovedTo(expected, tick + Capacity);
+         ThenNothingShouldBeDueAt(tick);
+      }
+   }
+
+   void ShouldFindScheduleByWideTime()
+   {
+      GivenScheduleFor(0, 1, true, 10);
+      GivenScheduleFor(1, 1, false, 10);
+      GivenScheduleFor(2, 2, false, 10);
+      GivenScheduleFor(3, 1, false, 20);
+      ThenFindShouldReturn(1, 1, false, 10, UINT64_MAX);
+      ThenFindShouldReturn(SCHEDULE_INDEX_NONE, 2, true, 10, UINT64_MAX);
+      ThenFindShouldReturn(SCHEDULE_INDEX_NONE, 1, false, 15, UINT64_MAX);
+   }
+
+   void ShouldFindEarliestScheduleByTickCount()
+   {
+      GivenScheduleFor(0, 1, true, 10 + (2 * ((TimeSourceWideTickCount_t)UINT16_MAX + 1)));
+      GivenScheduleFor(1, 1, true, 10 + ((TimeSourceWideTickCount_t)UINT16_MAX + 1));
+      GivenScheduleFor(2, 1, true, 11);
+      ThenFindShouldReturn(1, 1, true, 10, UINT16_MAX);
+   }
+
+   void ShouldFindFirstInsertedOfMatchingSchedules()
+   {
+      GivenScheduleFor(2, 1, true, 10);
+      GivenScheduleFor(0, 1, true, 10);
+      ThenFindShouldReturn(2, 1, true, 10, UINT64_MAX);
+      WhenScheduleIsRemoved(2);
+      ThenFindShouldReturn(0, 1, true, 10, UINT64_MAX);
+   }
+
+   void ShouldBeEmptyAfterClear()
+   {
+      GivenScheduleAt(0, 10);
+      GivenScheduleAt(1, 20);
+      ScheduleStore_Clear(store);
+      ThenStoreShouldBeEmpty();
+   }
+
+   void ShouldBeValidWhileInUse()
+   {
+      CHECK_TRUE(ScheduleStore_IsValid(store, Capacity));
+      GivenScheduleAt(0, 10);
+      GivenScheduleAt(1, 5);
+      GivenScheduleAt(2, 10);
+      GivenScheduleAt(3, 10 + 16);
+      WhenScheduleIsRemoved(1);
+      CHECK_TRUE(ScheduleStore_IsValid(store, Capacity));
+   }
+
+   void ShouldNotBeValidWhenStateRefersOutsideTheTable()
+   {
+      GivenScheduleAt(0, 10);
+      ScheduleStore_SetStateWord(store, 0, Capacity + 1);
+      CHECK_FALSE(ScheduleStore_IsValid(store, Capacity));
+   }
+
+   void ShouldNotBeValidWhenColumnsReferOutsideTheTable()
+   {
+      ScheduleIndex_t i;
+
+      GivenScheduleAt(0, 10);
+      for(i = 0; i < (MaxColumns * Capacity); i++)
+      {
+         columns[i] = Capacity;
+      }
+      CHECK_FALSE(ScheduleStore_IsValid(store, Capacity));
+   }
+
+   void ShouldNotBeValidWhenSchedulesAreOutOfOrder()
+   {
+      GivenScheduleAt(0, 10);
+      GivenScheduleAt(1, 10 + 16);
+      times[0] = 10 + 32;
+      CHECK_FALSE(ScheduleStore_IsValid(store, Capacity));
+   }
+
+   void ShouldRestoreFromItsStateWords(uint32_t stateWords)
+   {
+      const ScheduleIndex_t expected[] = { 0, 2 };
+      uint32_t saved[WHEELSCHEDULESTORE_STATE_WORDS];
+      uint32_t word;
+
+      GivenScheduleAt(0, 10);
+      GivenScheduleAt(1, 5);
+      GivenScheduleAt(2, 10);
+      WhenScheduleIsRemoved(1);
+      for(word = 0; word < stateWords; word++)
+      {
+         saved[word] = ScheduleStore_GetStateWord(store, word);
+      }
+
+      ScheduleStore_Clear(store);
+      for(word = 0; word < stateWords; word++)
+      {
+         ScheduleStore_SetStateWord(store, word, saved[word]);
+      }
+      ThenNextDueTimeShouldBe(0, 10);
+      ThenSchedulesShouldComeDueInOrder(10, expected, 2);
+   }
+};
+
+TEST_GROUP_BASE(LinearScheduleStore, ScheduleStoreTest)
+{
+   void setup()
+   {
+      GivenTable();
+      LinearScheduleStore_Init(&linear, &table, Capacity);
+      store = &linear.interface;
+   }
+};
+
+TEST_GROUP_BASE(SortedScheduleStore, ScheduleStoreTest)
+{
+   void setup()
+   {
+      GivenTable();
+      SortedScheduleStore_Init(&sorted, &table, Capacity);
+      store = &sorted.interface;
+   }
+};
+
+TEST_GROUP_BASE(HeapScheduleStore, ScheduleStoreTest)
+{
+   void setup()
+   {
+      GivenTable();
+      HeapScheduleStore_Init(&heap, &table, Capacity);
+      store = &heap.interface;
+   }
+};
+
+TEST_GROUP_BASE(WheelScheduleStore, ScheduleStoreTest)
+{
+   void setup()
+   {
+      GivenTable();
+      WheelScheduleStore_Init(&wheel, &table, Capacity);
+      store = &wheel.interface;
+   }
+};
+
+/*!
+ * Runs a test of the ScheduleStoreTest base against every store.
+ */
+#define SCHEDULE_STORE_TEST(name)            \
+   TEST(LinearScheduleStore, name)           \
+   {                                         \
+      name();                                \
+   }                                         \
+   TEST(SortedScheduleStore, name)           \
+   {                                         \
+      name();                                \
+   }                                         \
+   TEST(HeapScheduleStore, name)             \
+   {                                         \
+      name();                                \
+   }                                         \
+   TEST(WheelScheduleStore, name)            \
+   {                                         \
+      name();                                \
+   }
+
+SCHEDULE_STORE_TEST(ShouldBeEmptyAfterInit)
+SCHEDULE_STORE_TEST(ShouldFindEarliestDueTime)
+SCHEDULE_STORE_TEST(ShouldFindEarliestDueTimeMoreThanAWheelTurnAway)
+SCHEDULE_STORE_TEST(ShouldOnlyReturnSchedulesDueAtTheTick)
+SCHEDULE_STORE_TEST(ShouldReturnSchedulesDueAtATickInInsertionOrder)
+SCHEDULE_STORE_TEST(ShouldReturnSchedulesDueAtATickAcrossTheTable)
+SCHEDULE_STORE_TEST(ShouldRemoveScheduleThatIsNotDueNext)
+SCHEDULE_STORE_TEST(ShouldKeepDueOrderWhileSchedulesRecur)
+SCHEDULE_STORE_TEST(ShouldFindScheduleByWideTime)
+SCHEDULE_STORE_TEST(ShouldFindEarliestScheduleByTickCount)
+SCHEDULE_STORE_TEST(ShouldFindFirstInsertedOfMatchingSchedules)
+SCHEDULE_STORE_TEST(ShouldBeEmptyAfterClear)
+SCHEDULE_STORE_TEST(ShouldBeValidWhileInUse)
+SCHEDULE_STORE_TEST(ShouldNotBeValidWhenStateRefersOutsideTheTable)
+SCHEDULE_STORE_TEST(ShouldNotBeValidWhenColumnsReferOutsideTheTable)
+
+TEST(LinearScheduleStore, ShouldRestoreFromItsStateWords)
+{
+   ShouldRestoreFromItsStateWords(LINEARSCHEDULESTORE_STATE_WORDS);
+}
+
+TEST(LinearScheduleStore, ShouldShrinkScannedRangeAsTopSchedulesAreRemoved)
+{
+   GivenScheduleAt(0, 10);
+   GivenScheduleAt(5, 20);
+   GivenScheduleAt(30, 30);
+   GivenScheduleAt(Capacity - 1, 40);
+   UNSIGNED_LONGS_EQUAL(Capacity, ScheduleStore_GetStateWord(store, 1));
+
+   WhenScheduleIsRemoved(Capacity - 1);
+   UNSIGNED_LONGS_EQUAL(31, ScheduleStore_GetStateWord(store, 1));
+
+   WhenScheduleIsRemoved(5);
+   UNSIGNED_LONGS_EQUAL(31, ScheduleStore_GetStateWord(store, 1));
+
+   WhenScheduleIsRemoved(30);
+   UNSIGNED_LONGS_EQUAL(1, ScheduleStore_GetStateWord(store, 1));
+   ThenNextDueTimeShouldBe(0, 10);
+   ThenDueAtShouldBe(10, 0);
+
+   WhenScheduleIsRemoved(0);
+   UNSIGNED_LONGS_EQUAL(0, ScheduleStore_GetStateWord(store, 1));
+   ThenStoreShouldBeEmpty();
+
+   GivenScheduleAt(3, 50);
+   UNSIGNED_LONGS_EQUAL(4, ScheduleStore_GetStateWord(store, 1));
+   ThenDueAtShouldBe(50, 3);
+}
+
+TEST(SortedScheduleStore, ShouldRestoreFromItsStateWords)
+{
+   ShouldRestoreFromItsStateWords(SORTEDSCHEDULESTORE_STATE_WORDS);
+}
+
+TEST(HeapScheduleStore, ShouldRestoreFromItsStateWords)
+{
+   ShouldRestoreFromItsStateWords(HEAPSCHEDULESTORE_STATE_WORDS);
+}
+
+TEST(WheelScheduleStore, ShouldRestoreFromItsStateWords)
+{
+   ShouldRestoreFromItsStateWords(WHEELSCHEDULESTORE_STATE_WORDS);
+}
+
+TEST(SortedScheduleStore, ShouldNotBeValidWhenSchedulesAreOutOfOrder)
+{
+   ShouldNotBeValidWhenSchedulesAreOutOfOrder();
+}
+
+TEST(HeapScheduleStore, ShouldNotBeValidWhenSchedulesAreOutOfOrder)
+{
+   ShouldNotBeValidWhenSchedulesAreOutOfOrder();
+}
+
+TEST(WheelScheduleStore, ShouldNotBeValidWhenSchedulesAreOutOfOrder)
+{
+   ShouldNotBeValidWhenSchedulesAreOutOfOrder();
+}
+
+TEST(WheelScheduleStore, ShouldNotBeValidWhenScheduleIsInTheWrongBucket)
+{
+   GivenScheduleAt(0, 10);
+   times[0] = 11;
+   CHECK_FALSE(ScheduleStore_IsValid(store, Capacity));
+}
+
+TEST(WheelScheduleStore, ShouldNotBeValidWhenOccupancyDoesNotMatchBuckets)
+{
+   GivenScheduleAt(0, 10);
+   ScheduleStore_SetStateWord(store, (2 * LIGHTSCHEDULER_WHEEL_SLOTS), 0);
+   CHECK_FALSE(ScheduleStore_IsValid(store, Capacity));
+}
+
+TEST(WheelScheduleStore, ShouldNotBeValidWhenBucketLinksCycle)
+{
+   GivenScheduleAt(0, 10);
+   GivenScheduleAt(1, 10);
+   wheel.next[1] = 0;
+   CHECK_FALSE(ScheduleStore_IsValid(store, Capacity));
+}
+
+TEST(WheelScheduleStore, ChecksForNull)
+{
+   CHECK_ASSERTION_FAILED(WheelScheduleStore_Init(NULL, &table, Capacity));
+   CHECK_ASSERTION_FAILED(WheelScheduleStore_Init(&wheel, NULL, Capacity));
+}
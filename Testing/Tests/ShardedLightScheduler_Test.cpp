@@ -0,0 +1,213 @@
+/*!
+
+* @file
+
+* @brief Tests for sharded light scheduler implementation.
+
+*/
+
+extern "C"
+{
+#include <string.h>
+#include "ShardedLightScheduler.h"
+}
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "TimeSource_Mock.h"
+#include "uassert_test.h"
+
+enum
+{
+   NumShards = 4,
+   CapacityPerShard = 8,
+   NumChannels = 32
+};
+
+/*!
+ * Records writes per channel.  The workers of different shards write different channels, so the
+ * recorded values for a channel are only ever written by one thread.
+ */
+typedef struct
+{
+   I_DigitalOutputGroup_t interface;
+   bool state[NumChannels];
+   unsigned writes[NumChannels];
+   pthread_t writer[NumChannels];
+} RecordingOutputGroup_t;
+
+static void RecordWrite(I_DigitalOutputGroup_t *instance, const DigitalOutputChannel_t channel, const bool state)
+{
+   RecordingOutputGroup_t *outputs = (RecordingOutputGroup_t *)instance;
+   outputs->state[channel] = state;
+   outputs->writes[channel]++;
+   outputs->writer[channel] = pthread_self();
+}
+
+static const I_DigitalOutputGroup_Api_t recordingOutputGroupApi =
+   { RecordWrite, NULL };
+
+TEST_GROUP(ShardedLightScheduler)
+{
+   ShardedLightScheduler_t scheduler;
+   LightSchedulerShard_t shards[NumShards];
+   uint64_t storage[NumShards * LIGHTSCHEDULER_STORAGE_WORDS(CapacityPerShard)];
+   RecordingOutputGroup_t outputs;
+   TimeSource_Mock_t fakeTimeSource;
+   bool initialized;
+
+   void setup()
+   {
+      memset(&outputs, 0, sizeof(outputs));
+      outputs.interface.api = &recordingOutputGroupApi;
+      TimeSource_Mock_InitWide(&fakeTimeSource);
+      initialized = false;
+   }
+
+   void teardown()
+   {
+      if(initialized)
+      {
+         ShardedLightScheduler_Destroy(&scheduler);
+      }
+   }
+
+   void WhenShardedSchedulerIsInitialized()
+   {
+      initialized = ShardedLightScheduler_Init(
+         &scheduler,
+         &outputs.interface,
+         (I_TimeSource_t *)&fakeTimeSource,
+         shards,
+         NumShards,
+         storage,
+         CapacityPerShard);
+      CHECK_TRUE(initialized);
+   }
+
+   void WhenLightScheduledAt(DigitalOutputChannel_t lightId, bool lightState, TimeSourceWideTickCount_t time)
+   {
+      ShardedLightScheduler_AddScheduleAt(&scheduler, lightId, lightState, time);
+   }
+
+   void WhenWideTimeIs(TimeSourceWideTickCount_t time)
+   {
+      mock().expectOneCall("GetWideTicks").onObject(&fakeTimeSource.interface).andReturnValue((unsigned long)time);
+   }
+
+   void WhenSchedulerIsRunAt(TimeSourceWideTickCount_t time)
+   {
+      WhenWideTimeIs(time);
+      ShardedLightScheduler_Run(&scheduler);
+   }
+
+   void ThenLightShouldBe(DigitalOutputChannel_t lightId, bool state, unsigned writes)
+   {
+      CHECK_EQUAL(state, outputs.state[lightId]);
+      UNSIGNED_LONGS_EQUAL(writes, outputs.writes[lightId]);
+   }
+};
+
+TEST(ShardedLightScheduler, InitChecks)
+{
+   CHECK_ASSERTION_FAILED(ShardedLightScheduler_Init(NULL, &outputs.interface, (I_TimeSource_t *)&fakeTimeSource, shards, NumShards, storage, CapacityPerShard));
+   CHECK_ASSERTION_FAILED(ShardedLightScheduler_Init(&scheduler, NULL, (I_TimeSource_t *)&fakeTimeSource, shards, NumShards, storage, CapacityPerShard));
+   CHECK_ASSERTION_FAILED(ShardedLightScheduler_Init(&scheduler, &outputs.interface, NULL, shards, NumShards, storage, CapacityPerShard));
+   CHECK_ASSERTION_FAILED(ShardedLightScheduler_Init(&scheduler, &outputs.interface, (I_TimeSource_t *)&fakeTimeSource, NULL, NumShards, storage, CapacityPerShard));
+   CHECK_ASSERTION_FAILED(ShardedLightScheduler_Init(&scheduler, &outputs.interface, (I_TimeSource_t *)&fakeTimeSource, shards, 0, storage, CapacityPerShard));
+   CHECK_ASSERTION_FAILED(ShardedLightScheduler_Init(&scheduler, &outputs.interface, (I_TimeSource_t *)&fakeTimeSource, shards, NumShards, NULL, CapacityPerShard));
+}
+
+TEST(ShardedLightScheduler, ShouldFailToInitWhenWorkersCannotBeSynchronized)
+{
+   CHECK_FALSE(ShardedLightScheduler_Init(&scheduler, &outputs.interface, (I_TimeSource_t *)&fakeTimeSource, shards, UINT32_MAX, storage, CapacityPerShard));
+}
+
+TEST(ShardedLightScheduler, ShouldDoNothingWhenNothingIsDue)
+{
+   WhenShardedSchedulerIsInitialized();
+   WhenLightScheduledAt(1, true, 10);
+   WhenSchedulerIsRunAt(9);
+   ThenLightShouldBe(1, false, 0);
+}
+
+TEST(ShardedLightScheduler, ShouldRunDueSchedulesInEveryShard)
+{
+   DigitalOutputChannel_t i;
+   WhenShardedSchedulerIsInitialized();
+   for(i = 0; i < NumChannels; i++)
+   {
+      WhenLightScheduledAt(i, true, 10);
+   }
+   WhenSchedulerIsRunAt(10);
+   for(i = 0; i < NumChannels; i++)
+   {
+      ThenLightShouldBe(i, true, 1);
+   }
+}
+
+TEST(ShardedLightScheduler, ShouldWriteEachChannelFromTheWorkerOfItsShard)
+{
+   WhenShardedSchedulerIsInitialized();
+   WhenLightScheduledAt(1, true, 10);
+   WhenLightScheduledAt(1 + NumShards, true, 10);
+   WhenLightScheduledAt(2, true, 10);
+   WhenSchedulerIsRunAt(10);
+   CHECK_TRUE(pthread_equal(outputs.writer[1], outputs.writer[1 + NumShards]));
+   CHECK_FALSE(pthread_equal(outputs.writer[1], outputs.writer[2]));
+   CHECK_FALSE(pthread_equal(outputs.writer[1], pthread_self()));
+}
+
+TEST(ShardedLightScheduler, ShouldWriteSchedulesForOneChannelInOrder)
+{
+   WhenShardedSchedulerIsInitialized();
+   WhenLightScheduledAt(5, true, 10);
+   WhenLightScheduledAt(5, false, 10);
+   WhenSchedulerIsRunAt(10);
+   ThenLightShouldBe(5, false, 2);
+}
+
+TEST(ShardedLightScheduler, ShouldUseCapacityOfEachShard)
+{
+   DigitalOutputChannel_t i;
+   WhenShardedSchedulerIsInitialized();
+   for(i = 0; i < CapacityPerShard; i++)
+   {
+      CHECK_TRUE(ScheduleHandle_IsValid(ShardedLightScheduler_AddScheduleAt(&scheduler, 0, true, 10 + i)));
+   }
+   CHECK_FALSE(ScheduleHandle_IsValid(ShardedLightScheduler_AddScheduleAt(&scheduler, 0, true, 10)));
+   CHECK_TRUE(ScheduleHandle_IsValid(ShardedLightScheduler_AddScheduleAt(&scheduler, 1, true, 10)));
+}
+
+TEST(ShardedLightScheduler, ShouldRemoveScheduleByHandle)
+{
+   WhenShardedSchedulerIsInitialized();
+   ScheduleHandle_t handle = ShardedLightScheduler_AddScheduleAt(&scheduler, 3, true, 10);
+   CHECK_TRUE(ShardedLightScheduler_RemoveScheduleByHandle(&scheduler, 3, handle));
+   CHECK_FALSE(ShardedLightScheduler_RemoveScheduleByHandle(&scheduler, 3, handle));
+   WhenSchedulerIsRunAt(10);
+   ThenLightShouldBe(3, false, 0);
+}
+
+TEST(ShardedLightScheduler, ShouldRunRecurringSchedulesAndCatchUpInEveryShard)
+{
+   WhenShardedSchedulerIsInitialized();
+   ShardedLightScheduler_SetCatchUp(&scheduler, true);
+   ShardedLightScheduler_AddRecurringSchedule(&scheduler, 1, true, 10, 10);
+   ShardedLightScheduler_AddRecurringSchedule(&scheduler, 2, true, 10, 10);
+   WhenSchedulerIsRunAt(5);
+   WhenSchedulerIsRunAt(30);
+   ThenLightShouldBe(1, true, 3);
+   ThenLightShouldBe(2, true, 3);
+}
+
+TEST(ShardedLightScheduler, ShouldReportEarliestNextDueTimeOfAllShards)
+{
+   TimeSourceWideTickCount_t nextDueTime = 0;
+   WhenShardedSchedulerIsInitialized();
+   CHECK_FALSE(ShardedLightScheduler_GetNextDueTime(&scheduler, &nextDueTime));
+   WhenLightScheduledAt(1, true, 30);
+   WhenLightScheduledAt(2, true, 20);
+   WhenLightScheduledAt(3, true, 40);
+   CHECK_TRUE(ShardedLightScheduler_GetNextDueTime(&scheduler, &nextDueTime));
+   UNSIGNED_LONGS_EQUAL(20, nextDueTime);
+}
@@ -0,0 +1,90 @@
+/*!
+
+* @file
+
+* @brief Tests for the tick count helpers of the generic time source.
+
+*/
+
+extern "C"
+{
+#include "I_TimeSource.h"
+}
+#include "CppUTest/TestHarness.h"
+
+TEST_GROUP(TimeSource)
+{
+   void ThenTicksSinceShouldBe(TimeSourceTickCount_t now, TimeSourceTickCount_t then, TimeSourceTickCount_t expected)
+   {
+      UNSIGNED_LONGS_EQUAL(expected, TimeSource_TicksSince(now, then));
+   }
+
+   void ThenShouldBeAfter(TimeSourceTickCount_t a, TimeSourceTickCount_t b)
+   {
+      CHECK_TRUE(TimeSource_IsAfter(a, b));
+   }
+
+   void ThenShouldNotBeAfter(TimeSourceTickCount_t a, TimeSourceTickCount_t b)
+   {
+      CHECK_FALSE(TimeSource_IsAfter(a, b));
+   }
+
+   void ThenExtendedTicksShouldBe(TimeSourceWideTickCount_t wideTicks, TimeSourceTickCount_t ticks, TimeSourceWideTickCount_t expected)
+   {
+      UNSIGNED_LONGS_EQUAL((unsigned long)expected, (unsigned long)TimeSource_ExtendTicks(wideTicks, ticks));
+   }
+};
+
+TEST(TimeSource, ShouldCountTicksSince)
+{
+   ThenTicksSinceShouldBe(30, 10, 20);
+   ThenTicksSinceShouldBe(10, 10, 0);
+}
+
+TEST(TimeSource, ShouldCountTicksSinceAcrossRollover)
+{
+   ThenTicksSinceShouldBe(5, 65530, 11);
+   ThenTicksSinceShouldBe(0, UINT16_MAX, 1);
+}
+
+TEST(TimeSource, ShouldCompareTicks)
+{
+   ThenShouldBeAfter(11, 10);
+   ThenShouldNotBeAfter(10, 11);
+   ThenShouldNotBeAfter(10, 10);
+}
+
+TEST(TimeSource, ShouldCompareTicksAcrossRollover)
+{
+   ThenShouldBeAfter(5, 65530);
+   ThenShouldNotBeAfter(65530, 5);
+   ThenShouldBeAfter(0, UINT16_MAX);
+   ThenShouldNotBeAfter(UINT16_MAX, 0);
+}
+
+TEST(TimeSource, ShouldCompareTicksUpToHalfTheTickRangeApart)
+{
+   ThenShouldBeAfter(32767, 0);
+   ThenShouldNotBeAfter(32768, 0);
+   ThenShouldBeAfter(0, 32769);
+   ThenShouldNotBeAfter(0, 32768);
+}
+
+TEST(TimeSource, ShouldExtendTicks)
+{
+   ThenExtendedTicksShouldBe(10, 10, 10);
+   ThenExtendedTicksShouldBe(10, 30, 30);
+   ThenExtendedTicksShouldBe(0x30000, 5, 0x30005);
+}
+
+TEST(TimeSource, ShouldExtendTicksAcrossRollover)
+{
+   ThenExtendedTicksShouldBe(65530, 5, 65541);
+   ThenExtendedTicksShouldBe(0x3FFFF, 0, 0x40000);
+}
+
+TEST(TimeSource, ShouldExtendTicksToTheNextTimeTheyAreReached)
+{
+   ThenExtendedTicksShouldBe(50000, 10, 65546);
+   ThenExtendedTicksShouldBe(10, 9, 65545);
+}